@@ -0,0 +1,109 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+// 按文件选加载方式之前的探测: statx取大小和O_DIRECT的对齐要求,
+// cachestat(Linux 6.5+, 没有时用mincore)取文件在页缓存里的比例.
+// 只看元数据和页表, 不读文件内容
+
+#ifndef __NR_cachestat
+#define __NR_cachestat 451
+#endif
+
+struct FileProbe {
+    off_t    size{0};
+    double   resident{1.0};  //在页缓存里的页数比例, 空文件算1
+    uint32_t dio_align{0};   // O_DIRECT缓冲区和偏移的对齐, 0表示不支持
+};
+
+namespace file_probe_detail {
+
+// linux/mman.h里的cachestat_range/cachestat, 老内核头文件没有
+struct CacheStatRange {
+    uint64_t off;
+    uint64_t len;
+};
+struct CacheStat {
+    uint64_t nr_cache;
+    uint64_t nr_dirty;
+    uint64_t nr_writeback;
+    uint64_t nr_evicted;
+    uint64_t nr_recently_evicted;
+};
+
+//缓存中的页数, 内核不支持时返回-1
+inline int64_t cachestatPages(int fd, off_t size) {
+    CacheStatRange range{0, static_cast<uint64_t>(size)};
+    CacheStat      stat{};
+    if (syscall(__NR_cachestat, fd, &range, &stat, 0) != 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(stat.nr_cache);
+}
+
+inline int64_t mincorePages(int fd, off_t size) {
+    const auto length = static_cast<size_t>(size);
+    void*      addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return -1;
+    }
+    const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    std::vector<unsigned char> pages((length + page - 1) / page);
+    int64_t                    cached = -1;
+    if (mincore(addr, length, pages.data()) == 0) {
+        cached = std::count_if(pages.begin(), pages.end(),
+                               [](unsigned char p) { return p & 1; });
+    }
+    munmap(addr, length);
+    return cached;
+}
+
+}  // namespace file_probe_detail
+
+inline FileProbe probeFile(int fd) {
+    using namespace file_probe_detail;
+    FileProbe    probe;
+    struct statx stx;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_SIZE | STATX_DIOALIGN, &stx) ==
+        0) {
+        probe.size = static_cast<off_t>(stx.stx_size);
+        if (stx.stx_mask & STATX_DIOALIGN) {
+            //两个都非0才支持O_DIRECT
+            probe.dio_align =
+                stx.stx_dio_mem_align && stx.stx_dio_offset_align
+                    ? std::max(stx.stx_dio_mem_align,
+                               stx.stx_dio_offset_align)
+                    : 0;
+        } else {
+            probe.dio_align = 4096;  // 6.1之前的内核不报告, 按页对齐试试
+        }
+    } else {
+        struct stat s;
+        if (fstat(fd, &s) != 0) {
+            return probe;
+        }
+        probe.size = s.st_size;
+    }
+    if (probe.size == 0) {
+        return probe;
+    }
+    int64_t cached = cachestatPages(fd, probe.size);
+    if (cached < 0) {
+        cached = mincorePages(fd, probe.size);
+    }
+    const int64_t page = sysconf(_SC_PAGESIZE);
+    const int64_t total = (probe.size + page - 1) / page;
+    //两种方法都不可用时当作冷文件
+    probe.resident = cached < 0 ? 0.0
+                                : static_cast<double>(cached) /
+                                      static_cast<double>(total);
+    return probe;
+}
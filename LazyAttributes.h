@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// ObjReaderConfig::lazy_attributes解析之后按需解码v/vn/vt: 只用拓扑或者
+// 只看一部分shape的任务, 没碰到的数字不用再过一遍tryParseDouble.
+// 以lazy_attrib_t::kBlockSize行为一块在线程池上并行解码, 解码过的块
+// 直接跳过. 同一个attrib不要从多个线程同时调用这里的函数.
+// 解析的文本(ParseFromBuffer的缓冲区, mmap)要留到解码完
+
+namespace lazy_attrib_detail {
+
+constexpr size_t kBlockSize = tinyobj::lazy_attrib_t::kBlockSize;
+//标记用到的块时每个任务至少处理这么多下标
+constexpr size_t kGrain = 65536;
+
+using DecodeFn = void (*)(tinyobj::attrib_t*, size_t, size_t);
+
+//块[first, last)分给线程池, 每个任务解码连续的几块
+inline void decodeBlocks(tinyobj::attrib_t& attrib, DecodeFn decode,
+                         size_t first, size_t last, ThreadPool& pool) {
+    pool.parallelize_loop(first, last, [&](size_t begin, size_t end) {
+        decode(&attrib, begin * kBlockSize, end * kBlockSize);
+    });
+}
+
+//只解码needed里标记了且还没解码的块
+inline void decodeMarked(tinyobj::attrib_t& attrib, DecodeFn decode,
+                         const std::vector<uint8_t>&       needed,
+                         const std::vector<unsigned char>& decoded,
+                         ThreadPool&                       pool) {
+    std::vector<size_t> todo;
+    for (size_t b = 0; b < needed.size(); ++b) {
+        if (needed[b] && !decoded[b]) {
+            todo.push_back(b);
+        }
+    }
+    pool.parallelize_loop(0, todo.size(), [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            const size_t b = todo[k];
+            decode(&attrib, b * kBlockSize, (b + 1) * kBlockSize);
+        }
+    });
+}
+
+// v, vn, vt各自用到的块
+struct BlockMarks {
+    std::vector<uint8_t> v, vn, vt;
+};
+
+inline void markBlocks(const tinyobj::index_t* indices, size_t count,
+                       BlockMarks& marks) {
+    auto mark = [](std::vector<uint8_t>& blocks, tinyobj::index_int_t i) {
+        if (i >= 0 && size_t(i) / kBlockSize < blocks.size()) {
+            blocks[size_t(i) / kBlockSize] = 1;
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        mark(marks.v, indices[i].vertex_index);
+        mark(marks.vn, indices[i].normal_index);
+        mark(marks.vt, indices[i].texcoord_index);
+    }
+}
+
+//每个任务标记自己的一段下标, 最后合并
+inline void markBlocks(const std::vector<tinyobj::index_t>& indices,
+                       BlockMarks& marks, ThreadPool& pool) {
+    const size_t tasks = std::min<size_t>(pool.get_max_thread_count(),
+                                          indices.size() / kGrain + 1);
+    std::vector<BlockMarks> partial(tasks, marks);
+    pool.parallelize_loop(
+        0, tasks,
+        [&](size_t first, size_t last) {
+            for (size_t t = first; t < last; ++t) {
+                const size_t begin = indices.size() * t / tasks;
+                const size_t end = indices.size() * (t + 1) / tasks;
+                markBlocks(indices.data() + begin, end - begin, partial[t]);
+            }
+        },
+        tasks);
+    for (const BlockMarks& p : partial) {
+        for (size_t b = 0; b < marks.v.size(); ++b) {
+            marks.v[b] |= p.v[b];
+        }
+        for (size_t b = 0; b < marks.vn.size(); ++b) {
+            marks.vn[b] |= p.vn[b];
+        }
+        for (size_t b = 0; b < marks.vt.size(); ++b) {
+            marks.vt[b] |= p.vt[b];
+        }
+    }
+}
+
+}  // namespace lazy_attrib_detail
+
+//顶点[first, last)(连同顶点颜色), 按块取整
+inline void decodeVertices(tinyobj::attrib_t& attrib, size_t first,
+                           size_t last, ThreadPool& pool) {
+    using namespace lazy_attrib_detail;
+    decodeBlocks(attrib, tinyobj::DecodeVertices, first / kBlockSize,
+                 (last + kBlockSize - 1) / kBlockSize, pool);
+}
+
+inline void decodeNormals(tinyobj::attrib_t& attrib, size_t first,
+                          size_t last, ThreadPool& pool) {
+    using namespace lazy_attrib_detail;
+    decodeBlocks(attrib, tinyobj::DecodeNormals, first / kBlockSize,
+                 (last + kBlockSize - 1) / kBlockSize, pool);
+}
+
+inline void decodeTexcoords(tinyobj::attrib_t& attrib, size_t first,
+                            size_t last, ThreadPool& pool) {
+    using namespace lazy_attrib_detail;
+    decodeBlocks(attrib, tinyobj::DecodeTexcoords, first / kBlockSize,
+                 (last + kBlockSize - 1) / kBlockSize, pool);
+}
+
+// shape的面, 线和点引用到的v/vn/vt所在的块
+inline void decodeShape(tinyobj::attrib_t&      attrib,
+                        const tinyobj::shape_t& shape, ThreadPool& pool) {
+    using namespace lazy_attrib_detail;
+    const tinyobj::lazy_attrib_t& lazy = attrib.lazy;
+    if (!lazy.text) {
+        return;
+    }
+    BlockMarks marks;
+    marks.v.assign(lazy.vertex_blocks.size(), 0);
+    marks.vn.assign(lazy.normal_blocks.size(), 0);
+    marks.vt.assign(lazy.texcoord_blocks.size(), 0);
+    markBlocks(shape.mesh.indices, marks, pool);
+    markBlocks(shape.lines.indices, marks, pool);
+    markBlocks(shape.points.indices, marks, pool);
+    decodeMarked(attrib, tinyobj::DecodeVertices, marks.v,
+                 lazy.vertex_blocks, pool);
+    decodeMarked(attrib, tinyobj::DecodeNormals, marks.vn,
+                 lazy.normal_blocks, pool);
+    decodeMarked(attrib, tinyobj::DecodeTexcoords, marks.vt,
+                 lazy.texcoord_blocks, pool);
+}
+
+//全部解码并丢掉懒解码的状态, 之后文本可以释放
+inline void decodeAll(tinyobj::attrib_t& attrib, ThreadPool& pool) {
+    using namespace lazy_attrib_detail;
+    const tinyobj::lazy_attrib_t& lazy = attrib.lazy;
+    decodeBlocks(attrib, tinyobj::DecodeVertices, 0,
+                 lazy.vertex_blocks.size(), pool);
+    decodeBlocks(attrib, tinyobj::DecodeNormals, 0,
+                 lazy.normal_blocks.size(), pool);
+    decodeBlocks(attrib, tinyobj::DecodeTexcoords, 0,
+                 lazy.texcoord_blocks.size(), pool);
+    tinyobj::DecodeAttributes(&attrib);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 按材质分组面, 每个材质一次draw call: 在线程池上做稳定的计数排序,
+// 同一材质的面保持文件里的顺序, 最后在mesh_t::material_ranges里
+// 记下每个材质的(material_id, 下标范围, 面范围)
+
+namespace material_sort_detail {
+
+//材质id范围太大(不是LoadObj产生的id)时不分桶
+constexpr size_t kMaxBuckets = size_t(1) << 20;
+
+inline bool groupFaces(tinyobj::mesh_t& mesh, ThreadPool& pool) {
+    using Offset = tinyobj::index_uint_t;
+    const size_t num_faces = mesh.num_face_vertices.size();
+    if (num_faces == 0 || mesh.material_ids.size() != num_faces ||
+        mesh.indices.size() > std::numeric_limits<Offset>::max()) {
+        return false;
+    }
+    const auto [min_it, max_it] = std::minmax_element(
+        mesh.material_ids.begin(), mesh.material_ids.end());
+    const int    min_id = *min_it;
+    const size_t buckets = size_t(int64_t(*max_it) - min_id) + 1;
+    if (buckets > kMaxBuckets) {
+        return false;
+    }
+    if (buckets == 1) {
+        //只有一个材质(最常见), 不用搬
+        size_t total = 0;
+        for (const unsigned char count : mesh.num_face_vertices) {
+            total += count;
+        }
+        if (total != mesh.indices.size()) {
+            return false;
+        }
+        mesh.material_ranges.assign(
+            1, {min_id, 0, static_cast<Offset>(total), 0,
+                static_cast<Offset>(num_faces)});
+        return true;
+    }
+
+    // 1. 各块统计每个材质的面数和下标数
+    const size_t blocks = std::min<size_t>(pool.get_max_thread_count(),
+                                           num_faces / 16384 + 1);
+    std::vector<size_t> face_begin(blocks + 1);
+    for (size_t b = 0; b <= blocks; ++b) {
+        face_begin[b] = num_faces * b / blocks;
+    }
+    std::vector<size_t> faces(blocks * buckets, 0);
+    std::vector<size_t> indices(blocks * buckets, 0);
+    std::vector<size_t> index_begin(blocks + 1, 0);  //各块第一个面的下标
+    pool.parallelize_loop(
+        0, blocks,
+        [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                size_t* f = &faces[b * buckets];
+                size_t* n = &indices[b * buckets];
+                size_t  total = 0;
+                for (size_t i = face_begin[b]; i < face_begin[b + 1]; ++i) {
+                    const size_t k = size_t(mesh.material_ids[i] - min_id);
+                    ++f[k];
+                    n[k] += mesh.num_face_vertices[i];
+                    total += mesh.num_face_vertices[i];
+                }
+                index_begin[b + 1] = total;
+            }
+        },
+        blocks);
+    for (size_t b = 0; b < blocks; ++b) {
+        index_begin[b + 1] += index_begin[b];
+    }
+    if (index_begin[blocks] != mesh.indices.size()) {
+        return false;
+    }
+
+    // 2. 按(材质, 块)的顺序求前缀和, 计数换成写入位置
+    mesh.material_ranges.clear();
+    size_t face_pos = 0;
+    size_t index_pos = 0;
+    for (size_t k = 0; k < buckets; ++k) {
+        tinyobj::material_range_t range;
+        range.material_id = min_id + static_cast<int>(k);
+        range.first_index = static_cast<Offset>(index_pos);
+        range.first_face = static_cast<Offset>(face_pos);
+        for (size_t b = 0; b < blocks; ++b) {
+            const size_t f = faces[b * buckets + k];
+            const size_t n = indices[b * buckets + k];
+            faces[b * buckets + k] = face_pos;
+            indices[b * buckets + k] = index_pos;
+            face_pos += f;
+            index_pos += n;
+        }
+        range.count = static_cast<Offset>(index_pos - range.first_index);
+        range.face_count = static_cast<Offset>(face_pos - range.first_face);
+        if (range.face_count) {
+            mesh.material_ranges.push_back(range);
+        }
+    }
+    // 3. 各块把自己的面搬到目标位置
+    const bool has_smoothing = mesh.smoothing_group_ids.size() == num_faces;
+    std::vector<tinyobj::index_t> new_indices(mesh.indices.size());
+    std::vector<unsigned char>    new_num_vertices(num_faces);
+    std::vector<int>              new_material_ids(num_faces);
+    std::vector<unsigned int> new_smoothing(has_smoothing ? num_faces : 0);
+    pool.parallelize_loop(
+        0, blocks,
+        [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                size_t* f = &faces[b * buckets];
+                size_t* n = &indices[b * buckets];
+                size_t  src = index_begin[b];
+                for (size_t i = face_begin[b]; i < face_begin[b + 1]; ++i) {
+                    const size_t k = size_t(mesh.material_ids[i] - min_id);
+                    const size_t count = mesh.num_face_vertices[i];
+                    const size_t dst_face = f[k]++;
+                    std::copy_n(mesh.indices.begin() + src, count,
+                                new_indices.begin() + n[k]);
+                    n[k] += count;
+                    src += count;
+                    new_num_vertices[dst_face] = mesh.num_face_vertices[i];
+                    new_material_ids[dst_face] = mesh.material_ids[i];
+                    if (has_smoothing) {
+                        new_smoothing[dst_face] =
+                            mesh.smoothing_group_ids[i];
+                    }
+                }
+            }
+        },
+        blocks);
+    mesh.indices.swap(new_indices);
+    mesh.num_face_vertices.swap(new_num_vertices);
+    mesh.material_ids.swap(new_material_ids);
+    if (has_smoothing) {
+        mesh.smoothing_group_ids.swap(new_smoothing);
+    }
+    return true;
+}
+
+}  // namespace material_sort_detail
+
+// 每个shape的面按材质id分组并填好mesh.material_ranges.
+// 面数和material_ids对不上的shape跳过(material_ranges为空).
+// shape之间并行, 大shape内部再分块
+inline void sortFacesByMaterial(std::vector<tinyobj::shape_t>& shapes,
+                                ThreadPool&                    pool) {
+    pool.parallelize_loop(0, shapes.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            auto& mesh = shapes[i].mesh;
+            if (!material_sort_detail::groupFaces(mesh, pool)) {
+                mesh.material_ranges.clear();
+            }
+        }
+    });
+}
+
+inline void sortFacesByMaterial(tinyobj::ObjReader& reader,
+                                ThreadPool&         pool) {
+    sortFacesByMaterial(reader.GetShapes(), pool);
+}
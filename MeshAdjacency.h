@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 加载之后建边邻接: mesh.indices里每个面角是一条半边, 从这个角的顶点
+// 指向同一个面里下一个角的顶点, 半边的编号就是面角在indices里的下标.
+// 只存每条半边的对边(twin), 三角网格每面12字节, 面和next/prev由编号算出.
+// 边的键(两端的顶点id)在线程池上做LSD基数排序, 同一条边的半边排到
+// 一起, 扫一遍就配好对, 不用std::map
+
+struct EdgeAdjacency {
+    //只属于一个面的边
+    static constexpr uint32_t kBoundary = 0xFFFFFFFFu;
+    // 三个以上的面共用, 两个面同向共用, 首尾顶点相同或者下标越界
+    static constexpr uint32_t kNonManifold = kBoundary - 1;
+
+    std::vector<uint32_t> twin;  //每条半边的对边或上面两个值
+    //每个面第一条半边的编号, 末尾是半边总数. 全是三角形时为空
+    std::vector<uint32_t> face_start;
+
+    size_t num_edges{0};  //不同的边(两端顶点)数, 不含退化边
+    size_t boundary_edges{0};
+    size_t non_manifold_edges{0};
+    size_t degenerate_half_edges{0};  //首尾顶点相同或下标越界
+
+    size_t numFaces() const {
+        return face_start.empty() ? twin.size() / 3 : face_start.size() - 1;
+    }
+
+    uint32_t face(uint32_t h) const {
+        if (face_start.empty()) {
+            return h / 3;
+        }
+        const auto it =
+            std::upper_bound(face_start.begin(), face_start.end(), h);
+        return static_cast<uint32_t>(it - face_start.begin() - 1);
+    }
+
+    //面里的下一条半边, 从它的终点出发
+    uint32_t next(uint32_t h) const {
+        if (face_start.empty()) {
+            return h % 3 == 2 ? h - 2 : h + 1;
+        }
+        const uint32_t f = face(h);
+        return h + 1 == face_start[f + 1] ? face_start[f] : h + 1;
+    }
+
+    uint32_t prev(uint32_t h) const {
+        if (face_start.empty()) {
+            return h % 3 == 0 ? h + 2 : h - 1;
+        }
+        const uint32_t f = face(h);
+        return h == face_start[f] ? face_start[f + 1] - 1 : h - 1;
+    }
+
+    // 隔着半边h的相邻面, 没有唯一的相邻面时返回kBoundary/kNonManifold
+    uint32_t neighbor(uint32_t h) const {
+        const uint32_t t = twin[h];
+        return t >= kNonManifold ? t : face(t);
+    }
+
+    bool closed() const {
+        return boundary_edges == 0 && non_manifold_edges == 0 &&
+               degenerate_half_edges == 0;
+    }
+};
+
+namespace mesh_adjacency_detail {
+
+constexpr size_t   kGrain = 16384;  //每块至少这么多元素
+constexpr unsigned kRadixBits = 8;
+constexpr size_t   kBuckets = size_t(1) << kRadixBits;
+//再小的shape每轮的直方图比排序本身还贵, 直接比较排序
+constexpr size_t kMinRadixSort = 256;
+
+inline size_t blockCount(const ThreadPool& pool, size_t n) {
+    return std::min<size_t>(pool.get_max_thread_count(), n / kGrain + 1);
+}
+
+inline unsigned bitWidth(uint64_t x) {
+    unsigned bits = 0;
+    while (x >> bits) {
+        ++bits;
+    }
+    return std::max(bits, 1u);
+}
+
+// 稳定的LSD基数排序, 只排key(item)的低key_bits位, 每轮8位.
+// 各块统计直方图, 按(桶, 块)的顺序求前缀和, 再各块并行搬到目标位置.
+// 所有元素落在同一个桶的轮次跳过. 元素很少时用std::stable_sort
+template <class T, class Key>
+void radixSort(std::vector<T>& items, unsigned key_bits, Key&& key,
+               ThreadPool& pool) {
+    const size_t n = items.size();
+    if (n < kMinRadixSort) {
+        std::stable_sort(items.begin(), items.end(),
+                         [&](const T& a, const T& b) {
+                             return key(a) < key(b);
+                         });
+        return;
+    }
+    const size_t        blocks = blockCount(pool, n);
+    std::vector<size_t> begin(blocks + 1);
+    for (size_t b = 0; b <= blocks; ++b) {
+        begin[b] = n * b / blocks;
+    }
+    std::vector<T>      tmp(n);
+    std::vector<size_t> offsets(blocks * kBuckets);
+    for (unsigned shift = 0; shift < key_bits; shift += kRadixBits) {
+        auto digit = [&](const T& item) {
+            return static_cast<size_t>(key(item) >> shift) & (kBuckets - 1);
+        };
+        pool.parallelize_loop(
+            0, blocks,
+            [&](size_t first, size_t last) {
+                for (size_t b = first; b < last; ++b) {
+                    size_t* count = &offsets[b * kBuckets];
+                    std::fill(count, count + kBuckets, 0);
+                    for (size_t i = begin[b]; i < begin[b + 1]; ++i) {
+                        ++count[digit(items[i])];
+                    }
+                }
+            },
+            blocks);
+        size_t pos = 0;
+        bool   trivial = false;
+        for (size_t d = 0; d < kBuckets; ++d) {
+            const size_t bucket_begin = pos;
+            for (size_t b = 0; b < blocks; ++b) {
+                const size_t count = offsets[b * kBuckets + d];
+                offsets[b * kBuckets + d] = pos;
+                pos += count;
+            }
+            trivial = trivial || pos - bucket_begin == n;
+        }
+        if (trivial) {
+            continue;
+        }
+        pool.parallelize_loop(
+            0, blocks,
+            [&](size_t first, size_t last) {
+                for (size_t b = first; b < last; ++b) {
+                    size_t* offset = &offsets[b * kBuckets];
+                    for (size_t i = begin[b]; i < begin[b + 1]; ++i) {
+                        tmp[offset[digit(items[i])]++] = items[i];
+                    }
+                }
+            },
+            blocks);
+        items.swap(tmp);
+    }
+}
+
+//顶点id太大, 键和半边编号塞不进一个uint64_t时用
+struct EdgeRecord {
+    uint64_t key;
+    uint32_t half_edge;
+};
+
+// 排好序的半边里相同键的一段是一条边. 各块从自己范围内的第一段开头
+// 开始, 处理开头落在范围内的段(可能越过块尾)
+template <class T, class Key, class HalfEdge>
+void pairEdges(const std::vector<T>& sorted, Key&& key,
+               HalfEdge&& half_edge, uint64_t invalid_key,
+               const std::vector<tinyobj::index_t>& indices,
+               EdgeAdjacency& adj, ThreadPool& pool) {
+    const size_t        n = sorted.size();
+    const size_t        blocks = blockCount(pool, n);
+    std::vector<size_t> edges(blocks, 0);
+    std::vector<size_t> boundary(blocks, 0);
+    std::vector<size_t> non_manifold(blocks, 0);
+    std::vector<size_t> degenerate(blocks, 0);
+    auto mark = [&](size_t first, size_t last) {
+        for (size_t m = first; m < last; ++m) {
+            adj.twin[half_edge(sorted[m])] = EdgeAdjacency::kNonManifold;
+        }
+    };
+    pool.parallelize_loop(
+        0, blocks,
+        [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                size_t       i = n * b / blocks;
+                const size_t end = n * (b + 1) / blocks;
+                while (i > 0 && i < end &&
+                       key(sorted[i]) == key(sorted[i - 1])) {
+                    ++i;
+                }
+                while (i < end) {
+                    const uint64_t k = key(sorted[i]);
+                    size_t         j = i + 1;
+                    while (j < n && key(sorted[j]) == k) {
+                        ++j;
+                    }
+                    const uint32_t h0 = half_edge(sorted[i]);
+                    if (k == invalid_key) {
+                        mark(i, j);
+                        degenerate[b] += j - i;
+                    } else if (j - i == 1) {
+                        adj.twin[h0] = EdgeAdjacency::kBoundary;
+                        ++edges[b];
+                        ++boundary[b];
+                    } else if (j - i == 2 &&
+                               indices[h0].vertex_index !=
+                                   indices[half_edge(sorted[i + 1])]
+                                       .vertex_index) {
+                        //方向相反才是一对
+                        const uint32_t h1 = half_edge(sorted[i + 1]);
+                        adj.twin[h0] = h1;
+                        adj.twin[h1] = h0;
+                        ++edges[b];
+                    } else {
+                        mark(i, j);
+                        ++edges[b];
+                        ++non_manifold[b];
+                    }
+                    i = j;
+                }
+            }
+        },
+        blocks);
+    for (size_t b = 0; b < blocks; ++b) {
+        adj.num_edges += edges[b];
+        adj.boundary_edges += boundary[b];
+        adj.non_manifold_edges += non_manifold[b];
+        adj.degenerate_half_edges += degenerate[b];
+    }
+}
+
+}  // namespace mesh_adjacency_detail
+
+// 给一个mesh建半边对边表. num_vertices是attrib里的顶点数, 超出的下标
+// 算退化边. 半边数到2^32 - 2, 或者面的角数加起来和indices对不上时
+// 返回false. 排序的临时数组每条半边8到16字节, 建完就释放
+inline bool buildEdgeAdjacency(const tinyobj::mesh_t& mesh,
+                               size_t num_vertices, EdgeAdjacency& adj,
+                               ThreadPool& pool) {
+    using namespace mesh_adjacency_detail;
+    adj = EdgeAdjacency{};
+    const size_t n = mesh.indices.size();
+    if (n >= EdgeAdjacency::kNonManifold ||
+        num_vertices > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    const size_t num_faces = tinyobj::NumFaces(mesh);
+    bool         triangles = true;
+    size_t       total = 0;
+    adj.face_start.reserve(num_faces + 1);
+    for (tinyobj::face_cursor_t c(mesh); !c.done(); c.next()) {
+        adj.face_start.push_back(static_cast<uint32_t>(total));
+        triangles = triangles && c.num_vertices() == 3;
+        total += c.num_vertices();
+        if (total > n) {
+            break;
+        }
+    }
+    if (total != n) {
+        adj.face_start.clear();
+        return false;
+    }
+    adj.face_start.push_back(static_cast<uint32_t>(n));
+    if (triangles) {
+        std::vector<uint32_t>().swap(adj.face_start);
+    }
+    adj.twin.resize(n);
+    if (n == 0) {
+        return true;
+    }
+
+    //键: 小顶点id在高位. 所有位都是1的键不会由合法的边产生, 留给退化边
+    const unsigned vbits =
+        bitWidth(num_vertices == 0 ? 0 : uint64_t(num_vertices) - 1);
+    const unsigned key_bits = 2 * vbits;
+    const uint64_t invalid_key =
+        key_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << key_bits) - 1;
+    auto edgeKey = [&](size_t h, size_t next) {
+        const auto v0 = mesh.indices[h].vertex_index;
+        const auto v1 = mesh.indices[next].vertex_index;
+        if (v0 == v1 || v0 < 0 || v1 < 0 ||
+            size_t(v0) >= num_vertices || size_t(v1) >= num_vertices) {
+            return invalid_key;
+        }
+        const uint64_t lo = uint64_t(std::min(v0, v1));
+        const uint64_t hi = uint64_t(std::max(v0, v1));
+        return lo << vbits | hi;
+    };
+    //按面分块, 面里的半边首尾相接
+    auto fill = [&](auto&& store) {
+        pool.parallelize_loop(
+            0, num_faces,
+            [&](size_t first, size_t last) {
+                for (size_t f = first; f < last; ++f) {
+                    const size_t begin =
+                        triangles ? f * 3 : adj.face_start[f];
+                    const size_t end =
+                        triangles ? begin + 3 : adj.face_start[f + 1];
+                    for (size_t h = begin; h < end; ++h) {
+                        store(h, edgeKey(h, h + 1 == end ? begin : h + 1));
+                    }
+                }
+            },
+            blockCount(pool, n));
+    };
+
+    const unsigned hbits = bitWidth(n - 1);
+    if (key_bits + hbits <= 64) {
+        //键在高位, 半边编号在低位, 只排键的位
+        std::vector<uint64_t> items(n);
+        fill([&](size_t h, uint64_t key) { items[h] = key << hbits | h; });
+        const uint64_t mask = (uint64_t(1) << hbits) - 1;
+        auto key = [&](uint64_t item) { return item >> hbits; };
+        auto half_edge = [&](uint64_t item) {
+            return static_cast<uint32_t>(item & mask);
+        };
+        radixSort(items, key_bits, key, pool);
+        pairEdges(items, key, half_edge, invalid_key, mesh.indices, adj,
+                  pool);
+    } else {
+        std::vector<EdgeRecord> items(n);
+        fill([&](size_t h, uint64_t key) {
+            items[h] = {key, static_cast<uint32_t>(h)};
+        });
+        auto key = [](const EdgeRecord& r) { return r.key; };
+        auto half_edge = [](const EdgeRecord& r) { return r.half_edge; };
+        radixSort(items, key_bits, key, pool);
+        pairEdges(items, key, half_edge, invalid_key, mesh.indices, adj,
+                  pool);
+    }
+    return true;
+}
+
+// 每个shape一个EdgeAdjacency, 顶点数取自attrib. 建不了的shape
+// (见上面)结果为空. shape之间并行, 大shape内部再分块
+inline std::vector<EdgeAdjacency> buildEdgeAdjacency(
+    const std::vector<tinyobj::shape_t>& shapes,
+    const tinyobj::attrib_t& attrib, ThreadPool& pool) {
+    std::vector<EdgeAdjacency> result(shapes.size());
+    const size_t               num_vertices = tinyobj::NumVertices(attrib);
+    pool.parallelize_loop(0, shapes.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (!buildEdgeAdjacency(shapes[i].mesh, num_vertices, result[i],
+                                    pool)) {
+                result[i] = EdgeAdjacency{};
+            }
+        }
+    });
+    return result;
+}
+
+inline std::vector<EdgeAdjacency> buildEdgeAdjacency(
+    const tinyobj::ObjReader& reader, ThreadPool& pool) {
+    return buildEdgeAdjacency(reader.GetShapes(), reader.GetAttrib(), pool);
+}
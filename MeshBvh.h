@@ -0,0 +1,650 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 加载之后建BVH: 每个shape的面一棵binned SAH树, 再在各shape的包围盒上
+// 建一棵顶层树. 面的包围盒和中心从mesh.indices和attrib算一次, 之后只在
+// 这个数组上就地划分. 大节点分块并行分桶, 左右子树并行建, 树的形状和
+// 节点顺序与线程数无关. 结果可以写进流里, 热加载时读回来代替重建.
+// 两种顶点布局都可以, 延迟解码的结果先decodeAll
+
+struct BvhNode {
+    tinyobj::real_t min[3];
+    tinyobj::real_t max[3];
+    //内部节点: 左孩子的下标, 右孩子是first + 1; 叶子: 在prims里的起点
+    uint32_t first;
+    uint32_t count;  //叶子的图元数, 内部节点为0
+
+    bool leaf() const {
+        return count != 0;
+    }
+};
+
+struct Bvh {
+    std::vector<BvhNode>  nodes;  // nodes[0]是根, 没有图元时为空
+    std::vector<uint32_t> prims;  //各叶子依次引用的图元编号
+
+    bool empty() const {
+        return nodes.empty();
+    }
+};
+
+// shapes[i]的图元是面的编号(face_cursor_t的face()), top的图元是shape编号.
+// 有越界顶点下标的面和没有面的shape不进树
+struct SceneBvh {
+    std::vector<Bvh> shapes;
+    Bvh              top;
+};
+
+struct BvhOptions {
+    unsigned bins{16};          //每个轴的桶数, 2到64
+    unsigned max_leaf_size{8};  //超过这么多图元的节点总是继续分
+    double   traversal_cost{1.0};  //遍历一个节点相对一次求交的代价
+};
+
+namespace bvh_detail {
+
+using real_t = tinyobj::real_t;
+
+constexpr size_t kMaxBins = 64;
+//超过这么多图元的节点分块并行分桶, 左右子树也并行建
+constexpr size_t   kGrain = 16384;
+constexpr uint32_t kNoPrim = std::numeric_limits<uint32_t>::max();
+constexpr real_t   kInf = std::numeric_limits<real_t>::infinity();
+
+inline size_t blockCount(const ThreadPool& pool, size_t n) {
+    return std::min<size_t>(pool.get_max_thread_count(), n / kGrain + 1);
+}
+
+struct Box {
+    real_t min[3]{kInf, kInf, kInf};
+    real_t max[3]{-kInf, -kInf, -kInf};
+
+    // NaN坐标被std::min/max忽略
+    void grow(const real_t* p) {
+        for (int a = 0; a < 3; ++a) {
+            min[a] = std::min(min[a], p[a]);
+            max[a] = std::max(max[a], p[a]);
+        }
+    }
+
+    void grow(const Box& box) {
+        for (int a = 0; a < 3; ++a) {
+            min[a] = std::min(min[a], box.min[a]);
+            max[a] = std::max(max[a], box.max[a]);
+        }
+    }
+
+    //表面积的一半, 空盒为0
+    real_t halfArea() const {
+        const real_t dx = max[0] - min[0];
+        const real_t dy = max[1] - min[1];
+        const real_t dz = max[2] - min[2];
+        if (!(dx >= 0 && dy >= 0 && dz >= 0)) {
+            return 0;
+        }
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+struct PrimRef {
+    Box      box;
+    real_t   center[3];
+    uint32_t id;
+};
+
+//中心点映射到桶
+struct Binning {
+    real_t min[3];
+    real_t scale[3];  //范围为0, 无穷或NaN的轴为0, 全落在0号桶
+    size_t bins;
+
+    Binning(const Box& centers, size_t num_bins) : bins(num_bins) {
+        for (int a = 0; a < 3; ++a) {
+            const real_t extent = centers.max[a] - centers.min[a];
+            min[a] = centers.min[a];
+            scale[a] = extent > 0 ? real_t(num_bins) / extent : 0;
+        }
+    }
+
+    size_t bin(const PrimRef& ref, int axis) const {
+        const real_t x = (ref.center[axis] - min[axis]) * scale[axis];
+        if (!(x > 0)) {
+            return 0;  //包括NaN
+        }
+        return x >= real_t(bins) ? bins - 1 : static_cast<size_t>(x);
+    }
+};
+
+struct Bins {
+    Box    box[3][kMaxBins];
+    size_t count[3][kMaxBins];
+
+    void clear(size_t bins) {
+        for (int a = 0; a < 3; ++a) {
+            std::fill(box[a], box[a] + bins, Box{});
+            std::fill(count[a], count[a] + bins, 0);
+        }
+    }
+};
+
+class Builder {
+public:
+    Builder(std::vector<PrimRef>& refs, const BvhOptions& options,
+            ThreadPool& pool)
+        : m_refs(refs),
+          m_options(options),
+          m_pool(pool),
+          m_bins(std::clamp<size_t>(options.bins, 2, kMaxBins)),
+          m_nodes(refs.empty() ? 0 : 2 * refs.size() - 1) {}
+
+    Bvh build() {
+        Bvh bvh;
+        if (m_refs.empty()) {
+            return bvh;
+        }
+        m_next = 1;
+        buildSubtree(0, m_refs.size(), 0);
+        flatten(bvh);
+        return bvh;
+    }
+
+private:
+    //节点和中心点的包围盒
+    void measure(size_t begin, size_t end, Box& bounds, Box& centers) {
+        auto grow = [&](size_t i0, size_t i1, Box& b, Box& c) {
+            for (size_t i = i0; i < i1; ++i) {
+                b.grow(m_refs[i].box);
+                c.grow(m_refs[i].center);
+            }
+        };
+        const size_t n = end - begin;
+        const size_t blocks = blockCount(m_pool, n);
+        if (blocks == 1) {
+            grow(begin, end, bounds, centers);
+            return;
+        }
+        std::vector<Box> partial(2 * blocks);
+        m_pool.parallelize_loop(
+            0, blocks,
+            [&](size_t first, size_t last) {
+                for (size_t b = first; b < last; ++b) {
+                    grow(begin + n * b / blocks,
+                         begin + n * (b + 1) / blocks, partial[2 * b],
+                         partial[2 * b + 1]);
+                }
+            },
+            blocks);
+        for (size_t b = 0; b < blocks; ++b) {
+            bounds.grow(partial[2 * b]);
+            centers.grow(partial[2 * b + 1]);
+        }
+    }
+
+    void fillBins(size_t begin, size_t end, const Binning& binning,
+                  Bins& bins) {
+        auto fill = [&](size_t i0, size_t i1, Bins& out) {
+            out.clear(binning.bins);
+            for (size_t i = i0; i < i1; ++i) {
+                //拷一份, 写桶时编译器不用再从m_refs重读
+                const PrimRef ref = m_refs[i];
+                for (int a = 0; a < 3; ++a) {
+                    const size_t k = binning.bin(ref, a);
+                    out.box[a][k].grow(ref.box);
+                    ++out.count[a][k];
+                }
+            }
+        };
+        const size_t n = end - begin;
+        const size_t blocks = blockCount(m_pool, n);
+        if (blocks == 1) {
+            fill(begin, end, bins);
+            return;
+        }
+        //各块分到自己的桶里再合并, 合并只有min/max和计数, 与块数无关
+        std::vector<Bins> partial(blocks);
+        m_pool.parallelize_loop(
+            0, blocks,
+            [&](size_t first, size_t last) {
+                for (size_t b = first; b < last; ++b) {
+                    fill(begin + n * b / blocks,
+                         begin + n * (b + 1) / blocks, partial[b]);
+                }
+            },
+            blocks);
+        bins.clear(binning.bins);
+        for (const Bins& p : partial) {
+            for (int a = 0; a < 3; ++a) {
+                for (size_t k = 0; k < binning.bins; ++k) {
+                    bins.box[a][k].grow(p.box[a][k]);
+                    bins.count[a][k] += p.count[a][k];
+                }
+            }
+        }
+    }
+
+    // 算出node的包围盒, 按SAH找最好的桶边界并就地划分m_refs[begin, end),
+    // 右半的起点写到mid. 做叶子时返回false
+    bool splitNode(size_t begin, size_t end, uint32_t node, Bins& bins,
+                   size_t& mid) {
+        const size_t n = end - begin;
+        Box          bounds;
+        Box          centers;
+        measure(begin, end, bounds, centers);
+        BvhNode& out = m_nodes[node];
+        std::copy(bounds.min, bounds.min + 3, out.min);
+        std::copy(bounds.max, bounds.max + 3, out.max);
+        out.first = static_cast<uint32_t>(begin);
+        out.count = static_cast<uint32_t>(n);
+        if (n <= 1) {
+            return false;
+        }
+
+        //图元比桶少时多出来的桶只会是空的
+        const Binning binning(centers, std::min<size_t>(m_bins, n));
+        fillBins(begin, end, binning, bins);
+        int    best_axis = -1;
+        size_t best_bin = 0;
+        real_t best_cost = kInf;  //左右两边的面积乘图元数之和
+        for (int a = 0; a < 3; ++a) {
+            real_t right_area[kMaxBins];
+            size_t right_count[kMaxBins];
+            Box    right;
+            size_t count = 0;
+            for (size_t k = binning.bins; k-- > 1;) {
+                right.grow(bins.box[a][k]);
+                count += bins.count[a][k];
+                right_area[k] = right.halfArea();
+                right_count[k] = count;
+            }
+            Box left;
+            count = 0;
+            for (size_t k = 0; k + 1 < binning.bins; ++k) {
+                left.grow(bins.box[a][k]);
+                count += bins.count[a][k];
+                if (count == 0 || right_count[k + 1] == 0) {
+                    continue;
+                }
+                const real_t cost =
+                    left.halfArea() * real_t(count) +
+                    right_area[k + 1] * real_t(right_count[k + 1]);
+                if (cost < best_cost) {
+                    best_axis = a;
+                    best_bin = k;
+                    best_cost = cost;
+                }
+            }
+        }
+
+        const real_t area = bounds.halfArea();
+        if (n <= m_options.max_leaf_size) {
+            //分开的期望代价不低于直接求交n次就做叶子
+            const bool leaf =
+                best_axis < 0 || !(area > 0) ||
+                !(m_options.traversal_cost + best_cost / area < real_t(n));
+            if (leaf) {
+                return false;
+            }
+        }
+        if (best_axis < 0) {
+            //中心点分不开(重合或者坐标异常), 从中间分
+            mid = begin + n / 2;
+        } else {
+            const auto it = std::partition(
+                m_refs.begin() + begin, m_refs.begin() + end,
+                [&](const PrimRef& ref) {
+                    return binning.bin(ref, best_axis) <= best_bin;
+                });
+            mid = static_cast<size_t>(it - m_refs.begin());
+        }
+        return true;
+    }
+
+    // 大子树: 划分后左右并行; 小子树在当前线程用显式栈, 不怕偏斜的树
+    // 递归太深
+    void buildSubtree(size_t begin, size_t end, uint32_t node) {
+        Bins   bins;
+        size_t mid = 0;
+        if (end - begin >= kGrain) {
+            if (!splitNode(begin, end, node, bins, mid)) {
+                return;
+            }
+            const uint32_t left = m_next.fetch_add(2);
+            m_nodes[node].first = left;
+            m_nodes[node].count = 0;
+            m_pool.parallelize_loop(
+                0, 2,
+                [&](size_t first, size_t last) {
+                    for (size_t c = first; c < last; ++c) {
+                        if (c == 0) {
+                            buildSubtree(begin, mid, left);
+                        } else {
+                            buildSubtree(mid, end, left + 1);
+                        }
+                    }
+                },
+                2);
+            return;
+        }
+        struct Item {
+            size_t   begin;
+            size_t   end;
+            uint32_t node;
+        };
+        std::vector<Item> stack{{begin, end, node}};
+        while (!stack.empty()) {
+            const Item item = stack.back();
+            stack.pop_back();
+            if (!splitNode(item.begin, item.end, item.node, bins, mid)) {
+                continue;
+            }
+            const uint32_t left = m_next.fetch_add(2);
+            m_nodes[item.node].first = left;
+            m_nodes[item.node].count = 0;
+            stack.push_back({mid, item.end, left + 1});
+            stack.push_back({item.begin, mid, left});
+        }
+    }
+
+    //并行建的节点编号取决于调度, 按深度优先重新编号
+    void flatten(Bvh& bvh) {
+        bvh.nodes.resize(m_next);
+        std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}};
+        uint32_t                                   next = 1;
+        while (!stack.empty()) {
+            const auto [from, to] = stack.back();
+            stack.pop_back();
+            const BvhNode& node = m_nodes[from];
+            bvh.nodes[to] = node;
+            if (!node.leaf()) {
+                bvh.nodes[to].first = next;
+                stack.push_back({node.first + 1, next + 1});
+                stack.push_back({node.first, next});
+                next += 2;
+            }
+        }
+        bvh.prims.resize(m_refs.size());
+        for (size_t i = 0; i < m_refs.size(); ++i) {
+            bvh.prims[i] = m_refs[i].id;
+        }
+    }
+
+    std::vector<PrimRef>& m_refs;
+    const BvhOptions&     m_options;
+    ThreadPool&           m_pool;
+    const size_t          m_bins;
+    std::vector<BvhNode>  m_nodes;
+    std::atomic<uint32_t> m_next{0};
+};
+
+// mesh的每个面一个图元. 顶点下标越界的面, 超出indices的面跳过
+inline std::vector<PrimRef> faceRefs(const tinyobj::mesh_t&   mesh,
+                                     const tinyobj::attrib_t& attrib,
+                                     ThreadPool&              pool) {
+    //每个面的起点, 末尾是总数. 全是三角形时为空
+    std::vector<size_t> face_start;
+    bool                triangles = true;
+    size_t              total = 0;
+    for (tinyobj::face_cursor_t c(mesh); !c.done(); c.next()) {
+        if (total + c.num_vertices() > mesh.indices.size()) {
+            break;
+        }
+        face_start.push_back(total);
+        triangles = triangles && c.num_vertices() == 3;
+        total += c.num_vertices();
+    }
+    const size_t num_faces = face_start.size();
+    face_start.push_back(total);
+    if (triangles) {
+        std::vector<size_t>().swap(face_start);
+    }
+
+    const size_t         num_vertices = tinyobj::NumVertices(attrib);
+    std::vector<PrimRef> refs(num_faces);
+    pool.parallelize_loop(
+        0, num_faces,
+        [&](size_t first, size_t last) {
+            for (size_t f = first; f < last; ++f) {
+                const size_t begin = triangles ? f * 3 : face_start[f];
+                const size_t end =
+                    triangles ? begin + 3 : face_start[f + 1];
+                PrimRef&     ref = refs[f];
+                ref.id = begin == end ? kNoPrim : static_cast<uint32_t>(f);
+                for (size_t h = begin; h < end; ++h) {
+                    const auto v = mesh.indices[h].vertex_index;
+                    if (v < 0 || size_t(v) >= num_vertices) {
+                        ref.id = kNoPrim;
+                        break;
+                    }
+                    real_t p[3];
+                    tinyobj::GetVertex(attrib, size_t(v), p);
+                    ref.box.grow(p);
+                }
+                for (int a = 0; a < 3; ++a) {
+                    ref.center[a] = (ref.box.min[a] + ref.box.max[a]) / 2;
+                }
+            }
+        },
+        blockCount(pool, num_faces));
+    refs.erase(std::remove_if(refs.begin(), refs.end(),
+                              [](const PrimRef& ref) {
+                                  return ref.id == kNoPrim;
+                              }),
+               refs.end());
+    return refs;
+}
+
+template <class T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+bool readValue(std::istream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <class T>
+void writeArray(std::ostream& out, const std::vector<T>& items) {
+    writeValue(out, uint64_t(items.size()));
+    out.write(reinterpret_cast<const char*>(items.data()),
+              std::streamsize(items.size() * sizeof(T)));
+}
+
+//元素数超过limit的数组当作损坏, 不去分配
+template <class T>
+bool readArray(std::istream& in, std::vector<T>& items, uint64_t limit) {
+    uint64_t size = 0;
+    if (!readValue(in, size) || size > limit) {
+        return false;
+    }
+    items.resize(size);
+    return bool(in.read(reinterpret_cast<char*>(items.data()),
+                        std::streamsize(size * sizeof(T))));
+}
+
+//节点引用都在范围内, 孩子在父节点之后, 遍历不会越界或者绕圈
+inline bool validLayout(const Bvh& bvh, uint64_t num_prims) {
+    const uint64_t nodes = bvh.nodes.size();
+    if (nodes == 0 && !bvh.prims.empty()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < nodes; ++i) {
+        const BvhNode& node = bvh.nodes[i];
+        if (node.leaf()) {
+            if (uint64_t(node.first) + node.count > bvh.prims.size()) {
+                return false;
+            }
+        } else if (node.first <= i || uint64_t(node.first) + 1 >= nodes) {
+            return false;
+        }
+    }
+    for (const uint32_t prim : bvh.prims) {
+        if (prim >= num_prims) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void writeBvh(std::ostream& out, const Bvh& bvh,
+                     uint64_t num_prims) {
+    writeValue(out, num_prims);
+    writeArray(out, bvh.nodes);
+    writeArray(out, bvh.prims);
+}
+
+inline bool readBvh(std::istream& in, Bvh& bvh, uint64_t num_prims) {
+    uint64_t saved = 0;
+    return readValue(in, saved) && saved == num_prims &&
+           readArray(in, bvh.nodes, 2 * num_prims) &&
+           readArray(in, bvh.prims, num_prims) &&
+           validLayout(bvh, num_prims);
+}
+
+constexpr char     kMagic[8] = {'O', 'B', 'J', 'L', 'B', 'V', 'H', '\0'};
+constexpr uint32_t kVersion = 1;
+
+static_assert(std::is_trivially_copyable_v<BvhNode>);
+
+}  // namespace bvh_detail
+
+// 一个mesh的面建一棵树. 面数到2^32 - 1时返回空树
+inline Bvh buildBvh(const tinyobj::mesh_t&   mesh,
+                    const tinyobj::attrib_t& attrib, ThreadPool& pool,
+                    const BvhOptions& options = {}) {
+    using namespace bvh_detail;
+    if (tinyobj::NumFaces(mesh) >= kNoPrim) {
+        return {};
+    }
+    std::vector<PrimRef> refs = faceRefs(mesh, attrib, pool);
+    return Builder(refs, options, pool).build();
+}
+
+// 各shape的树(shape之间并行, 大shape内部再并行), 再建顶层树
+inline SceneBvh buildSceneBvh(const std::vector<tinyobj::shape_t>& shapes,
+                              const tinyobj::attrib_t&             attrib,
+                              ThreadPool&                          pool,
+                              const BvhOptions& options = {}) {
+    using namespace bvh_detail;
+    SceneBvh scene;
+    scene.shapes.resize(shapes.size());
+    pool.parallelize_loop(0, shapes.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            scene.shapes[i] =
+                buildBvh(shapes[i].mesh, attrib, pool, options);
+        }
+    });
+    std::vector<PrimRef> refs;
+    for (size_t i = 0; i < shapes.size() && i < kNoPrim; ++i) {
+        if (scene.shapes[i].empty()) {
+            continue;
+        }
+        const BvhNode& root = scene.shapes[i].nodes[0];
+        PrimRef        ref;
+        std::copy(root.min, root.min + 3, ref.box.min);
+        std::copy(root.max, root.max + 3, ref.box.max);
+        for (int a = 0; a < 3; ++a) {
+            ref.center[a] = (root.min[a] + root.max[a]) / 2;
+        }
+        ref.id = static_cast<uint32_t>(i);
+        refs.push_back(ref);
+    }
+    scene.top = Builder(refs, options, pool).build();
+    return scene;
+}
+
+inline SceneBvh buildSceneBvh(const tinyobj::ObjReader& reader,
+                              ThreadPool&               pool,
+                              const BvhOptions&         options = {}) {
+    return buildSceneBvh(reader.GetShapes(), reader.GetAttrib(), pool,
+                         options);
+}
+
+// SAH代价: 从根出发的期望遍历次数乘traversal_cost加上期望求交次数,
+// 比较不同的建法用
+inline double sahCost(const Bvh& bvh, double traversal_cost = 1.0) {
+    auto area = [](const BvhNode& node) {
+        bvh_detail::Box box;
+        std::copy(node.min, node.min + 3, box.min);
+        std::copy(node.max, node.max + 3, box.max);
+        return double(box.halfArea());
+    };
+    if (bvh.empty() || !(area(bvh.nodes[0]) > 0)) {
+        return 0.0;
+    }
+    double cost = 0.0;
+    for (const BvhNode& node : bvh.nodes) {
+        cost += area(node) * (node.leaf() ? node.count : traversal_cost);
+    }
+    return cost / area(bvh.nodes[0]);
+}
+
+// 写出SceneBvh, 跟在解析结果的缓存后面. 本机字节序的原始数组,
+// 带real_t的大小以及顶点数, shape数和每个shape的面数.
+// scene不是这组shapes建的(shape数不同)时什么都不写, 返回false;
+// 写失败时也返回false
+inline bool saveSceneBvh(std::ostream& out, const SceneBvh& scene,
+                         const std::vector<tinyobj::shape_t>& shapes,
+                         const tinyobj::attrib_t&             attrib) {
+    using namespace bvh_detail;
+    if (scene.shapes.size() != shapes.size()) {
+        return false;
+    }
+    out.write(kMagic, sizeof(kMagic));
+    writeValue(out, kVersion);
+    writeValue(out, uint32_t(sizeof(tinyobj::real_t)));
+    writeValue(out, uint64_t(tinyobj::NumVertices(attrib)));
+    writeValue(out, uint64_t(shapes.size()));
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        writeBvh(out, scene.shapes[i], tinyobj::NumFaces(shapes[i].mesh));
+    }
+    writeBvh(out, scene.top, shapes.size());
+    return static_cast<bool>(out);
+}
+
+// 读回saveSceneBvh写的树. 和当前的解析结果(顶点数, 每个shape的面数)
+// 或本机的real_t对不上, 或者数据损坏时返回false, 调用方重建.
+// 只核对数量, 缓存本身要按文件(路径, 大小, 修改时间)区分
+inline bool loadSceneBvh(std::istream& in, SceneBvh& scene,
+                         const std::vector<tinyobj::shape_t>& shapes,
+                         const tinyobj::attrib_t&             attrib) {
+    using namespace bvh_detail;
+    char     magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    uint32_t real_size = 0;
+    uint64_t num_vertices = 0;
+    uint64_t num_shapes = 0;
+    if (!in.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), kMagic) ||
+        !readValue(in, version) || version != kVersion ||
+        !readValue(in, real_size) ||
+        real_size != sizeof(tinyobj::real_t) ||
+        !readValue(in, num_vertices) ||
+        num_vertices != tinyobj::NumVertices(attrib) ||
+        !readValue(in, num_shapes) || num_shapes != shapes.size()) {
+        return false;
+    }
+    SceneBvh result;
+    result.shapes.resize(shapes.size());
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        if (!readBvh(in, result.shapes[i],
+                     tinyobj::NumFaces(shapes[i].mesh))) {
+            return false;
+        }
+    }
+    if (!readBvh(in, result.top, shapes.size())) {
+        return false;
+    }
+    scene = std::move(result);
+    return true;
+}
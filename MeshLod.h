@@ -0,0 +1,704 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 加载之后按二次误差(QEM)给每个shape生成几级简化的三角形下标. 只把边的
+// 一端并到另一端(半边坍缩), 不产生新顶点, 结果直接引用原来的attrib.
+// 一个shape的各级从上一级接着坍缩, 一遍走完整条LOD链; shape之间在
+// 线程池上并行, 面多的shape先开始.
+// 边界上的顶点只沿边界并; 法线/纹理坐标不止一组的顶点(接缝), 材质交界
+// 和三个以上面共用的边上的顶点不会被并掉, 只能作为目标.
+// 多边形按扇形拆成三角形. 延迟解码的结果先decodeAll
+
+struct LodLevel {
+    double ratio{1.0};  //要求的三角形比例
+    double error{0.0};  //到这一级为止最大的坍缩误差, 和坐标同单位
+    std::vector<tinyobj::index_t> indices;       //每3个一个三角形
+    std::vector<int>              material_ids;  //每个三角形的材质
+};
+
+struct LodOptions {
+    std::vector<double> ratios{0.5, 0.25, 0.125};  //从大到小
+    double              max_error{0.0};  //误差超过它就不再坍缩, 0为不限
+    double              border_weight{10.0};  //边界约束相对面的权重
+};
+
+namespace lod_detail {
+
+using tinyobj::index_t;
+
+//坍缩后每个面的法线和原来的夹角余弦不低于它, 防止翻面和压扁
+constexpr double   kMinCos = 0.2;
+constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+enum : uint8_t {
+    kBorder = 1,  //在只属于一个面的边上
+    kLocked = 2,  //接缝, 材质交界, 非流形边或坐标不是有限值
+    kGone = 4,    //已经并到别的顶点
+};
+
+//到一组平面距离平方的加权和, 对称矩阵只存上三角
+struct Quadric {
+    double a00{0}, a01{0}, a02{0}, a11{0}, a12{0}, a22{0};
+    double b0{0}, b1{0}, b2{0}, c{0};
+    double w{0};
+
+    //单位法线n, 平面n·p + d = 0
+    void addPlane(const double n[3], double d, double weight) {
+        a00 += weight * n[0] * n[0];
+        a01 += weight * n[0] * n[1];
+        a02 += weight * n[0] * n[2];
+        a11 += weight * n[1] * n[1];
+        a12 += weight * n[1] * n[2];
+        a22 += weight * n[2] * n[2];
+        b0 += weight * n[0] * d;
+        b1 += weight * n[1] * d;
+        b2 += weight * n[2] * d;
+        c += weight * d * d;
+        w += weight;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00, a01 += q.a01, a02 += q.a02;
+        a11 += q.a11, a12 += q.a12, a22 += q.a22;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2;
+        c += q.c, w += q.w;
+    }
+
+    //两个quadric之和在p处按权重平均的距离平方
+    static double error(const Quadric& a, const Quadric& b,
+                        const double p[3]) {
+        const double x = p[0], y = p[1], z = p[2];
+        const double q =
+            (a.a00 + b.a00) * x * x + (a.a11 + b.a11) * y * y +
+            (a.a22 + b.a22) * z * z +
+            2 * ((a.a01 + b.a01) * x * y + (a.a02 + b.a02) * x * z +
+                 (a.a12 + b.a12) * y * z) +
+            2 * ((a.b0 + b.b0) * x + (a.b1 + b.b1) * y +
+                 (a.b2 + b.b2) * z) +
+            a.c + b.c;
+        const double w = a.w + b.w;
+        return w > 0 ? std::max(q / w, 0.0) : 0.0;
+    }
+};
+
+struct Triangle {
+    uint32_t v[3];       // shape内的顶点编号
+    index_t  corner[3];  //输出的下标
+    int      material;
+    bool     dead{false};
+};
+
+struct Candidate {
+    double   cost;
+    uint32_t from, to;
+    uint32_t from_version, to_version;
+    bool     reverse;  //另一个方向也可以坍缩, 这个方向不行时再试
+
+    //代价相同时按编号, 结果不依赖堆的实现
+    bool operator>(const Candidate& o) const {
+        if (cost != o.cost) {
+            return cost > o.cost;
+        }
+        return from != o.from ? from > o.from : to > o.to;
+    }
+};
+
+inline void sub(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+inline void cross(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot(const double a[3], const double b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//三个点的法线, 长度是面积的两倍
+inline void faceNormal(const double* p0, const double* p1,
+                       const double* p2, double out[3]) {
+    double e1[3], e2[3];
+    sub(p1, p0, e1);
+    sub(p2, p0, e2);
+    cross(e1, e2, out);
+}
+
+//顶点所在的面在m_face_pool里的一段, 可能含死面
+struct FaceList {
+    size_t   first{0};
+    uint32_t count{0};
+    uint32_t capacity{0};
+};
+
+struct FaceRange {
+    const uint32_t* first;
+    const uint32_t* last;
+
+    const uint32_t* begin() const {
+        return first;
+    }
+    const uint32_t* end() const {
+        return last;
+    }
+};
+
+using Heap = std::priority_queue<Candidate, std::vector<Candidate>,
+                                 std::greater<Candidate>>;
+
+//一个shape的坍缩过程, 只在一个线程上用
+class Simplifier {
+public:
+    Simplifier(const tinyobj::mesh_t& mesh, const tinyobj::attrib_t& attrib,
+               const LodOptions& options)
+        : m_attrib(attrib), m_options(options) {
+        collectTriangles(mesh);
+    }
+
+    std::vector<LodLevel> run() {
+        std::vector<LodLevel> levels;
+        const double limit = m_options.max_error * m_options.max_error;
+        bool         stopped = false;
+        for (const double ratio : m_options.ratios) {
+            const double clamped = std::min(std::max(ratio, 0.0), 1.0);
+            const size_t target =
+                size_t(std::ceil(clamped * double(m_tris.size())));
+            //一个三角形的shape之类不用坍缩的, 不建顶点表和堆
+            if (m_live > target && m_lists.empty()) {
+                prepare();
+            }
+            while (m_live > target && !m_heap.empty() && !stopped) {
+                const Candidate c = m_heap.top();
+                m_heap.pop();
+                if (stale(c)) {
+                    continue;
+                }
+                if (limit > 0 && c.cost > limit) {
+                    stopped = true;
+                    break;
+                }
+                if (!collapse(c) && c.reverse) {
+                    push(c.to, c.from);
+                }
+            }
+            levels.push_back(emit(ratio));
+        }
+        return levels;
+    }
+
+private:
+    void collectTriangles(const tinyobj::mesh_t& mesh) {
+        const size_t num_vertices = tinyobj::NumVertices(m_attrib);
+        for (tinyobj::face_cursor_t c(mesh); !c.done(); c.next()) {
+            const size_t n = c.num_vertices();
+            const size_t offset = c.index_offset();
+            if (offset + n > mesh.indices.size()) {
+                break;
+            }
+            bool valid = n >= 3;
+            for (size_t k = 0; k < n && valid; ++k) {
+                const auto v = mesh.indices[offset + k].vertex_index;
+                valid = v >= 0 && size_t(v) < num_vertices;
+            }
+            for (size_t k = 1; valid && k + 1 < n; ++k) {
+                const index_t& a = mesh.indices[offset];
+                const index_t& b = mesh.indices[offset + k];
+                const index_t& d = mesh.indices[offset + k + 1];
+                if (a.vertex_index == b.vertex_index ||
+                    a.vertex_index == d.vertex_index ||
+                    b.vertex_index == d.vertex_index) {
+                    continue;
+                }
+                Triangle tri;
+                tri.corner[0] = a;
+                tri.corner[1] = b;
+                tri.corner[2] = d;
+                tri.material = c.material_id();
+                m_tris.push_back(tri);
+            }
+        }
+        m_live = m_tris.size();
+    }
+
+    void prepare() {
+        numberVertices();
+
+        //每个顶点第一次见到的法线/纹理坐标和材质, 之后不一样就是接缝
+        const size_t         num_local = m_lists.size();
+        std::vector<index_t> first_corner(num_local);
+        std::vector<int>     first_material(num_local);
+        std::vector<uint8_t> seen(num_local, 0);
+        for (const Triangle& tri : m_tris) {
+            for (int k = 0; k < 3; ++k) {
+                const index_t& corner = tri.corner[k];
+                const uint32_t v = tri.v[k];
+                if (!seen[v]) {
+                    seen[v] = 1;
+                    first_corner[v] = corner;
+                    first_material[v] = tri.material;
+                } else if (first_corner[v].normal_index !=
+                               corner.normal_index ||
+                           first_corner[v].texcoord_index !=
+                               corner.texcoord_index ||
+                           first_material[v] != tri.material) {
+                    m_flags[v] |= kLocked;
+                }
+            }
+        }
+        for (size_t v = 0; v < num_local; ++v) {
+            const double* p = position(uint32_t(v));
+            if (!std::isfinite(p[0]) || !std::isfinite(p[1]) ||
+                !std::isfinite(p[2])) {
+                m_flags[v] |= kLocked;
+            }
+        }
+        computeQuadrics();
+    }
+
+    //用到的顶点按第一次出现的顺序编号, 下标范围不大时查表, 否则排序.
+    //顺带建每个顶点的面表
+    void numberVertices() {
+        const size_t         corners = m_tris.size() * 3;
+        tinyobj::index_int_t lo =
+            m_tris.empty() ? 0 : m_tris[0].corner[0].vertex_index;
+        tinyobj::index_int_t hi = lo;
+        for (const Triangle& tri : m_tris) {
+            for (const index_t& corner : tri.corner) {
+                lo = std::min(lo, corner.vertex_index);
+                hi = std::max(hi, corner.vertex_index);
+            }
+        }
+        std::vector<tinyobj::index_int_t> global;
+        if (size_t(hi - lo) < 4 * corners) {
+            std::vector<uint32_t> local(size_t(hi - lo) + 1, kNone);
+            for (Triangle& tri : m_tris) {
+                for (int k = 0; k < 3; ++k) {
+                    const auto v = tri.corner[k].vertex_index;
+                    uint32_t&  id = local[size_t(v - lo)];
+                    if (id == kNone) {
+                        id = uint32_t(global.size());
+                        global.push_back(v);
+                    }
+                    tri.v[k] = id;
+                }
+            }
+        } else {
+            global.reserve(corners);
+            for (const Triangle& tri : m_tris) {
+                for (const index_t& corner : tri.corner) {
+                    global.push_back(corner.vertex_index);
+                }
+            }
+            std::sort(global.begin(), global.end());
+            global.erase(std::unique(global.begin(), global.end()),
+                         global.end());
+            for (Triangle& tri : m_tris) {
+                for (int k = 0; k < 3; ++k) {
+                    tri.v[k] = uint32_t(
+                        std::lower_bound(global.begin(), global.end(),
+                                         tri.corner[k].vertex_index) -
+                        global.begin());
+                }
+            }
+        }
+
+        m_pos.resize(global.size() * 3);
+        for (size_t i = 0; i < global.size(); ++i) {
+            tinyobj::real_t p[3];
+            tinyobj::GetVertex(m_attrib, size_t(global[i]), p);
+            std::copy(p, p + 3, &m_pos[i * 3]);
+        }
+        m_flags.assign(global.size(), 0);
+        m_version.assign(global.size(), 0);
+        m_lists.assign(global.size(), FaceList());
+        for (const Triangle& tri : m_tris) {
+            for (const uint32_t v : tri.v) {
+                ++m_lists[v].capacity;
+            }
+        }
+        size_t first = 0;
+        for (FaceList& list : m_lists) {
+            list.first = first;
+            first += list.capacity;
+        }
+        m_face_pool.resize(first);
+        for (uint32_t t = 0; t < m_tris.size(); ++t) {
+            for (const uint32_t v : m_tris[t].v) {
+                FaceList& list = m_lists[v];
+                m_face_pool[list.first + list.count++] = t;
+            }
+        }
+    }
+
+    const double* position(uint32_t v) const {
+        return &m_pos[size_t(v) * 3];
+    }
+
+    //面的平面加到三个顶点上, 边界边再加一个过边且垂直于面的平面.
+    //从每个顶点的面表数出它和编号更大的邻点之间的边属于几个面,
+    //找出边界边和非流形边, 每条边放一个候选进堆
+    void computeQuadrics() {
+        m_quadrics.resize(m_lists.size());
+        for (const Triangle& tri : m_tris) {
+            double n[3];
+            faceNormal(position(tri.v[0]), position(tri.v[1]),
+                       position(tri.v[2]), n);
+            const double length = std::sqrt(dot(n, n));
+            if (length > 0 && std::isfinite(length)) {
+                const double unit[3] = {n[0] / length, n[1] / length,
+                                        n[2] / length};
+                const double d = -dot(unit, position(tri.v[0]));
+                for (const uint32_t v : tri.v) {
+                    m_quadrics[v].addPlane(unit, d, length / 2);
+                }
+            }
+        }
+
+        struct Edge {
+            uint32_t to;
+            uint32_t tri;
+            int      k;  //从tri.v[k]到tri.v[(k + 1) % 3]
+        };
+        std::vector<Edge>                          ring;
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        for (uint32_t a = 0; a < m_lists.size(); ++a) {
+            ring.clear();
+            for (const uint32_t t : liveFaces(a)) {
+                const uint32_t* v = m_tris[t].v;
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t u = v[k];
+                    const uint32_t w = v[(k + 1) % 3];
+                    if ((u == a && w > a) || (w == a && u > a)) {
+                        ring.push_back({u == a ? w : u, t, k});
+                    }
+                }
+            }
+            std::sort(ring.begin(), ring.end(),
+                      [](const Edge& x, const Edge& y) {
+                          return x.to != y.to ? x.to < y.to : x.tri < y.tri;
+                      });
+            for (size_t i = 0; i < ring.size();) {
+                size_t j = i + 1;
+                while (j < ring.size() && ring[j].to == ring[i].to) {
+                    ++j;
+                }
+                const uint32_t b = ring[i].to;
+                if (j - i == 1) {
+                    addBorderPlane(m_tris[ring[i].tri], ring[i].k);
+                    m_flags[a] |= kBorder;
+                    m_flags[b] |= kBorder;
+                } else if (j - i > 2) {
+                    m_flags[a] |= kLocked;
+                    m_flags[b] |= kLocked;
+                }
+                edges.emplace_back(a, b);
+                i = j;
+            }
+        }
+
+        //放齐了再建堆
+        std::vector<Candidate> candidates;
+        candidates.reserve(edges.size());
+        Candidate c;
+        for (const auto& [a, b] : edges) {
+            if (edgeCandidate(a, b, c)) {
+                candidates.push_back(c);
+            }
+        }
+        m_heap = Heap(std::greater<Candidate>(), std::move(candidates));
+    }
+
+    void addBorderPlane(const Triangle& tri, int k) {
+        const double* p0 = position(tri.v[k]);
+        const double* p1 = position(tri.v[(k + 1) % 3]);
+        double        n[3], e[3], m[3];
+        faceNormal(position(tri.v[0]), position(tri.v[1]),
+                   position(tri.v[2]), n);
+        sub(p1, p0, e);
+        cross(e, n, m);
+        const double length = std::sqrt(dot(m, m));
+        if (!(length > 0) || !std::isfinite(length)) {
+            return;
+        }
+        const double unit[3] = {m[0] / length, m[1] / length,
+                                m[2] / length};
+        const double d = -dot(unit, p0);
+        const double weight = m_options.border_weight * dot(e, e);
+        m_quadrics[tri.v[k]].addPlane(unit, d, weight);
+        m_quadrics[tri.v[(k + 1) % 3]].addPlane(unit, d, weight);
+    }
+
+    bool candidate(uint32_t from, uint32_t to, Candidate& out) const {
+        if (m_flags[from] & (kLocked | kGone)) {
+            return false;
+        }
+        const double cost =
+            Quadric::error(m_quadrics[from], m_quadrics[to], position(to));
+        out = {cost, from, to, m_version[from], m_version[to], false};
+        return std::isfinite(cost);
+    }
+
+    //一条边只放代价小的方向, 记下另一个方向能不能用
+    bool edgeCandidate(uint32_t a, uint32_t b, Candidate& out) const {
+        Candidate  reverse;
+        const bool forward_ok = candidate(a, b, out);
+        const bool reverse_ok = candidate(b, a, reverse);
+        if (forward_ok && reverse_ok) {
+            if (out > reverse) {
+                std::swap(out, reverse);
+            }
+            out.reverse = true;
+        } else if (reverse_ok) {
+            out = reverse;
+        }
+        return forward_ok || reverse_ok;
+    }
+
+    void pushEdge(uint32_t a, uint32_t b) {
+        Candidate c;
+        if (edgeCandidate(a, b, c)) {
+            m_heap.push(c);
+        }
+    }
+
+    void push(uint32_t from, uint32_t to) {
+        Candidate c;
+        if (candidate(from, to, c)) {
+            m_heap.push(c);
+        }
+    }
+
+    bool stale(const Candidate& c) const {
+        return m_version[c.from] != c.from_version ||
+               m_version[c.to] != c.to_version ||
+               ((m_flags[c.from] | m_flags[c.to]) & kGone);
+    }
+
+    //v所在的活着的面, 顺带把死面从表里清掉. appendFace之后失效
+    FaceRange liveFaces(uint32_t v) {
+        FaceList& list = m_lists[v];
+        uint32_t* begin = m_face_pool.data() + list.first;
+        uint32_t* end =
+            std::remove_if(begin, begin + list.count,
+                           [&](uint32_t t) { return m_tris[t].dead; });
+        list.count = uint32_t(end - begin);
+        return {begin, end};
+    }
+
+    //放不下时把整段搬到末尾, 容量翻倍
+    void appendFace(uint32_t v, uint32_t t) {
+        FaceList& list = m_lists[v];
+        if (list.count == list.capacity) {
+            const size_t first = m_face_pool.size();
+            list.capacity = std::max(2 * list.capacity, 8u);
+            m_face_pool.resize(first + list.capacity);
+            std::copy_n(m_face_pool.begin() + list.first, list.count,
+                        m_face_pool.begin() + first);
+            list.first = first;
+        }
+        m_face_pool[list.first + list.count++] = t;
+    }
+
+    //面表里除v以外的顶点, 排好序去重
+    void neighbors(uint32_t v, std::vector<uint32_t>& out) {
+        out.clear();
+        for (const uint32_t t : liveFaces(v)) {
+            for (const uint32_t u : m_tris[t].v) {
+                if (u != v) {
+                    out.push_back(u);
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    //把from并到to, 不满足条件时什么也不改, 返回false
+    bool collapse(const Candidate& c) {
+        const uint32_t a = c.from;
+        const uint32_t b = c.to;
+        m_removed.clear();
+        m_kept.clear();
+        for (const uint32_t t : liveFaces(a)) {
+            const uint32_t* v = m_tris[t].v;
+            const bool      has_b = v[0] == b || v[1] == b || v[2] == b;
+            (has_b ? m_removed : m_kept).push_back(t);
+        }
+        //内部的边两侧各一个面, 边界点只沿边界边走
+        if (m_removed.size() != ((m_flags[a] & kBorder) ? 1u : 2u)) {
+            return false;
+        }
+
+        //两端共同的邻点只能是被删掉的面的第三个点, 否则会粘出非流形
+        neighbors(a, m_ring_a);
+        neighbors(b, m_ring_b);
+        size_t common = 0;
+        for (size_t i = 0, j = 0;
+             i < m_ring_a.size() && j < m_ring_b.size();) {
+            if (m_ring_a[i] < m_ring_b[j]) {
+                ++i;
+            } else if (m_ring_b[j] < m_ring_a[i]) {
+                ++j;
+            } else {
+                ++common, ++i, ++j;
+            }
+        }
+        if (common != m_removed.size()) {
+            return false;
+        }
+
+        for (const uint32_t t : m_kept) {
+            const uint32_t* v = m_tris[t].v;
+            const double*   p[3];
+            for (int k = 0; k < 3; ++k) {
+                p[k] = position(v[k]);
+            }
+            double before[3], after[3];
+            faceNormal(p[0], p[1], p[2], before);
+            for (int k = 0; k < 3; ++k) {
+                p[k] = v[k] == a ? position(b) : p[k];
+            }
+            faceNormal(p[0], p[1], p[2], after);
+            const double scale =
+                std::sqrt(dot(before, before) * dot(after, after));
+            if (scale != 0 && !(dot(before, after) > kMinCos * scale)) {
+                return false;
+            }
+            if (scale == 0 && dot(before, before) != 0) {
+                return false;
+            }
+        }
+
+        // a不是接缝, 它所有的面角法线/纹理坐标相同; 取被删掉的面在b处的
+        //面角, 就是a这一侧的
+        const Triangle& edge_face = m_tris[m_removed[0]];
+        index_t         corner = edge_face.corner[0];
+        for (int k = 0; k < 3; ++k) {
+            if (edge_face.v[k] == b) {
+                corner = edge_face.corner[k];
+            }
+        }
+        for (const uint32_t t : m_removed) {
+            m_tris[t].dead = true;
+        }
+        m_live -= m_removed.size();
+        for (const uint32_t t : m_kept) {
+            Triangle& tri = m_tris[t];
+            for (int k = 0; k < 3; ++k) {
+                if (tri.v[k] == a) {
+                    tri.v[k] = b;
+                    tri.corner[k] = corner;
+                }
+            }
+            appendFace(b, t);
+        }
+        m_lists[a].count = 0;
+        m_quadrics[b].add(m_quadrics[a]);
+        m_flags[a] |= kGone;
+        ++m_version[a];
+        ++m_version[b];
+        m_error = std::max(m_error, c.cost);
+
+        neighbors(b, m_ring_b);
+        for (const uint32_t u : m_ring_b) {
+            pushEdge(u, b);
+        }
+        return true;
+    }
+
+    LodLevel emit(double ratio) const {
+        LodLevel level;
+        level.ratio = ratio;
+        level.error = std::sqrt(m_error);
+        level.indices.reserve(m_live * 3);
+        level.material_ids.reserve(m_live);
+        for (const Triangle& tri : m_tris) {
+            if (!tri.dead) {
+                level.indices.insert(level.indices.end(), tri.corner,
+                                     tri.corner + 3);
+                level.material_ids.push_back(tri.material);
+            }
+        }
+        return level;
+    }
+
+    const tinyobj::attrib_t&           m_attrib;
+    const LodOptions&                  m_options;
+    std::vector<Triangle>              m_tris;
+    size_t                             m_live{0};
+    std::vector<double>                m_pos;  //每个顶点3个
+    std::vector<uint8_t>               m_flags;
+    std::vector<uint32_t>              m_version;
+    std::vector<Quadric>               m_quadrics;
+    std::vector<FaceList>              m_lists;
+    std::vector<uint32_t>              m_face_pool;  //各顶点的面表
+    Heap                               m_heap;
+    double m_error{0.0};  //接受过的最大代价(距离平方)
+    //collapse的临时数组, 留着容量
+    std::vector<uint32_t> m_removed, m_kept, m_ring_a, m_ring_b;
+};
+
+}  // namespace lod_detail
+
+//一个mesh的LOD链, 在调用线程上做. 面角数(indices)到2^32 / 3时
+//下标放不进uint32_t, 不做简化, 返回空
+inline std::vector<LodLevel> buildLods(const tinyobj::mesh_t&   mesh,
+                                       const tinyobj::attrib_t& attrib,
+                                       const LodOptions& options = {}) {
+    if (mesh.indices.size() >= std::numeric_limits<uint32_t>::max() / 3) {
+        return {};
+    }
+    return lod_detail::Simplifier(mesh, attrib, options).run();
+}
+
+// result[i][k]是shapes[i]的第k级, 和options.ratios一一对应; 只有
+// buildLods不做的超大shape例外, result[i]为空, 调用方退回原mesh.
+//线程池上每个线程从面最多的shape开始取, 一个shape只在一个线程上做
+inline std::vector<std::vector<LodLevel>> buildLodChains(
+    const std::vector<tinyobj::shape_t>& shapes,
+    const tinyobj::attrib_t& attrib, ThreadPool& pool,
+    const LodOptions& options = {}) {
+    std::vector<std::vector<LodLevel>> result(shapes.size());
+    std::vector<size_t>                order(shapes.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        return shapes[x].mesh.indices.size() >
+               shapes[y].mesh.indices.size();
+    });
+    std::atomic<size_t> next{0};
+    const size_t        workers =
+        std::min<size_t>(pool.get_max_thread_count(), shapes.size());
+    pool.parallelize_loop(
+        0, workers,
+        [&](size_t, size_t) {
+            for (size_t k = next++; k < order.size(); k = next++) {
+                const size_t i = order[k];
+                result[i] = buildLods(shapes[i].mesh, attrib, options);
+            }
+        },
+        workers);
+    return result;
+}
+
+inline std::vector<std::vector<LodLevel>> buildLodChains(
+    const tinyobj::ObjReader& reader, ThreadPool& pool,
+    const LodOptions& options = {}) {
+    return buildLodChains(reader.GetShapes(), reader.GetAttrib(), pool,
+                          options);
+}
@@ -0,0 +1,841 @@
+#pragma once
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "FileProbe.h"
+#include "ObjPipeline.h"
+#include "PointCloud.h"
+#include "ShapeQueue.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+class ReadOnlyFile {
+public:
+    ReadOnlyFile(const std::string& file_path) : m_path(file_path) {
+        m_fd = open(file_path.c_str(), O_RDONLY);
+        if (m_fd < 0) {
+            throw std::runtime_error("file open failed.");
+        }
+        m_size = get_file_size(m_fd);
+        if (m_size < 0) {
+            throw std::runtime_error("file size error.");
+        }
+    }
+    ~ReadOnlyFile() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    //独占fd, 拷贝会导致重复close
+    ReadOnlyFile(const ReadOnlyFile&) = delete;
+    ReadOnlyFile& operator=(const ReadOnlyFile&) = delete;
+    ReadOnlyFile(ReadOnlyFile&& other) noexcept
+        : m_fd(std::exchange(other.m_fd, -1)),
+          m_path(std::move(other.m_path)),
+          m_size(other.m_size) {}
+    ReadOnlyFile& operator=(ReadOnlyFile&& other) noexcept {
+        if (this != &other) {
+            if (m_fd >= 0) {
+                close(m_fd);
+            }
+            m_fd = std::exchange(other.m_fd, -1);
+            m_path = std::move(other.m_path);
+            m_size = other.m_size;
+        }
+        return *this;
+    }
+
+    int fd() const {
+        return m_fd;
+    }
+    std::string path() const {
+        return m_path;
+    }
+    off_t size() const {
+        return m_size;
+    }
+
+private:
+    int         m_fd;
+    std::string m_path;
+    off_t       m_size;
+
+    off_t get_file_size(int fd) {
+        struct stat s;
+        if (fstat(fd, &s) != -1) {
+            return s.st_size;
+        }
+        return -1;
+    }
+};  // class ReadOnlyFile
+
+struct Result {
+    int                statue_code{0};  //返回码
+    tinyobj::ObjReader result;          //解析结果
+    std::string        file;            //文件
+};
+
+// 从文件头读满buf: pread可能短读, 读到buf.size()或者文件末尾为止.
+// buf截到读到的大小, 返回读到的字节数, 失败时返回-errno
+inline ssize_t preadAll(const ReadOnlyFile& file, std::vector<char>& buf) {
+    size_t done = 0;
+    while (done < buf.size()) {
+        const ssize_t n =
+            pread(file.fd(), buf.data() + done, buf.size() - done,
+                  static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    buf.resize(done);
+    return static_cast<ssize_t>(done);
+}
+
+// 每个线程(线程池的工作线程)一个, 连续解析很多小文件时
+// 解析用的临时容器留着容量复用, 结果按实际大小拷出
+inline tinyobj::ParseContext& threadParseContext() {
+    thread_local tinyobj::ParseContext context;
+    return context;
+}
+
+// 这里的模式解析完就释放缓冲区, lazy_attrib_t::text会悬空, 之后的
+// decodeShape/decodeAll读到已经释放的内存. 所以忽略lazy_attributes,
+// 照常解码
+inline tinyobj::ObjReaderConfig
+eagerConfig(tinyobj::ObjReaderConfig config) {
+    config.lazy_attributes = false;
+    return config;
+}
+
+//用reader解析buf, mtllib行引用的材质从mtl_text里读
+inline void readObjFromBuffer(const std::vector<char>& buf,
+                              tinyobj::ObjReader&      reader,
+                              const tinyobj::ObjReaderConfig& config = {},
+                              const std::string& mtl_text = {}) {
+    //直接解析缓冲区, 不再拷贝成std::string和istream
+    reader.ParseFromBuffer(buf.data(), buf.size(), mtl_text,
+                           eagerConfig(config), &threadParseContext());
+}
+
+//----------第一种解析方法:简单阻塞解析--------------
+inline Result readSyschronous(const ReadOnlyFile& file) {
+    Result            result{.file = file.path()};
+    std::vector<char> buf(file.size());
+    read(file.fd(), buf.data(), buf.size());  // block
+    readObjFromBuffer(buf, result.result);
+    return result;
+}
+
+inline std::vector<Result>
+trivialApproach(const std::vector<ReadOnlyFile>& files) {
+    std::vector<Result> results;
+    for (auto& file : files) {
+        results.push_back(readSyschronous(file));
+    }
+    return results;
+}
+
+//-------第二种解析方法:利用io_uring批量提交打开文件任务，解析----------
+
+class IOUring {
+private:
+    struct io_uring m_ring;
+
+public:
+    explicit IOUring(size_t queue_size) {
+        int q = io_uring_queue_init(queue_size, &m_ring, 0);
+        if (q < 0) {
+            throw std::runtime_error("create io_uring failed");
+        }
+    }
+    ~IOUring() {
+        io_uring_queue_exit(&m_ring);
+    }
+
+    IOUring(const IOUring&) = delete;
+    IOUring& operator=(const IOUring&) = delete;
+    IOUring(IOUring&&) = delete;
+    IOUring& operator=(IOUring&&) = delete;
+
+    struct io_uring* get_ring() {
+        return &m_ring;
+    }
+};
+
+inline std::vector<std::vector<char>>
+initialBuffer(const std::vector<ReadOnlyFile>& files) {
+    std::vector<std::vector<char>> bufs;
+    bufs.reserve(files.size());
+    for (const auto& file : files) {
+        bufs.emplace_back(file.size());
+    }
+    return bufs;
+}
+
+struct IdRequest {
+    size_t id;
+};
+
+inline void
+pushEntriesToSubmissionQueue(std::vector<ReadOnlyFile>&      files,
+                             std::vector<std::vector<char>>& bufs,
+                             IOUring&                        ring) {
+    for (size_t i = 0; i < files.size(); ++i) {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(ring.get_ring());
+        io_uring_prep_read(sqe, files[i].fd(), bufs[i].data(),
+                           bufs[i].size(), 0);
+        IdRequest* request = new IdRequest{i};
+        io_uring_sqe_set_data(sqe, request);
+    }
+}
+
+inline std::vector<Result>
+readEntriesFromCompletionQueue(std::vector<ReadOnlyFile>&      files,
+                               std::vector<std::vector<char>>& bufs,
+                               IOUring&                        ring) {
+    std::vector<Result> results;
+    results.reserve(files.size());
+    while (results.size() < files.size()) {
+        io_uring_submit_and_wait(ring.get_ring(), 1);
+        io_uring_cqe* cqe;
+        unsigned int  head;  // unused
+        int           processed{0};
+        io_uring_for_each_cqe(ring.get_ring(), head, cqe) {
+            IdRequest* req = (IdRequest*)io_uring_cqe_get_data(cqe);
+            results.push_back(
+                {.statue_code = cqe->res, .file = files[req->id].path()});
+            if (results.back().statue_code) {
+                readObjFromBuffer(bufs[req->id], results.back().result);
+            }
+            delete req;
+            processed++;
+        }
+        io_uring_cq_advance(ring.get_ring(), processed);
+    }
+    return results;
+}
+
+inline std::vector<Result>
+iouringObjLoader(std::vector<ReadOnlyFile>& files) {
+    IOUring ring{files.size()};
+    auto    bufs = initialBuffer(files);
+    //把文件读取请求提交到请求队列(准备好，未提交)
+    pushEntriesToSubmissionQueue(files, bufs, ring);
+    //等待请求到达完成队列之后解析
+    return readEntriesFromCompletionQueue(files, bufs, ring);
+}
+
+//--------------------------协程-----------------------------------
+
+struct Request {
+    std::coroutine_handle<> handle;
+    int                     statusCode{-1};
+};
+
+class ReadFileAwaitable {
+private:
+    io_uring_sqe* m_sqe;
+
+public:
+    ReadFileAwaitable(IOUring& ring, const ReadOnlyFile& file,
+                      std::vector<char>& buf)
+        : ReadFileAwaitable(ring, file.fd(), buf.data(), buf.size(), 0) {}
+
+    //从offset读len字节到buf
+    ReadFileAwaitable(IOUring& ring, int fd, char* buf, size_t len,
+                      off_t offset) {
+        m_sqe = io_uring_get_sqe(ring.get_ring());
+        io_uring_prep_read(m_sqe, fd, buf, static_cast<unsigned>(len),
+                           static_cast<uint64_t>(offset));
+    }
+
+    auto operator co_await() {
+        struct Awaiter {
+            io_uring_sqe* entry;  //访问m_sqe 附加handle
+            Request       req;
+
+            Awaiter(io_uring_sqe* sqe) : entry(sqe) {}
+
+            bool await_ready() {  //总是暂停
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) {
+                req.handle = handle;
+                io_uring_sqe_set_data(entry, &req);
+            }
+            int await_resume() {
+                return req.statusCode;
+            }
+        };
+
+        return Awaiter{m_sqe};
+    }
+};
+
+inline int consumeCQENonBlocking(IOUring& ring) {
+    io_uring_cqe* tmp;
+    if (io_uring_peek_cqe(ring.get_ring(), &tmp) != 0) {
+        return 0;
+    }
+    int           processed{0};
+    io_uring_cqe* cqe;
+    unsigned      head;  // unuse
+    io_uring_for_each_cqe(ring.get_ring(), head, cqe) {
+        Request* req = static_cast<Request*>(io_uring_cqe_get_data(cqe));
+        req->statusCode = cqe->res;
+        req->handle.resume();
+        processed++;
+    }
+    io_uring_cq_advance(ring.get_ring(), processed);
+    return processed;
+}
+
+//阻塞等到至少一个完成事件再处理, 不占着CPU空转
+inline int consumeCQEBlocking(IOUring& ring) {
+    io_uring_cqe* tmp;
+    if (io_uring_wait_cqe(ring.get_ring(), &tmp) != 0) {
+        return 0;
+    }
+    return consumeCQENonBlocking(ring);
+}
+
+// 一批协程的完成计数, 等的是这一批而不是整个线程池
+struct TaskGroup {
+    std::mutex              mutex;
+    std::condition_variable done_cv;
+    size_t                  remaining{0};
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return remaining == 0; });
+    }
+};
+
+class Task {
+public:
+    struct promise_type {
+        Result     m_result;         //传递结果
+        TaskGroup* m_group{nullptr};  //不为空时结束后减一
+
+        //挂起之后才减, 等的一方醒来时帧已经不会再被碰
+        struct FinalAwaiter : std::suspend_always {
+            void await_suspend(
+                std::coroutine_handle<promise_type> handle) noexcept {
+                TaskGroup* group = handle.promise().m_group;
+                if (group) {
+                    std::unique_lock<std::mutex> lock(group->mutex);
+                    if (--group->remaining == 0) {
+                        group->done_cv.notify_all();
+                    }
+                }
+            }
+        };
+
+        void return_value(Result& result) {
+            m_result = std::move(result);
+        }
+        Task get_return_object() {
+            return Task(this);
+        }
+
+        std::suspend_never initial_suspend() {
+            return {};
+        }
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+        void unhandled_exception() {}
+    };
+
+    //生成协程的handle
+    explicit Task(promise_type* promise)
+        : m_handle(
+              std::coroutine_handle<promise_type>::from_promise(*promise)) {
+    }
+    Task(Task&& other) : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    //把结果move出来, 只能取一次
+    Result getReuslt() {
+        assert(m_handle.done());
+        return std::move(m_handle.promise().m_result);
+    }
+
+    bool done() const {
+        return m_handle.done();
+    }
+
+    //要在协程结束之前加入, 比如读请求提交之前
+    void joinGroup(TaskGroup& group) {
+        ++group.remaining;
+        m_handle.promise().m_group = &group;
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// 大文件一次解析完会一直占着工作线程, 排在后面的小文件都要等它.
+// 超过bytes的文件分时间片解析: 用完time或bytes就让出线程,
+// co_await pool.schedule()排到队尾, 先跑已经在排队的任务
+struct TimeSlice {
+    size_t                    bytes{size_t(4) << 20};  //每片最多解析的字节
+    std::chrono::microseconds time{2000};              //每片最长时间
+};
+
+// 可以暂停的解析: 状态都在ObjTextParser里, 每次step()接着上次的
+// 位置解析一个时间片, 下一片可以在别的线程上继续.
+// 不用threadParseContext(), 它不能跨挂起点持有
+class SlicedParser {
+public:
+    SlicedParser(tinyobj::ObjReader& reader, const char* buf, size_t size,
+                 const tinyobj::ObjReaderConfig& config,
+                 const std::string& mtl_text, const TimeSlice& slice)
+        : m_parser(&reader, mtl_text, eagerConfig(config)),
+          m_buf(buf),
+          m_size(size),
+          m_slice(slice) {}
+
+    //解析一个时间片, 解析完(或出错)后Finish并返回false
+    bool step() {
+        using Clock = std::chrono::steady_clock;
+        const auto   deadline = Clock::now() + m_slice.time;
+        const size_t limit = m_pos + std::max<size_t>(m_slice.bytes, 1);
+        while (m_pos < m_size && m_pos < limit) {
+            const size_t end = tinyobj::FindChunkEnd(
+                m_buf, m_size, m_pos, std::min(kChunkBytes, limit - m_pos));
+            if (!m_parser.ParseChunk(m_buf + m_pos, end - m_pos)) {
+                m_pos = m_size;  //出错后的块都会被忽略, 不用再切片
+                break;
+            }
+            m_pos = end;
+            if (Clock::now() >= deadline) {
+                break;
+            }
+        }
+        if (m_pos < m_size) {
+            return true;
+        }
+        m_parser.Finish();
+        return false;
+    }
+
+private:
+    //两次看时间之间解析的量, 几百微秒
+    static constexpr size_t kChunkBytes = size_t(256) << 10;
+
+    tinyobj::ObjTextParser m_parser;
+    const char*            m_buf;
+    size_t                 m_size;
+    size_t                 m_pos{0};
+    TimeSlice              m_slice;
+};
+
+// statue_code和第二种方法一样是读到的字节数, 读失败时是-errno且不解析
+inline Task parseOBJFile(IOUring& ring, const ReadOnlyFile& file,
+                         ThreadPool&                     pool,
+                         const tinyobj::ObjReaderConfig& config,
+                         const std::string&              mtl_text,
+                         TimeSlice                       slice = {}) {
+    std::vector<char> buf(file.size());
+    int               status = co_await ReadFileAwaitable{ring, file, buf};
+    //----这里可以在线程池中运行，并行解析----
+    co_await pool.schedule();
+    Result result{.statue_code = status, .file = file.path()};
+    if (status >= 0) {
+        buf.resize(static_cast<size_t>(status));  //短读只解析读到的部分
+        if (buf.size() <= slice.bytes) {
+            readObjFromBuffer(buf, result.result, config, mtl_text);
+        } else {
+            SlicedParser parser(result.result, buf.data(), buf.size(),
+                                config, mtl_text, slice);
+            while (parser.step()) {
+                co_await pool.schedule();
+            }
+        }
+    }
+    co_return result;
+}
+
+inline bool allDone(const std::vector<Task>& tasks) {
+    return std::all_of(tasks.cbegin(), tasks.cend(),
+                       [](const auto& t) { return t.done(); });
+}
+
+// 在调用方的线程池上解析, 只等这一批文件, 池可以和别人共用
+inline std::vector<Result>
+parseOBJFiles(const std::vector<ReadOnlyFile>& files, ThreadPool& pool,
+              const tinyobj::ObjReaderConfig& config = {},
+              const std::string&              mtl_text = {},
+              const TimeSlice&                slice = {}) {
+    IOUring           ring(files.size());
+    TaskGroup         group;
+    std::vector<Task> tasks;
+    for (const auto& file : files) {
+        tasks.push_back(
+            parseOBJFile(ring, file, pool, config, mtl_text, slice));
+        tasks.back().joinGroup(group);  //读还没提交, 协程停在读上
+    }
+    io_uring_submit(ring.get_ring());
+    //读完成之后协程都已经调度到线程池, 主线程等这一批而不是轮询ring
+    size_t completed = 0;
+    while (completed < tasks.size()) {
+        completed += consumeCQEBlocking(ring);
+    }
+    group.wait();
+    assert(allDone(tasks));
+    std::vector<Result> results;
+    results.reserve(files.size());
+    for (auto&& t : tasks) {
+        results.push_back(std::move(t).getReuslt());
+    }
+    return results;
+}
+
+inline std::vector<Result>
+parseOBJFiles(const std::vector<ReadOnlyFile>& files,
+              const tinyobj::ObjReaderConfig&  config = {},
+              const std::string&               mtl_text = {},
+              const TimeSlice&                 slice = {}) {
+    ThreadPool pool;
+    return parseOBJFiles(files, pool, config, mtl_text, slice);
+}
+
+//--------第四种解析方法:只有v行的点云, 在线程池上分块解析成SoA--------
+
+inline std::vector<PointCloud>
+pointCloudLoader(const std::vector<ReadOnlyFile>& files,
+                 const PointCloudOptions&         options) {
+    ThreadPool              pool;
+    std::vector<PointCloud> clouds;
+    clouds.reserve(files.size());
+    for (const auto& file : files) {
+        std::vector<char> buf(file.size());
+        const ssize_t     n = preadAll(file, buf);
+        if (n < 0) {
+            clouds.emplace_back();
+            clouds.back().statue_code = static_cast<int>(n);
+            continue;
+        }
+        clouds.push_back(
+            parsePointCloud(buf.data(), buf.size(), options, pool));
+        clouds.back().statue_code =
+            static_cast<int>(std::min<size_t>(buf.size(), INT_MAX));
+    }
+    return clouds;
+}
+
+//--------第五种解析方法:渐进式, 每解析出一个shape就交给消费者--------
+
+inline std::vector<Result>
+progressiveLoader(const std::vector<ReadOnlyFile>& files) {
+    ThreadPool          pool;
+    std::vector<Result> results(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        ShapeQueue queue;
+        results[i].file = files[i].path();
+        //在线程池里解析, 当前线程消费已经flush的shape
+        //statue_code是读到的字节数, 读失败时是-errno且不解析
+        pool.push_task([&queue, &file = files[i], &result = results[i]] {
+            std::vector<char> buf(file.size());
+            const ssize_t     n = preadAll(file, buf);
+            if (n < 0) {
+                result.statue_code = static_cast<int>(n);
+            } else {
+                result.statue_code =
+                    static_cast<int>(std::min<size_t>(buf.size(), INT_MAX));
+                tinyobj::ObjReaderConfig config;
+                queue.attach(config);
+                readObjFromBuffer(buf, result.result, config);
+            }
+            queue.close();
+        });
+        ProgressiveShape item;
+        while (queue.pop(item)) {
+            //----这里可以上传/渲染item, 不用等整个文件----
+        }
+    }
+    return results;
+}
+
+//--------第六种解析方法:按文件的大小和是否在页缓存里自动选择---------
+
+enum class LoadStrategy {
+    Sync,      //热的小文件: pread进缓冲区
+    Mmap,      //热文件: 直接解析映射, 不拷贝
+    IOUring,   //冷文件: 一起提交给io_uring, 读完的在线程池上解析
+    Direct,    //冷的大文件: io_uring + O_DIRECT, 不经过页缓存
+    Parallel,  //超大文件: 分块流水线解析, 热的mmap, 冷的O_DIRECT读
+};
+
+inline const char* strategyName(LoadStrategy strategy) {
+    switch (strategy) {
+    case LoadStrategy::Sync:
+        return "sync";
+    case LoadStrategy::Mmap:
+        return "mmap";
+    case LoadStrategy::IOUring:
+        return "io_uring";
+    case LoadStrategy::Direct:
+        return "direct";
+    case LoadStrategy::Parallel:
+        return "parallel";
+    }
+    return "?";
+}
+
+// 默认阈值只是起点, 用obj_strategybench在目标机器和存储上校准,
+// 把它输出的值填进来
+struct AutoLoadOptions {
+    double    resident_ratio{0.9};  //在页缓存里的比例不低于这个算热
+    off_t     sync_max_bytes{off_t(256) << 10};     //热: 以下pread
+    off_t     direct_min_bytes{off_t(4) << 20};     //冷: 以上用O_DIRECT
+    off_t     parallel_min_bytes{off_t(16) << 20};  //以上分块并行解析
+    TimeSlice slice{};  //冷的IOUring/Direct文件按这个分片解析
+};
+
+// Parallel优先, 所以Direct只管[direct_min_bytes, parallel_min_bytes)
+inline LoadStrategy chooseStrategy(const FileProbe&       probe,
+                                   const AutoLoadOptions& options) {
+    if (probe.size >= options.parallel_min_bytes) {
+        return LoadStrategy::Parallel;
+    }
+    if (probe.resident >= options.resident_ratio) {
+        return probe.size <= options.sync_max_bytes ? LoadStrategy::Sync
+                                                    : LoadStrategy::Mmap;
+    }
+    return probe.size >= options.direct_min_bytes && probe.dio_align
+               ? LoadStrategy::Direct
+               : LoadStrategy::IOUring;
+}
+
+namespace auto_load_detail {
+
+//单次读请求的上限, 是任何O_DIRECT对齐的整数倍
+constexpr size_t kMaxReadBytes = size_t(1) << 30;
+
+struct FreeDeleter {
+    void operator()(char* p) const {
+        std::free(p);
+    }
+};
+using AlignedBuffer = std::unique_ptr<char, FreeDeleter>;
+
+inline void parseLoaded(Result& result, const char* buf, size_t size,
+                        bool parallel, ThreadPool& pool,
+                        const tinyobj::ObjReaderConfig& config,
+                        const std::string&              mtl_text) {
+    const tinyobj::ObjReaderConfig eager = eagerConfig(config);
+    if (parallel) {
+        parseObjPipelined(result.result, buf, size, mtl_text, pool, eager);
+    } else {
+        result.result.ParseFromBuffer(buf, size, mtl_text, eager,
+                                      &threadParseContext());
+    }
+}
+
+// Sync, Mmap和热的Parallel, 在线程池里执行
+inline void loadHot(const ReadOnlyFile& file, LoadStrategy strategy,
+                    ThreadPool& pool, Result& result,
+                    const tinyobj::ObjReaderConfig& config,
+                    const std::string&              mtl_text) {
+    const auto size = static_cast<size_t>(file.size());
+    if (strategy == LoadStrategy::Sync || size == 0) {
+        std::vector<char> buf(size);
+        const ssize_t     n = preadAll(file, buf);
+        if (n < 0) {
+            result.statue_code = static_cast<int>(n);
+            return;
+        }
+        result.statue_code =
+            static_cast<int>(std::min<size_t>(buf.size(), INT_MAX));
+        parseLoaded(result, buf.data(), buf.size(), false, pool, config,
+                    mtl_text);
+        return;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                      file.fd(), 0);
+    if (addr == MAP_FAILED) {
+        result.statue_code = -errno;
+        return;
+    }
+    result.statue_code = static_cast<int>(std::min<size_t>(size, INT_MAX));
+    parseLoaded(result, static_cast<const char*>(addr), size,
+                strategy == LoadStrategy::Parallel, pool, config, mtl_text);
+    munmap(addr, size);
+}
+
+// IOUring, Direct和冷的Parallel: 在驱动ring的线程上读,
+// 读完后reads_done加一, 再换到线程池解析
+inline Task loadCold(IOUring& ring, const ReadOnlyFile& file,
+                     LoadStrategy strategy, const FileProbe& probe,
+                     ThreadPool& pool, size_t& reads_done,
+                     const TimeSlice&                slice,
+                     const tinyobj::ObjReaderConfig& config,
+                     const std::string&              mtl_text) {
+    //O_DIRECT要单独打开, 文件系统不支持时退回经过页缓存的读
+    int direct_fd = -1;
+    if (strategy != LoadStrategy::IOUring && probe.dio_align) {
+        direct_fd = open(file.path().c_str(), O_RDONLY | O_DIRECT);
+    }
+    const int    fd = direct_fd >= 0 ? direct_fd : file.fd();
+    const size_t align = direct_fd >= 0 ? probe.dio_align : 64;
+    const auto   size = static_cast<size_t>(file.size());
+    //O_DIRECT的长度也要对齐, 最后一次读会在文件末尾短读
+    const size_t  capacity = (std::max<size_t>(size, 1) + align - 1) /
+                            align * align;
+    AlignedBuffer buf(
+        static_cast<char*>(std::aligned_alloc(align, capacity)));
+    size_t done = 0;
+    int    status = buf ? 0 : -ENOMEM;
+    while (buf && done < size) {
+        status = co_await ReadFileAwaitable{
+            ring, fd, buf.get() + done,
+            std::min(capacity - done, kMaxReadBytes),
+            static_cast<off_t>(done)};
+        if (status <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(status);
+    }
+    if (direct_fd >= 0) {
+        close(direct_fd);
+    }
+    ++reads_done;
+    co_await pool.schedule();
+    Result result;
+    result.file = file.path();
+    result.statue_code = status < 0 ? status
+                                    : static_cast<int>(
+                                          std::min<size_t>(done, INT_MAX));
+    if (status >= 0 &&
+        (strategy == LoadStrategy::Parallel || done <= slice.bytes)) {
+        parseLoaded(result, buf.get(), done,
+                    strategy == LoadStrategy::Parallel, pool, config,
+                    mtl_text);
+    } else if (status >= 0) {
+        SlicedParser parser(result.result, buf.get(), done, config,
+                            mtl_text, slice);
+        while (parser.step()) {
+            co_await pool.schedule();
+        }
+    }
+    co_return result;
+}
+
+}  // namespace auto_load_detail
+
+// 按给定的方式加载每个文件, probes和strategies与files一一对应.
+// 冷文件的读请求一起提交给io_uring, 热文件直接在线程池里读和解析.
+// options用来判断Parallel的文件是冷是热, slice给冷文件分片解析
+inline std::vector<Result>
+loadWithStrategies(const std::vector<ReadOnlyFile>& files,
+                   const std::vector<FileProbe>&    probes,
+                   const std::vector<LoadStrategy>& strategies,
+                   ThreadPool&                      pool,
+                   const AutoLoadOptions&           options = {},
+                   const tinyobj::ObjReaderConfig&  config = {},
+                   const std::string&               mtl_text = {}) {
+    using namespace auto_load_detail;
+    auto isCold = [&](size_t i) {
+        return strategies[i] == LoadStrategy::IOUring ||
+               strategies[i] == LoadStrategy::Direct ||
+               (strategies[i] == LoadStrategy::Parallel &&
+                probes[i].resident < options.resident_ratio);
+    };
+    size_t cold = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        cold += isCold(i) ? 1 : 0;
+    }
+    std::vector<Result>      results(files.size());
+    std::vector<Task>        tasks;
+    std::vector<size_t>      task_slots;
+    size_t                   reads_done = 0;
+    std::unique_ptr<IOUring> ring;
+    if (cold) {
+        ring = std::make_unique<IOUring>(std::min<size_t>(cold, 4096));
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!isCold(i)) {
+            results[i].file = files[i].path();
+            pool.push_task([&, i] {
+                loadHot(files[i], strategies[i], pool, results[i], config,
+                        mtl_text);
+            });
+            continue;
+        }
+        //ring满了先把已准备好的提交出去, 等腾出位置
+        while (io_uring_sq_space_left(ring->get_ring()) == 0) {
+            io_uring_submit(ring->get_ring());
+            consumeCQEBlocking(*ring);
+        }
+        tasks.push_back(loadCold(*ring, files[i], strategies[i], probes[i],
+                                 pool, reads_done, options.slice, config,
+                                 mtl_text));
+        task_slots.push_back(i);
+    }
+    //协程读完一段会在这里接着提交下一段, 所以每轮都要submit
+    while (reads_done < tasks.size()) {
+        io_uring_submit(ring->get_ring());
+        consumeCQEBlocking(*ring);
+    }
+    pool.wait_for_tasks();
+    assert(allDone(tasks));
+    for (size_t k = 0; k < tasks.size(); ++k) {
+        results[task_slots[k]] = tasks[k].getReuslt();
+    }
+    return results;
+}
+
+// 探测每个文件(statx, cachestat/mincore)后按chooseStrategy加载.
+// 只有一个线程时分块流水线没有收益, 不选Parallel
+inline std::vector<Result>
+autoLoader(const std::vector<ReadOnlyFile>& files,
+           AutoLoadOptions                  options = {},
+           const tinyobj::ObjReaderConfig&  config = {},
+           const std::string&               mtl_text = {}) {
+    ThreadPool                pool;
+    std::vector<FileProbe>    probes;
+    std::vector<LoadStrategy> strategies;
+    if (pool.get_max_thread_count() < 2) {
+        options.parallel_min_bytes = std::numeric_limits<off_t>::max();
+    }
+    probes.reserve(files.size());
+    strategies.reserve(files.size());
+    for (const auto& file : files) {
+        probes.push_back(probeFile(file.fd()));
+        strategies.push_back(chooseStrategy(probes.back(), options));
+    }
+    return loadWithStrategies(files, probes, strategies, pool, options,
+                              config, mtl_text);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 两级流水线解析内存中的obj文本: 线程池给后面的块建结构索引(stage 1),
+// 当前线程按顺序解析索引已经建好的块(stage 2).
+// 结果和ObjReader::ParseFromBuffer一样: mtl_text为空且设置了
+// config.mtl_search_path时mtllib从那里读, 否则只用mtl_text
+
+constexpr size_t kPipelineChunkSize = 1 << 20;
+constexpr size_t kPipelineDepth = 4;  //同时在建索引的块数
+
+inline bool parseObjPipelined(tinyobj::ObjReader& reader, const char* buf,
+                              size_t size, const std::string& mtl_text,
+                              ThreadPool&                     pool,
+                              const tinyobj::ObjReaderConfig& config = {},
+                              size_t chunk_size = kPipelineChunkSize) {
+    struct Slot {
+        tinyobj::structural_index_t index;
+        size_t                      begin{0};
+        size_t                      end{0};
+        std::atomic<bool>           ready{false};
+    };
+    std::array<Slot, kPipelineDepth> slots;
+
+    //按行切块
+    std::vector<size_t> bounds{0};
+    while (bounds.back() < size) {
+        bounds.push_back(
+            tinyobj::FindChunkEnd(buf, size, bounds.back(), chunk_size));
+    }
+    const size_t chunks = bounds.size() - 1;
+
+    auto launch = [&](size_t k) {
+        Slot& slot = slots[k % kPipelineDepth];
+        slot.ready.store(false, std::memory_order_relaxed);
+        slot.begin = bounds[k];
+        slot.end = bounds[k + 1];
+        pool.push_task([&slot, buf] {
+            tinyobj::BuildStructuralIndex(
+                buf + slot.begin, slot.end - slot.begin, &slot.index);
+            slot.ready.store(true, std::memory_order_release);
+        });
+    };
+    size_t launched = 0;
+    while (launched < std::min(chunks, kPipelineDepth)) {
+        launch(launched++);
+    }
+
+    tinyobj::ObjTextParser parser(&reader, mtl_text, config);
+    bool                   ok = true;
+    //出错后不再提交新块, 但要等已提交的任务结束, 它们引用着slots
+    for (size_t k = 0; k < launched; ++k) {
+        Slot& slot = slots[k % kPipelineDepth];
+        pool.wait_until(
+            [&slot] { return slot.ready.load(std::memory_order_acquire); });
+        if (ok) {
+            ok = parser.ParseChunk(buf + slot.begin, slot.end - slot.begin,
+                                   slot.index);
+        }
+        if (ok && launched < chunks) {
+            launch(launched++);
+        }
+    }
+    return parser.Finish();
+}
@@ -0,0 +1,451 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 只有v行的obj(激光雷达导出的点云)走这里, 不经过LoadObj的通用逐行解析.
+// 结果按SoA存放, 可以在解析的同时做体素降采样或者随机抽稀.
+
+struct PointCloud {
+    std::vector<tinyobj::real_t> x, y, z;
+    std::vector<tinyobj::real_t> r, g, b;  //没有顶点颜色时为空
+    // pointCloudLoader填: 读到的字节数, 读失败时是-errno且不解析
+    int statue_code{0};
+
+    size_t size() const {
+        return x.size();
+    }
+    bool hasColor() const {
+        return !r.empty();
+    }
+};
+
+struct PointCloudOptions {
+    double   voxel_size{0.0};     //体素边长, <=0 不做体素降采样
+    double   keep_ratio{1.0};     //随机抽稀保留比例, 1 = 全部保留
+    uint64_t seed{0};             //随机抽稀的种子
+    size_t   chunk_size{8 << 20};  //并行解析时每块的字节数
+
+    // 解析时对每个点做仿射变换(单位换算, 换轴, 平移), 在体素降采样之前.
+    // 按列存放的4x4矩阵, 同tinyobj::ObjReaderConfig::transform
+    bool                  use_transform{false};
+    std::array<double, 16> transform{1, 0, 0, 0, 0, 1, 0, 0,
+                                     0, 0, 1, 0, 0, 0, 0, 1};
+};
+
+namespace point_cloud_detail {
+
+// 精确可表示的10的幂, 用于快速路径
+inline constexpr double kPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+inline bool isDigit(char c) {
+    return static_cast<unsigned>(c - '0') < 10u;
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+inline uint64_t load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 8个字节是否全是数字(SWAR)
+inline bool isEightDigits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) |
+            (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+           0x3333333333333333;
+}
+
+inline constexpr uint64_t kPow10Int[] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+};
+
+// 读取一串数字累加到mantissa, 超过19位有效数字的部分只计数.
+// 8位以上的长数字串交给SIMD内核(一次最多16位, 可能读到limit即块末尾),
+// 短的直接累加, 省掉间接调用
+inline const char* parseDigits(const char* p, const char* limit,
+                               const tinyobj::parse_kernels_t& kernels,
+                               uint64_t& mantissa, int& digits) {
+    if (digits < 19 && limit - p >= 8 && isEightDigits(load64(p))) {
+        unsigned long long value = 0;
+        const size_t       n = kernels.parse_digits(p, limit, &value);
+        const size_t       room = static_cast<size_t>(19 - digits);
+        size_t             keep = n;
+        if (n > room) {
+            value /= kPow10Int[n - room];
+            keep = room;
+        }
+        mantissa = mantissa * kPow10Int[keep] + value;
+        digits += static_cast<int>(n);
+        p += n;
+        if (n < 16) {
+            return p;
+        }
+    }
+    while (p < limit && isDigit(*p)) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        }
+        ++digits;
+        ++p;
+    }
+    return p;
+}
+
+// 解析一个浮点数, 成功时p指向数字之后. 语法与tinyobj的tryParseDouble一致.
+// end是行尾(换行符或limit), 数字不会越过它
+inline bool parseNumber(const char*& p, const char* end, const char* limit,
+                        const tinyobj::parse_kernels_t& kernels,
+                        double& out) {
+    const char* s = p;
+    bool        negative = false;
+    if (s < end && (*s == '+' || *s == '-')) {
+        negative = *s == '-';
+        ++s;
+    }
+    uint64_t mantissa = 0;
+    int      int_digits = 0;
+    s = parseDigits(s, limit, kernels, mantissa, int_digits);
+    int frac_digits = 0;
+    if (s < end && *s == '.') {
+        ++s;
+        int total = int_digits;
+        s = parseDigits(s, limit, kernels, mantissa, total);
+        frac_digits = total - int_digits;
+    }
+    if (int_digits + frac_digits == 0) {
+        return false;
+    }
+    // 超过19位的整数部分按10的幂补回来, 小数部分直接丢弃
+    int exponent = int_digits > 19 ? int_digits - 19 : 0;
+    exponent -= std::min(frac_digits, std::max(0, 19 - int_digits));
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool        exp_negative = false;
+        if (e < end && (*e == '+' || *e == '-')) {
+            exp_negative = *e == '-';
+            ++e;
+        }
+        if (e >= end || !isDigit(*e)) {
+            return false;
+        }
+        int exp_value = 0;
+        while (e < end && isDigit(*e)) {
+            if (exp_value < 100000) {
+                exp_value = exp_value * 10 + (*e - '0');
+            }
+            ++e;
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+        s = e;
+    }
+    double value = static_cast<double>(mantissa);
+    if (exponent == 0) {
+    } else if (mantissa < (uint64_t(1) << 53) && exponent >= -22 &&
+               exponent <= 22) {
+        value = exponent < 0 ? value / kPow10[-exponent]
+                             : value * kPow10[exponent];
+    } else {
+        value *= std::pow(10.0, exponent);
+    }
+    out = negative ? -value : value;
+    p = s;
+    return true;
+}
+
+// v[0..2] = m * (x, y, z, 1), 用double算完再转real_t
+inline void transformPoint(const std::array<double, 16>& m, double* v) {
+    const double x = v[0], y = v[1], z = v[2];
+    v[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+    v[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+    v[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+}
+
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+    return x ^ (x >> 31);
+}
+
+struct VoxelKey {
+    int64_t x, y, z;
+    bool    operator==(const VoxelKey& o) const {
+        return x == o.x && y == o.y && z == o.z;
+    }
+};
+
+struct VoxelKeyHash {
+    size_t operator()(const VoxelKey& k) const {
+        return splitmix64(static_cast<uint64_t>(k.x) * 73856093 ^
+                          static_cast<uint64_t>(k.y) * 19349663 ^
+                          static_cast<uint64_t>(k.z) * 83492791);
+    }
+};
+
+// 每个体素累加坐标和颜色, 最后输出质心. 体素按第一次出现的顺序排列
+struct VoxelAccumulator {
+    std::unordered_map<VoxelKey, uint32_t, VoxelKeyHash> slots;
+    std::vector<VoxelKey>                                keys;
+    std::vector<double>                                  sum;  // x y z r g b
+    std::vector<uint32_t>                                count;
+
+    void add(const VoxelKey& key, const double* p, uint32_t n = 1) {
+        auto [it, inserted] =
+            slots.try_emplace(key, static_cast<uint32_t>(count.size()));
+        if (inserted) {
+            keys.push_back(key);
+            sum.insert(sum.end(), p, p + 6);
+            count.push_back(n);
+            return;
+        }
+        double* s = &sum[size_t(it->second) * 6];
+        for (int i = 0; i < 6; ++i) {
+            s[i] += p[i];
+        }
+        count[it->second] += n;
+    }
+
+    void merge(const VoxelAccumulator& other) {
+        for (size_t i = 0; i < other.keys.size(); ++i) {
+            add(other.keys[i], &other.sum[i * 6], other.count[i]);
+        }
+    }
+};
+
+// 一块[begin, end)的解析结果, begin必须是行首
+struct Chunk {
+    PointCloud       points;
+    VoxelAccumulator voxels;
+    bool             found_color{false};
+};
+
+inline void parseChunk(const char* buf, size_t begin, size_t end,
+                       const PointCloudOptions& options, Chunk& chunk) {
+    const bool     voxelize = options.voxel_size > 0.0;
+    const double   inv_voxel = voxelize ? 1.0 / options.voxel_size : 0.0;
+    const bool     decimate = options.keep_ratio < 1.0;
+    const uint64_t threshold =
+        decimate ? static_cast<uint64_t>(std::max(options.keep_ratio, 0.0) *
+                                         18446744073709551615.0)
+                 : 0;
+    PointCloud&                     out = chunk.points;
+    const tinyobj::parse_kernels_t& kernels = tinyobj::GetParseKernels();
+
+    const char* p = buf + begin;
+    const char* chunk_end = buf + end;
+    while (p < chunk_end) {
+        const char* line = p;
+        const char* eol = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(chunk_end - p)));
+        if (!eol) {
+            eol = chunk_end;
+        }
+        p = eol + 1;
+
+        while (line < eol && isSpace(*line)) {
+            ++line;
+        }
+        if (eol - line < 2 || line[0] != 'v' || !isSpace(line[1])) {
+            continue;  //只处理v行
+        }
+        // 按行的字节偏移取随机数, 结果与分块方式无关
+        if (decimate &&
+            splitmix64(options.seed ^ static_cast<uint64_t>(line - buf)) >=
+                threshold) {
+            continue;
+        }
+        line += 2;
+
+        double values[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+        int    n = 0;
+        while (n < 6) {
+            while (line < eol && isSpace(*line)) {
+                ++line;
+            }
+            if (line >= eol || *line == '\r' ||
+                !parseNumber(line, eol, chunk_end, kernels, values[n])) {
+                break;
+            }
+            ++n;
+        }
+        const bool has_color = n >= 6;
+        if (!has_color) {
+            values[3] = values[4] = values[5] = 1.0;
+        }
+        if (options.use_transform) {
+            transformPoint(options.transform, values);
+        }
+
+        if (voxelize) {
+            VoxelKey key{
+                static_cast<int64_t>(std::floor(values[0] * inv_voxel)),
+                static_cast<int64_t>(std::floor(values[1] * inv_voxel)),
+                static_cast<int64_t>(std::floor(values[2] * inv_voxel))};
+            chunk.voxels.add(key, values);
+            chunk.found_color |= has_color;
+            continue;
+        }
+
+        if (has_color && !chunk.found_color) {
+            //第一次遇到颜色, 之前的点补默认白色
+            out.r.assign(out.size(), 1);
+            out.g.assign(out.size(), 1);
+            out.b.assign(out.size(), 1);
+            chunk.found_color = true;
+        }
+        out.x.push_back(static_cast<tinyobj::real_t>(values[0]));
+        out.y.push_back(static_cast<tinyobj::real_t>(values[1]));
+        out.z.push_back(static_cast<tinyobj::real_t>(values[2]));
+        if (chunk.found_color) {
+            out.r.push_back(static_cast<tinyobj::real_t>(values[3]));
+            out.g.push_back(static_cast<tinyobj::real_t>(values[4]));
+            out.b.push_back(static_cast<tinyobj::real_t>(values[5]));
+        }
+    }
+}
+
+// 按chunk_size切块, 切点挪到下一个换行之后
+inline std::vector<size_t> splitAtLines(const char* buf, size_t size,
+                                        size_t chunk_size) {
+    std::vector<size_t> bounds{0};
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    size_t pos = 0;
+    while (size - pos > chunk_size) {
+        const char* nl = static_cast<const char*>(
+            std::memchr(buf + pos + chunk_size, '\n',
+                        size - pos - chunk_size));
+        if (!nl) {
+            break;
+        }
+        pos = static_cast<size_t>(nl - buf) + 1;
+        bounds.push_back(pos);
+    }
+    if (bounds.back() != size) {
+        bounds.push_back(size);
+    }
+    return bounds;
+}
+
+inline void append(std::vector<tinyobj::real_t>&       dst,
+                   const std::vector<tinyobj::real_t>& src) {
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+}  // namespace point_cloud_detail
+
+// 在线程池上分块解析点云, 降采样在各块内完成后再合并
+inline PointCloud parsePointCloud(const char* buf, size_t size,
+                                  const PointCloudOptions& options,
+                                  ThreadPool&              pool) {
+    using namespace point_cloud_detail;
+    const auto bounds = splitAtLines(buf, size, options.chunk_size);
+    const size_t       num_chunks = bounds.size() - 1;
+    std::vector<Chunk> chunks(num_chunks);
+    pool.parallelize_loop(
+        0, num_chunks,
+        [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                parseChunk(buf, bounds[i], bounds[i + 1], options,
+                           chunks[i]);
+            }
+        },
+        num_chunks);
+
+    bool found_color = false;
+    for (const auto& chunk : chunks) {
+        found_color |= chunk.found_color;
+    }
+
+    PointCloud result;
+    if (options.voxel_size > 0.0) {
+        VoxelAccumulator merged;
+        if (!chunks.empty()) {
+            merged = std::move(chunks[0].voxels);
+        }
+        for (size_t i = 1; i < num_chunks; ++i) {
+            merged.merge(chunks[i].voxels);
+            chunks[i].voxels = VoxelAccumulator{};
+        }
+        const size_t n = merged.count.size();
+        result.x.resize(n);
+        result.y.resize(n);
+        result.z.resize(n);
+        if (found_color) {
+            result.r.resize(n);
+            result.g.resize(n);
+            result.b.resize(n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const double  inv = 1.0 / merged.count[i];
+            const double* s = &merged.sum[i * 6];
+            result.x[i] = static_cast<tinyobj::real_t>(s[0] * inv);
+            result.y[i] = static_cast<tinyobj::real_t>(s[1] * inv);
+            result.z[i] = static_cast<tinyobj::real_t>(s[2] * inv);
+            if (found_color) {
+                result.r[i] = static_cast<tinyobj::real_t>(s[3] * inv);
+                result.g[i] = static_cast<tinyobj::real_t>(s[4] * inv);
+                result.b[i] = static_cast<tinyobj::real_t>(s[5] * inv);
+            }
+        }
+        return result;
+    }
+
+    size_t total = 0;
+    for (const auto& chunk : chunks) {
+        total += chunk.points.size();
+    }
+    result.x.reserve(total);
+    result.y.reserve(total);
+    result.z.reserve(total);
+    if (found_color) {
+        result.r.reserve(total);
+        result.g.reserve(total);
+        result.b.reserve(total);
+    }
+    for (auto& chunk : chunks) {
+        PointCloud& pc = chunk.points;
+        if (found_color && !chunk.found_color) {
+            pc.r.assign(pc.size(), 1);
+            pc.g.assign(pc.size(), 1);
+            pc.b.assign(pc.size(), 1);
+        }
+        append(result.x, pc.x);
+        append(result.y, pc.y);
+        append(result.z, pc.z);
+        if (found_color) {
+            append(result.r, pc.r);
+            append(result.g, pc.g);
+            append(result.b, pc.b);
+        }
+        pc = PointCloud{};
+    }
+    return result;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <sched.h>
+#include <sys/resource.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 延迟回收: 大批解析结果(成千上万个vector)的析构放到后台低优先级线程,
+// 请求线程只付一次move和入队的开销. 后台跟不上时(积压超过上限)
+// 退回在调用线程里析构, 保证内存有界
+class Reclaimer {
+private:
+    struct Garbage {
+        virtual ~Garbage() = default;
+    };
+
+    template <class T>
+    struct Holder : Garbage {
+        T object;
+        explicit Holder(T&& object_) : object(std::move(object_)) {}
+    };
+
+    static constexpr size_t kMaxPending = 64;
+
+    std::vector<std::unique_ptr<Garbage>> m_pending = {};
+    mutable std::mutex                    m_mutex = {};
+    std::condition_variable               m_pending_cv = {};
+    std::condition_variable               m_drained_cv = {};
+    size_t                                m_max_pending = kMaxPending;
+    size_t                                m_in_flight = 0;  //后台正在析构的
+    bool                                  m_running = true;
+    std::thread                           m_thread;
+
+    //只在CPU空闲时运行, 不支持SCHED_IDLE时退到nice 19
+    static void lower_priority() {
+        sched_param param{};
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+            setpriority(PRIO_PROCESS, 0, 19);
+        }
+    }
+
+    void worker() {
+        lower_priority();
+        std::vector<std::unique_ptr<Garbage>> batch;
+        std::unique_lock<std::mutex>          lock(m_mutex);
+        while (true) {
+            m_pending_cv.wait(
+                lock, [this] { return !m_running || !m_pending.empty(); });
+            if (m_pending.empty()) {
+                break;
+            }
+            batch.swap(m_pending);
+            m_in_flight = batch.size();
+            lock.unlock();
+            batch.clear();  //在锁外析构
+            lock.lock();
+            m_in_flight = 0;
+            if (m_pending.empty()) {
+                m_drained_cv.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit Reclaimer(size_t max_pending = kMaxPending)
+        : m_max_pending(max_pending), m_thread(&Reclaimer::worker, this) {}
+
+    //析构前把积压的都释放掉
+    ~Reclaimer() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_pending_cv.notify_all();
+        m_thread.join();
+    }
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    //进程内共用的一个
+    static Reclaimer& global() {
+        static Reclaimer reclaimer;
+        return reclaimer;
+    }
+
+    //接管object, 之后在后台线程析构. 只收右值, 避免不小心整个拷贝一份
+    template <class T>
+    void retire(T&& object) {
+        static_assert(!std::is_lvalue_reference_v<T>,
+                      "retire() takes ownership, pass std::move(object)");
+        std::unique_ptr<Garbage> garbage =
+            std::make_unique<Holder<T>>(std::move(object));
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_running && m_pending.size() < m_max_pending) {
+                m_pending.push_back(std::move(garbage));
+                if (m_pending.size() == 1) {
+                    m_pending_cv.notify_one();
+                }
+                return;
+            }
+        }
+        garbage.reset();  //积压太多, 就地析构
+    }
+
+    //等到已经交出去的都析构完
+    void drain() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_drained_cv.wait(lock, [this] {
+            return m_pending.empty() && m_in_flight == 0;
+        });
+    }
+
+    size_t pending() const {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_pending.size() + m_in_flight;
+    }
+};
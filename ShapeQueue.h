@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "tiny_obj_loader.h"
+
+// 渐进式解析: LoadObj每flush一个shape就放进队列,
+// 消费者不用等整个文件解析完就可以开始上传/渲染
+
+struct ProgressiveShape {
+    tinyobj::shape_t shape;
+    size_t           shape_index{0};
+
+    //上一个shape之后新增的属性, 下标从*_offset开始
+    size_t                       vertex_offset{0};
+    size_t                       normal_offset{0};
+    size_t                       texcoord_offset{0};
+    std::vector<tinyobj::real_t> vertices;
+    std::vector<tinyobj::real_t> colors;  //不是所有顶点都有颜色时为空
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::real_t> texcoords;
+
+    // shape引用到的属性下标范围[min, max], 没有为-1
+    std::array<tinyobj::index_int_t, 2> vertex_range{-1, -1};
+    std::array<tinyobj::index_int_t, 2> normal_range{-1, -1};
+    std::array<tinyobj::index_int_t, 2> texcoord_range{-1, -1};
+};
+
+class ShapeQueue {
+private:
+    std::deque<ProgressiveShape> m_items = {};
+    std::mutex                   m_mutex = {};
+    std::condition_variable      m_items_available_cv = {};
+    bool                         m_closed = false;
+
+    static void onShape(void*                        user_data,
+                        const tinyobj::shape_chunk_t& chunk) {
+        ProgressiveShape item;
+        item.shape = *chunk.shape;
+        item.shape_index = chunk.shape_index;
+        item.vertex_offset = chunk.vertex_offset;
+        item.normal_offset = chunk.normal_offset;
+        item.texcoord_offset = chunk.texcoord_offset;
+        if (chunk.vertices) {
+            item.vertices.assign(chunk.vertices,
+                                 chunk.vertices + chunk.num_vertices * 3);
+        }
+        if (chunk.colors) {
+            item.colors.assign(chunk.colors,
+                               chunk.colors + chunk.num_vertices * 3);
+        }
+        if (chunk.normals) {
+            item.normals.assign(chunk.normals,
+                                chunk.normals + chunk.num_normals * 3);
+        }
+        if (chunk.texcoords) {
+            item.texcoords.assign(
+                chunk.texcoords, chunk.texcoords + chunk.num_texcoords * 2);
+        }
+        item.vertex_range = {chunk.vertex_range[0], chunk.vertex_range[1]};
+        item.normal_range = {chunk.normal_range[0], chunk.normal_range[1]};
+        item.texcoord_range = {chunk.texcoord_range[0],
+                               chunk.texcoord_range[1]};
+        static_cast<ShapeQueue*>(user_data)->push(std::move(item));
+    }
+
+public:
+    //解析时把shape发布到这个队列
+    void attach(tinyobj::ObjReaderConfig& config) {
+        config.shape_cb = &ShapeQueue::onShape;
+        config.shape_cb_user_data = this;
+    }
+
+    void push(ProgressiveShape&& item) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_items.push_back(std::move(item));
+        }
+        m_items_available_cv.notify_one();
+    }
+
+    //阻塞直到取到一个shape, 队列关闭并且取空之后返回false
+    bool pop(ProgressiveShape& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_items_available_cv.wait(
+            lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+
+    //生产者解析结束后调用
+    void close() {
+        //持锁通知: 消费者醒来后可能马上销毁队列
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_items_available_cv.notify_all();
+    }
+};
@@ -0,0 +1,376 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 加载之后的空间重排: 顶点按Morton/Hilbert曲线排序, 所有shape的下标跟着改,
+// 面再按中心点的曲线编码排序. 之后按面遍历顶点的pass(算法线, 上传,
+// 简化...)访问的顶点在内存里挨在一起, 不再每次都cache miss.
+// 只重排v(连同对应的颜色, 权重和蒙皮), vn/vt的下标空间不动.
+// 要求交错的顶点布局, soa_attributes解析的结果先InterleaveAttributes;
+// lazy_attributes解析的结果先decodeAll, 否则之后解码的坐标会写回
+// 重排之前的位置
+
+enum class SpaceCurve {
+    Morton,
+    Hilbert,  //相邻编码在空间上也相邻, 局部性更好, 编码稍慢
+};
+
+struct ReorderOptions {
+    SpaceCurve curve{SpaceCurve::Hilbert};
+    bool       reorder_faces{true};  //面也按中心点排序
+};
+
+namespace spatial_reorder_detail {
+
+// 每轴10位(2^30个格子)对排序已经够细, 编码和下标能塞进一个uint64_t
+constexpr int      kBits = 10;
+constexpr uint32_t kMaxCoord = (1u << kBits) - 1;
+
+//把x的低10位摊开到每3位一位
+inline uint32_t spreadBits(uint32_t x) {
+    x &= kMaxCoord;
+    x = (x | x << 16) & 0x030000ff;
+    x = (x | x << 8) & 0x0300f00f;
+    x = (x | x << 4) & 0x030c30c3;
+    x = (x | x << 2) & 0x09249249;
+    return x;
+}
+
+inline uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    return spreadBits(x) << 2 | spreadBits(y) << 1 | spreadBits(z);
+}
+
+// Skilling, "Programming the Hilbert curve"(2004): 坐标先转成转置形式的
+// Hilbert下标, 再按位交织
+inline uint32_t hilbertCode(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t       v[3] = {x, y, z};
+    const uint32_t top = 1u << (kBits - 1);
+    for (uint32_t q = top; q > 1; q >>= 1) {
+        const uint32_t p = q - 1;
+        for (int i = 0; i < 3; ++i) {
+            //位为1时翻转v[0]的低位, 否则交换v[0]和v[i]的低位. 不用分支
+            const uint32_t set = 0u - ((v[i] & q) != 0);
+            const uint32_t t = (v[0] ^ v[i]) & p & ~set;
+            v[0] ^= (p & set) | t;
+            v[i] ^= t;
+        }
+    }
+    // Gray编码
+    v[1] ^= v[0];
+    v[2] ^= v[1];
+    uint32_t t = 0;
+    for (uint32_t q = top; q > 1; q >>= 1) {
+        if (v[2] & q) {
+            t ^= q - 1;
+        }
+    }
+    return mortonCode(v[0] ^ t, v[1] ^ t, v[2] ^ t);
+}
+
+//包围盒映射到[0, 2^10)的格点
+struct Quantizer {
+    double     min[3]{0.0, 0.0, 0.0};
+    double     scale[3]{0.0, 0.0, 0.0};
+    SpaceCurve curve{SpaceCurve::Hilbert};
+
+    uint32_t quantize(int axis, double value) const {
+        const double q = (value - min[axis]) * scale[axis];
+        if (!(q > 0.0)) {
+            return 0;  //包括NaN
+        }
+        return q >= kMaxCoord ? kMaxCoord : static_cast<uint32_t>(q);
+    }
+
+    uint32_t code(double x, double y, double z) const {
+        const uint32_t qx = quantize(0, x);
+        const uint32_t qy = quantize(1, y);
+        const uint32_t qz = quantize(2, z);
+        return curve == SpaceCurve::Hilbert ? hilbertCode(qx, qy, qz)
+                                            : mortonCode(qx, qy, qz);
+    }
+};
+
+//高32位是曲线编码, 低32位是原下标: 编码相同时保持原顺序,
+//结果与线程数无关
+using KeyIndex = uint64_t;
+
+inline KeyIndex makeKey(uint32_t code, size_t index) {
+    return uint64_t(code) << 32 | static_cast<uint32_t>(index);
+}
+
+inline size_t indexOf(KeyIndex key) {
+    return static_cast<uint32_t>(key);
+}
+
+//每块至少kGrain个元素. 小shape只有一块, parallelize_loop直接在当前线程跑,
+//几十万个小shape时不用每个都经过任务队列
+constexpr size_t kGrain = 16384;
+
+inline size_t blockCount(const ThreadPool& pool, size_t n) {
+    return std::min<size_t>(pool.get_max_thread_count(), n / kGrain + 1);
+}
+
+// 各块并行std::sort, 再两两并行归并
+template <class T>
+void parallelSort(std::vector<T>& items, ThreadPool& pool) {
+    const size_t n = items.size();
+    const size_t blocks = blockCount(pool, n);
+    if (blocks <= 1) {
+        std::sort(items.begin(), items.end());
+        return;
+    }
+    std::vector<size_t> bounds(blocks + 1);
+    for (size_t i = 0; i <= blocks; ++i) {
+        bounds[i] = n * i / blocks;
+    }
+    pool.parallelize_loop(
+        0, blocks,
+        [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                std::sort(items.begin() + bounds[i],
+                          items.begin() + bounds[i + 1]);
+            }
+        },
+        blocks);
+
+    std::vector<T>  tmp(n);
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &tmp;
+    for (size_t width = 1; width < blocks; width *= 2) {
+        const size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        pool.parallelize_loop(
+            0, pairs,
+            [&](size_t first, size_t last) {
+                for (size_t p = first; p < last; ++p) {
+                    const size_t lo = bounds[p * 2 * width];
+                    const size_t mid =
+                        bounds[std::min(p * 2 * width + width, blocks)];
+                    const size_t hi =
+                        bounds[std::min(p * 2 * width + 2 * width, blocks)];
+                    std::merge(src->begin() + lo, src->begin() + mid,
+                               src->begin() + mid, src->begin() + hi,
+                               dst->begin() + lo);
+                }
+            },
+            pairs);
+        std::swap(src, dst);
+    }
+    if (src != &items) {
+        items.swap(tmp);
+    }
+}
+
+// values按order重排, 每个元素stride个分量
+template <class T>
+void permute(std::vector<T>& values, size_t stride,
+             const std::vector<KeyIndex>& order, ThreadPool& pool) {
+    std::vector<T> out(values.size());
+    pool.parallelize_loop(
+        0, order.size(),
+        [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const size_t from = indexOf(order[i]) * stride;
+                std::copy_n(values.begin() + from, stride,
+                            out.begin() + i * stride);
+            }
+        },
+        blockCount(pool, order.size()));
+    values.swap(out);
+}
+
+inline Quantizer makeQuantizer(const std::vector<tinyobj::real_t>& xyz,
+                               SpaceCurve curve, ThreadPool& pool) {
+    const size_t n = xyz.size() / 3;
+    const size_t blocks = blockCount(pool, n);
+    std::vector<double> lo(blocks * 3, std::numeric_limits<double>::max());
+    std::vector<double> hi(blocks * 3, -std::numeric_limits<double>::max());
+    pool.parallelize_loop(
+        0, blocks,
+        [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+                for (size_t i = n * b / blocks; i < n * (b + 1) / blocks;
+                     ++i) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        const double v = xyz[i * 3 + k];
+                        lo[b * 3 + k] = std::min(lo[b * 3 + k], v);
+                        hi[b * 3 + k] = std::max(hi[b * 3 + k], v);
+                    }
+                }
+            }
+        },
+        blocks);
+
+    Quantizer q;
+    q.curve = curve;
+    for (size_t k = 0; k < 3; ++k) {
+        double mn = lo[k];
+        double mx = hi[k];
+        for (size_t b = 1; b < blocks; ++b) {
+            mn = std::min(mn, lo[b * 3 + k]);
+            mx = std::max(mx, hi[b * 3 + k]);
+        }
+        q.min[k] = mn;
+        q.scale[k] = mx > mn ? kMaxCoord / (mx - mn) : 0.0;
+    }
+    return q;
+}
+
+//按中心点编码重排一个mesh的面, 每面的属性跟着走
+inline void reorderFaces(tinyobj::mesh_t&                    mesh,
+                         const std::vector<tinyobj::real_t>& xyz,
+                         const Quantizer& quantizer, ThreadPool& pool) {
+    const size_t        num_faces = mesh.num_face_vertices.size();
+    std::vector<size_t> offsets(num_faces + 1, 0);
+    for (size_t f = 0; f < num_faces; ++f) {
+        offsets[f + 1] = offsets[f] + mesh.num_face_vertices[f];
+    }
+    //面号和顶点号一样只占KeyIndex的低32位
+    if (num_faces < 2 || offsets.back() != mesh.indices.size() ||
+        num_faces > std::numeric_limits<uint32_t>::max()) {
+        return;
+    }
+    const size_t num_vertices = xyz.size() / 3;
+
+    std::vector<KeyIndex> order(num_faces);
+    pool.parallelize_loop(
+        0, num_faces,
+        [&](size_t first, size_t last) {
+            for (size_t f = first; f < last; ++f) {
+                double c[3] = {0.0, 0.0, 0.0};
+                size_t count = 0;
+                for (size_t i = offsets[f]; i < offsets[f + 1]; ++i) {
+                    const auto v = mesh.indices[i].vertex_index;
+                    if (v < 0 || size_t(v) >= num_vertices) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < 3; ++k) {
+                        c[k] += xyz[size_t(v) * 3 + k];
+                    }
+                    ++count;
+                }
+                const double inv = count ? 1.0 / double(count) : 0.0;
+                order[f] = makeKey(
+                    quantizer.code(c[0] * inv, c[1] * inv, c[2] * inv), f);
+            }
+        },
+        blockCount(pool, num_faces));
+    parallelSort(order, pool);
+
+    std::vector<size_t> new_offsets(num_faces + 1, 0);
+    for (size_t f = 0; f < num_faces; ++f) {
+        new_offsets[f + 1] =
+            new_offsets[f] + mesh.num_face_vertices[indexOf(order[f])];
+    }
+    std::vector<tinyobj::index_t> indices(mesh.indices.size());
+    pool.parallelize_loop(
+        0, num_faces,
+        [&](size_t first, size_t last) {
+            for (size_t f = first; f < last; ++f) {
+                const size_t from = indexOf(order[f]);
+                std::copy(mesh.indices.begin() + offsets[from],
+                          mesh.indices.begin() + offsets[from + 1],
+                          indices.begin() + new_offsets[f]);
+            }
+        },
+        blockCount(pool, num_faces));
+    mesh.indices.swap(indices);
+    mesh.material_ranges.clear();  //面顺序变了, 需要的话重新按材质分组
+    permute(mesh.num_face_vertices, 1, order, pool);
+    if (mesh.material_ids.size() == num_faces) {
+        permute(mesh.material_ids, 1, order, pool);
+    }
+    if (mesh.smoothing_group_ids.size() == num_faces) {
+        permute(mesh.smoothing_group_ids, 1, order, pool);
+    }
+}
+
+}  // namespace spatial_reorder_detail
+
+// 在线程池上重排attrib的顶点和shapes的面. 返回旧顶点下标到新下标的映射
+// (remap[old] = new), 调用方自己存的顶点下标可以用它更新.
+// SoA布局或者v行还没全部解码时什么都不做, 返回空
+inline std::vector<uint32_t>
+spatialReorder(tinyobj::attrib_t&              attrib,
+               std::vector<tinyobj::shape_t>& shapes, ThreadPool& pool,
+               const ReorderOptions& options = {}) {
+    using namespace spatial_reorder_detail;
+    const size_t n = attrib.vertices.size() / 3;
+    if (n == 0 || n > std::numeric_limits<uint32_t>::max() ||
+        !attrib.lazy.vertex_lines.empty()) {
+        return {};
+    }
+
+    const Quantizer       quantizer =
+        makeQuantizer(attrib.vertices, options.curve, pool);
+    std::vector<KeyIndex> order(n);
+    pool.parallelize_loop(
+        0, n,
+        [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const tinyobj::real_t* p = &attrib.vertices[i * 3];
+                order[i] = makeKey(quantizer.code(p[0], p[1], p[2]), i);
+            }
+        },
+        blockCount(pool, n));
+    parallelSort(order, pool);
+
+    std::vector<uint32_t> remap(n);
+    pool.parallelize_loop(
+        0, n,
+        [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                remap[indexOf(order[i])] = static_cast<uint32_t>(i);
+            }
+        },
+        blockCount(pool, n));
+
+    permute(attrib.vertices, 3, order, pool);
+    if (attrib.vertex_weights.size() == n) {
+        permute(attrib.vertex_weights, 1, order, pool);
+    }
+    if (attrib.colors.size() == n * 3) {
+        permute(attrib.colors, 3, order, pool);
+    }
+    for (auto& sw : attrib.skin_weights) {
+        if (sw.vertex_id >= 0 && size_t(sw.vertex_id) < n) {
+            const size_t old_id = size_t(sw.vertex_id);
+            sw.vertex_id = static_cast<tinyobj::index_int_t>(remap[old_id]);
+        }
+    }
+
+    //越界的下标(LoadObj已经警告过)原样保留
+    auto remapIndices = [&](std::vector<tinyobj::index_t>& indices) {
+        pool.parallelize_loop(
+            0, indices.size(),
+            [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    auto& v = indices[i].vertex_index;
+                    if (v >= 0 && size_t(v) < n) {
+                        v = static_cast<tinyobj::index_int_t>(
+                            remap[size_t(v)]);
+                    }
+                }
+            },
+            blockCount(pool, indices.size()));
+    };
+    for (auto& shape : shapes) {
+        remapIndices(shape.mesh.indices);
+        remapIndices(shape.lines.indices);
+        remapIndices(shape.points.indices);
+        if (options.reorder_faces) {
+            reorderFaces(shape.mesh, attrib.vertices, quantizer, pool);
+        }
+    }
+    return remap;
+}
+
+inline std::vector<uint32_t>
+spatialReorder(tinyobj::ObjReader& reader, ThreadPool& pool,
+               const ReorderOptions& options = {}) {
+    return spatialReorder(reader.GetAttrib(), reader.GetShapes(), pool,
+                          options);
+}
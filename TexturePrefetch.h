@@ -0,0 +1,303 @@
+#pragma once
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ObjLoaders.h"
+#include "tiny_obj_loader.h"
+
+// 纹理预取: 每个mtllib解析完(ObjReaderConfig::materials_cb), 把材质里
+// map_Kd/map_bump/norm引用的纹理路径交给后台线程, 用io_uring发
+// fadvise(WILLNEED)或者整个读进内存. 解析obj的同时纹理已经在读,
+// 渲染器来要的时候页缓存是热的, 或者直接take()拿走读好的数据.
+//
+//   TexturePrefetcher        prefetcher({.mode = PrefetchMode::Read});
+//   tinyobj::ObjReaderConfig config;
+//   prefetcher.attach(config);
+//   reader.ParseFromFile(path, config);
+//   prefetcher.take(prefetcher.paths()[0], pixels);
+
+enum class PrefetchMode {
+    Hint,  //只让内核预读进页缓存, 不占用户态内存
+    Read,  //读进TexturePrefetcher自己的缓冲区, 用take()取走
+};
+
+struct PrefetchOptions {
+    PrefetchMode mode{PrefetchMode::Hint};
+    unsigned     queue_depth{32};  //同时在飞的请求数
+    //Read模式下比这大的文件只发fadvise
+    size_t max_read_bytes{size_t(64) << 20};
+};
+
+struct PrefetchStats {
+    size_t requested{0};   //去重后的纹理数
+    size_t completed{0};
+    size_t failed{0};      //打不开或读失败
+    size_t bytes_read{0};  // Read模式读进内存的字节数
+};
+
+class TexturePrefetcher {
+private:
+    enum class State { Queued, InFlight, Done, Failed };
+
+    struct Entry {
+        std::string       path;
+        State             state{State::Queued};
+        int               fd{-1};
+        bool              read{false};  // false时只发fadvise
+        size_t            done{0};      //已经读到的字节数
+        std::vector<char> data;
+    };
+
+    static constexpr size_t kMaxRead = size_t(1) << 30;
+
+    PrefetchOptions m_options;
+    IOUring         m_ring;
+
+    //m_entries只在末尾追加, 元素地址不变, 可以当io_uring的user_data
+    std::deque<Entry>                       m_entries = {};
+    std::unordered_map<std::string, size_t> m_index = {};
+    PrefetchStats                           m_stats = {};
+    std::mutex                              m_mutex = {};
+    std::condition_variable                 m_queued_cv = {};
+    std::condition_variable                 m_finished_cv = {};
+    bool                                    m_stop = false;
+    std::thread                             m_worker;
+
+    static void onMaterials(void* user_data,
+                            const tinyobj::material_t* materials,
+                            size_t num_materials, const char* mtl_dir) {
+        static_cast<TexturePrefetcher*>(user_data)->prefetch(
+            materials, num_materials, mtl_dir);
+    }
+
+    //从entry.done接着读, 单次最多1GB
+    void submitRead(Entry& entry) {
+        const size_t  left = entry.data.size() - entry.done;
+        io_uring_sqe* sqe = io_uring_get_sqe(m_ring.get_ring());
+        io_uring_prep_read(sqe, entry.fd, entry.data.data() + entry.done,
+                           static_cast<unsigned>(std::min(left, kMaxRead)),
+                           entry.done);
+        io_uring_sqe_set_data(sqe, &entry);
+    }
+
+    //打开文件并准备sqe, 失败时直接结束这一项
+    bool start(Entry& entry) {
+        entry.fd = open(entry.path.c_str(), O_RDONLY);
+        struct stat s;
+        if (entry.fd < 0 || fstat(entry.fd, &s) != 0) {
+            finish(entry, false);
+            return false;
+        }
+        const auto size = static_cast<size_t>(s.st_size);
+        entry.read = m_options.mode == PrefetchMode::Read && size > 0 &&
+                     size <= m_options.max_read_bytes;
+        if (entry.read) {
+            entry.data.resize(size);
+            submitRead(entry);
+            return true;
+        }
+        io_uring_sqe* sqe = io_uring_get_sqe(m_ring.get_ring());
+        // len为0表示到文件末尾
+        io_uring_prep_fadvise(sqe, entry.fd, 0, 0, POSIX_FADV_WILLNEED);
+        io_uring_sqe_set_data(sqe, &entry);
+        return true;
+    }
+
+    //短读时接着读剩下的部分, 返回true表示请求还在飞
+    bool complete(Entry& entry, int res) {
+        if (res < 0 || (entry.read && res == 0)) {
+            finish(entry, false);
+            return false;
+        }
+        if (entry.read) {
+            entry.done += static_cast<size_t>(res);
+            if (entry.done < entry.data.size()) {
+                submitRead(entry);
+                return true;
+            }
+        }
+        finish(entry, true);
+        return false;
+    }
+
+    void finish(Entry& entry, bool ok) {
+        if (entry.fd >= 0) {
+            close(entry.fd);
+            entry.fd = -1;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        entry.state = ok ? State::Done : State::Failed;
+        if (!ok) {
+            entry.data.clear();
+            ++m_stats.failed;
+        } else {
+            m_stats.bytes_read += entry.data.size();
+        }
+        ++m_stats.completed;
+        m_finished_cv.notify_all();
+    }
+
+    void run() {
+        size_t next = 0;  //下一个还没提交的项
+        size_t inflight = 0;
+        for (;;) {
+            std::vector<Entry*> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (inflight == 0) {
+                    m_queued_cv.wait(lock, [&] {
+                        return m_stop || next < m_entries.size();
+                    });
+                    if (m_stop) {
+                        return;
+                    }
+                }
+                while (!m_stop && next < m_entries.size() &&
+                       inflight + batch.size() < m_options.queue_depth) {
+                    batch.push_back(&m_entries[next++]);
+                    batch.back()->state = State::InFlight;
+                }
+            }
+            for (Entry* entry : batch) {
+                inflight += start(*entry) ? 1 : 0;
+            }
+            if (inflight == 0) {
+                continue;
+            }
+            // 有请求在飞时阻塞在完成队列上, 新来的路径最多等一次I/O
+            io_uring_submit_and_wait(m_ring.get_ring(), 1);
+            io_uring_cqe* cqe;
+            unsigned      head;  // unused
+            unsigned      processed{0};
+            io_uring_for_each_cqe(m_ring.get_ring(), head, cqe) {
+                auto* entry =
+                    static_cast<Entry*>(io_uring_cqe_get_data(cqe));
+                if (!complete(*entry, cqe->res)) {
+                    --inflight;
+                }
+                processed++;
+            }
+            io_uring_cq_advance(m_ring.get_ring(), processed);
+        }
+    }
+
+public:
+    explicit TexturePrefetcher(const PrefetchOptions& options = {})
+        : m_options(options),
+          m_ring(options.queue_depth ? options.queue_depth : 1) {
+        if (m_options.queue_depth == 0) {
+            m_options.queue_depth = 1;
+        }
+        m_worker = std::thread([this] { run(); });
+    }
+
+    //没提交的请求丢掉, 在飞的等内核完成后才释放缓冲区
+    ~TexturePrefetcher() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_queued_cv.notify_all();
+        m_worker.join();
+    }
+
+    TexturePrefetcher(const TexturePrefetcher&) = delete;
+    TexturePrefetcher& operator=(const TexturePrefetcher&) = delete;
+
+    //解析时每读完一个mtl文件就预取它的纹理
+    void attach(tinyobj::ObjReaderConfig& config) {
+        config.materials_cb = &TexturePrefetcher::onMaterials;
+        config.materials_cb_user_data = this;
+    }
+
+    // 纹理名相对于mtl文件所在目录, 和LoadMtl的搜索路径一致
+    static std::string resolve(const std::string& mtl_dir,
+                               const std::string& texname) {
+        if (mtl_dir.empty() || (!texname.empty() && texname[0] == '/')) {
+            return texname;
+        }
+        return mtl_dir.back() == '/' ? mtl_dir + texname
+                                     : mtl_dir + '/' + texname;
+    }
+
+    //可以从多个解析线程同时调用, 同一个路径只预取一次
+    void prefetch(const tinyobj::material_t* materials,
+                  size_t num_materials, const std::string& mtl_dir) {
+        bool queued = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < num_materials; ++i) {
+                const tinyobj::material_t& m = materials[i];
+                for (const std::string* name : {&m.diffuse_texname,
+                                                &m.bump_texname,
+                                                &m.normal_texname}) {
+                    if (name->empty()) {
+                        continue;
+                    }
+                    std::string path = resolve(mtl_dir, *name);
+                    if (m_index.emplace(path, m_entries.size()).second) {
+                        m_entries.emplace_back().path = std::move(path);
+                        ++m_stats.requested;
+                        queued = true;
+                    }
+                }
+            }
+        }
+        if (queued) {
+            m_queued_cv.notify_one();
+        }
+    }
+
+    //到目前为止请求过的纹理路径, 按请求顺序
+    std::vector<std::string> paths() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<std::string>     result;
+        result.reserve(m_entries.size());
+        for (const Entry& entry : m_entries) {
+            result.push_back(entry.path);
+        }
+        return result;
+    }
+
+    //阻塞直到已请求的纹理全部完成
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished_cv.wait(
+            lock, [this] { return m_stats.completed == m_entries.size(); });
+    }
+
+    // Read模式下等path读完并把数据move出来, 只能取一次.
+    // 没请求过, 读失败, 或者只发了fadvise时返回false
+    bool take(const std::string& path, std::vector<char>& out) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto                   it = m_index.find(path);
+        if (it == m_index.end()) {
+            return false;
+        }
+        Entry& entry = m_entries[it->second];
+        m_finished_cv.wait(lock, [&] {
+            return entry.state == State::Done ||
+                   entry.state == State::Failed;
+        });
+        if (entry.state != State::Done || !entry.read) {
+            return false;
+        }
+        out = std::move(entry.data);
+        entry.read = false;
+        return true;
+    }
+
+    PrefetchStats stats() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+};
@@ -1,66 +1,186 @@
 #pragma once
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
 #include <coroutine>
+#include <fstream>
 #include <functional>
 #include <mutex>
 #include <queue>
+#include <string>
+#include <thread>
 #include <vector>
 
 using concurrency_t =
     std::invoke_result_t<decltype(std::thread::hardware_concurrency)>;
 
+// 线程数在[min, max]之间自适应: 任务排队超过m_grow_latency且没有空闲线程时
+// 扩容, 空闲超过m_idle_timeout且多于下限时退出.
+// 默认上限取cgroup cpu.max配额和CPU亲和性掩码里较小的那个
 class ThreadPool {
 private:
-    std::queue<std::function<void()>> m_tasks = {};
-    std::vector<std::thread>          m_threads = {};
-    std::condition_variable           m_tasks_available_cv = {};
-    std::condition_variable           m_tasks_done_cv = {};
-    std::mutex                        m_mutex = {};
-    bool                              m_workers_running = false;
-    bool                              m_waiting = false;
-    concurrency_t                     m_thread_count = 0;
-    size_t                            m_tasks_running = 0;
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::microseconds kGrowLatency{500};
+    static constexpr std::chrono::milliseconds kIdleTimeout{200};
+
+    struct QueuedTask {
+        std::function<void()> task;
+        clock::time_point     enqueued;
+    };
+
+    std::queue<QueuedTask>       m_tasks = {};
+    std::vector<std::thread>     m_threads = {};
+    std::vector<std::thread::id> m_exited_threads = {};
+    std::condition_variable      m_tasks_available_cv = {};
+    std::condition_variable      m_tasks_done_cv = {};
+    mutable std::mutex           m_mutex = {};
+    bool                         m_workers_running = false;
+    size_t                       m_waiters = 0;  //wait_for_tasks里的线程数
+    concurrency_t                m_thread_count = 0;
+    concurrency_t                m_idle_threads = 0;
+    concurrency_t                m_min_threads = 1;
+    concurrency_t                m_max_threads = 1;
+    size_t                       m_tasks_running = 0;
+    clock::duration              m_grow_latency = kGrowLatency;
+    clock::duration              m_idle_timeout = kIdleTimeout;
+
+    // cgroup限制的CPU数(可以是小数), 没有限制返回0
+    static double cgroup_cpu_limit() {
+        std::string   path;
+        std::ifstream self("/proc/self/cgroup");
+        std::string   line;
+        while (std::getline(self, line)) {
+            if (line.rfind("0::", 0) == 0) {
+                path = line.substr(3);
+            }
+        }
+        // cgroup v2: 从自己的cgroup往上找, 取最严格的cpu.max
+        double limit = 0.0;
+        while (true) {
+            std::ifstream cpu_max("/sys/fs/cgroup" + path + "/cpu.max");
+            std::string   quota;
+            double        period = 0.0;
+            if (cpu_max >> quota >> period && quota != "max" &&
+                period > 0) {
+                const double cpus = std::stod(quota) / period;
+                if (limit == 0.0 || cpus < limit) {
+                    limit = cpus;
+                }
+            }
+            if (path.empty() || path == "/") {
+                break;
+            }
+            path = path.substr(0, path.find_last_of('/'));
+        }
+        if (limit > 0.0) {
+            return limit;
+        }
+        // cgroup v1
+        std::ifstream quota_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        std::ifstream period_file("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        double        quota_us = 0.0;
+        double        period_us = 0.0;
+        if (quota_file >> quota_us && period_file >> period_us &&
+            quota_us > 0 && period_us > 0) {
+            return quota_us / period_us;
+        }
+        return 0.0;
+    }
 
     concurrency_t
     determine_thread_count(const concurrency_t thread_count) const {
         if (thread_count > 0) {
             return thread_count;
         } else {
-            if (std::thread::hardware_concurrency() > 0) {
-                return std::thread::hardware_concurrency();
-            } else {
-                return 1;
+            return available_concurrency();
+        }
+    }
+
+    // 需要持有m_mutex
+    void spawn_worker() {
+        reap_exited_threads();
+        ++m_thread_count;
+        m_threads.emplace_back(&ThreadPool::worker, this);
+    }
+
+    // 需要持有m_mutex. 回收已经缩容退出的线程
+    void reap_exited_threads() {
+        for (const auto& id : m_exited_threads) {
+            auto it = std::find_if(m_threads.begin(), m_threads.end(),
+                                   [&id](const std::thread& t) {
+                                       return t.get_id() == id;
+                                   });
+            if (it != m_threads.end()) {
+                it->join();
+                m_threads.erase(it);
             }
         }
+        m_exited_threads.clear();
+    }
+
+    // 需要持有m_mutex. 队头任务等太久并且没人空闲就扩容
+    void grow_if_congested() {
+        if (m_idle_threads == 0 && m_thread_count < m_max_threads &&
+            !m_tasks.empty() &&
+            clock::now() - m_tasks.front().enqueued >= m_grow_latency) {
+            spawn_worker();
+        }
     }
 
     void worker() {
-        std::function<void()> task;
+        std::unique_lock<std::mutex> lock(m_mutex);
         while (true) {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_tasks_available_cv.wait(lock, [this] {
-                return !m_workers_running || !m_tasks.empty();
-            });
+            ++m_idle_threads;
+            const bool has_task =
+                m_tasks_available_cv.wait_for(lock, m_idle_timeout, [this] {
+                    return !m_workers_running || !m_tasks.empty();
+                });
+            --m_idle_threads;
             if (!m_workers_running)
                 break;
-            task = std::move(m_tasks.front());
+            if (!has_task) {
+                if (m_thread_count > m_min_threads) {
+                    --m_thread_count;
+                    m_exited_threads.push_back(std::this_thread::get_id());
+                    break;
+                }
+                continue;
+            }
+            QueuedTask queued = std::move(m_tasks.front());
             m_tasks.pop();
             ++m_tasks_running;
+            grow_if_congested();
             lock.unlock();
-            task();
+            queued.task();
+            queued.task = nullptr;
             lock.lock();
             --m_tasks_running;
-            if (m_waiting && !m_tasks_running && m_tasks.empty()) {
+            if (m_waiters && !m_tasks_running && m_tasks.empty()) {
                 m_tasks_done_cv.notify_all();
             }
         }
     }
-    void wait_for_tasks() {
+    // 在当前线程执行一个排队中的任务, 队列为空时返回false
+    bool run_pending_task() {
         std::unique_lock<std::mutex> lock(m_mutex);
-        m_waiting = true;
-        m_tasks_done_cv.wait(
-            lock, [this] { return !m_tasks_running && m_tasks.empty(); });
-        m_waiting = false;
+        if (m_tasks.empty()) {
+            return false;
+        }
+        QueuedTask queued = std::move(m_tasks.front());
+        m_tasks.pop();
+        ++m_tasks_running;
+        lock.unlock();
+        queued.task();
+        queued.task = nullptr;
+        lock.lock();
+        --m_tasks_running;
+        if (m_waiters && !m_tasks_running && m_tasks.empty()) {
+            m_tasks_done_cv.notify_all();
+        }
+        return true;
     }
     void destroy_threads() {
         {
@@ -68,21 +188,27 @@ private:
             m_workers_running = false;
         }
         m_tasks_available_cv.notify_all();
-        for (concurrency_t i = 0; i < m_thread_count; ++i) {
-            m_threads[i].join();
+        for (auto& thread : m_threads) {
+            thread.join();
         }
     }
 
 public:
+    // thread_count > 0 时固定线程数, 否则在[1, available_concurrency()]
+    // 之间自适应
     ThreadPool(const concurrency_t thread_count = 0)
-        : m_thread_count(determine_thread_count(thread_count)) {
-        m_threads.resize(m_thread_count);
-        {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_workers_running = true;
-        }
-        for (concurrency_t i = 0; i < m_thread_count; ++i) {
-            m_threads[i] = std::thread(&ThreadPool::worker, this);
+        : ThreadPool(thread_count > 0 ? thread_count : 1,
+                     determine_thread_count(thread_count)) {}
+
+    ThreadPool(const concurrency_t min_threads,
+               const concurrency_t max_threads)
+        : m_min_threads(std::max<concurrency_t>(min_threads, 1)),
+          m_max_threads(std::max(max_threads, m_min_threads)) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workers_running = true;
+        m_threads.reserve(m_max_threads);
+        for (concurrency_t i = 0; i < m_max_threads; ++i) {
+            spawn_worker();
         }
     }
     ~ThreadPool() {
@@ -90,16 +216,122 @@ public:
         destroy_threads();
     }
 
+    // 实际可用的CPU数: 亲和性掩码和cgroup配额取小
+    static concurrency_t available_concurrency() {
+        concurrency_t count = std::thread::hardware_concurrency();
+        cpu_set_t     set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            count = static_cast<concurrency_t>(CPU_COUNT(&set));
+        }
+        const double limit = cgroup_cpu_limit();
+        if (limit > 0.0) {
+            const auto quota = static_cast<concurrency_t>(std::ceil(limit));
+            count = count > 0 ? std::min(count, quota) : quota;
+        }
+        return std::max<concurrency_t>(count, 1);
+    }
+
     template <class F, class... A>
     void push_task(F&& task, A&&... args) {
         {
             std::unique_lock<std::mutex> lock(m_mutex);
             m_tasks.push(
-                std::bind(std::forward<F>(task), std::forward<A>(args)...));
+                {std::bind(std::forward<F>(task), std::forward<A>(args)...),
+                 clock::now()});
+            grow_if_congested();
         }
         m_tasks_available_cv.notify_one();
     }
 
+    void wait_for_tasks() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_waiters;
+        m_tasks_done_cv.wait(
+            lock, [this] { return !m_tasks_running && m_tasks.empty(); });
+        --m_waiters;
+    }
+
+    // 等到done()为真, 期间帮忙执行队列中的任务
+    template <class P>
+    void wait_until(P&& done) {
+        while (!done()) {
+            if (!run_pending_task()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // 把[first, last)切成num_blocks块并行执行loop(start, end),
+    // 返回时全部完成. 调用线程也会帮忙执行队列中的任务,
+    // 所以在工作线程里调用也不会死锁. 只有一块时直接在调用线程执行
+    template <class F>
+    void parallelize_loop(const size_t first, const size_t last, F&& loop,
+                          size_t num_blocks = 0) {
+        if (last <= first) {
+            return;
+        }
+        const size_t total = last - first;
+        if (num_blocks == 0) {
+            num_blocks = get_max_thread_count();
+        }
+        num_blocks = std::min(std::max<size_t>(num_blocks, 1), total);
+        //只有一块就不经过任务队列
+        if (num_blocks == 1) {
+            loop(first, last);
+            return;
+        }
+        const size_t block_size = total / num_blocks;
+        const size_t remainder = total % num_blocks;
+
+        struct LoopState {
+            std::mutex              mutex;
+            std::condition_variable done_cv;
+            size_t                  remaining;
+        } state;
+        state.remaining = num_blocks;
+
+        size_t start = first;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            const size_t end = start + block_size + (i < remainder ? 1 : 0);
+            push_task([&state, &loop, start, end] {
+                loop(start, end);
+                std::unique_lock<std::mutex> lock(state.mutex);
+                if (--state.remaining == 0) {
+                    state.done_cv.notify_all();
+                }
+            });
+            start = end;
+        }
+        while (run_pending_task()) {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if (state.remaining == 0) {
+                return;
+            }
+        }
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.done_cv.wait(lock, [&state] { return state.remaining == 0; });
+    }
+
+    concurrency_t get_thread_count() const {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_thread_count;
+    }
+
+    concurrency_t get_max_thread_count() const {
+        return m_max_threads;
+    }
+
+    // 调整扩缩容的灵敏度
+    void set_grow_latency(clock::duration latency) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_grow_latency = latency;
+    }
+    void set_idle_timeout(clock::duration timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle_timeout = timeout;
+    }
+
     auto schedule() {
         struct Awaiter : public std::suspend_always {
             ThreadPool& pool;
@@ -111,4 +343,4 @@ public:
         };
         return Awaiter(*this);
     }
-};
\ No newline at end of file
+};
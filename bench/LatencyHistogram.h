@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+// HDR风格的对数-线性直方图: 每个2的幂区间再线性分成2^kSubBits格,
+// 记录范围[0, 2^63), 相对误差小于2^-kSubBits. 记录是O(1)的,
+// 各线程各自记录, 最后merge
+class LatencyHistogram {
+public:
+    static constexpr int      kSubBits = 10;
+    static constexpr uint64_t kSubCount = uint64_t(1) << kSubBits;
+
+    LatencyHistogram() : m_counts((64 - kSubBits + 1) * kSubCount, 0) {}
+
+    void record(uint64_t value, uint64_t count = 1) {
+        m_counts[index(value)] += count;
+        m_total += count;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+        m_sum += static_cast<double>(value) * static_cast<double>(count);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+        m_sum += other.m_sum;
+    }
+
+    uint64_t count() const {
+        return m_total;
+    }
+    uint64_t min() const {
+        return m_total ? m_min : 0;
+    }
+    uint64_t max() const {
+        return m_max;
+    }
+    double mean() const {
+        return m_total ? m_sum / static_cast<double>(m_total) : 0.0;
+    }
+
+    // q in [0, 100]
+    uint64_t percentile(double q) const {
+        if (m_total == 0) {
+            return 0;
+        }
+        const double   clamped = std::clamp(q, 0.0, 100.0);
+        const double   rank =
+            std::ceil(clamped / 100.0 * static_cast<double>(m_total));
+        const uint64_t target =
+            std::max<uint64_t>(1, static_cast<uint64_t>(rank));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            seen += m_counts[i];
+            if (seen >= target) {
+                return std::min(highestEquivalent(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    // HdrHistogram的.hgrm百分位格式, 值按scale缩放(如纳秒转毫秒)
+    void outputPercentiles(std::ostream& os, double scale = 1.0,
+                           int ticks_per_half = 5) const {
+        os << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+        if (m_total == 0) {
+            return;
+        }
+        double q = 0.0;
+        while (true) {
+            const uint64_t value = percentile(q);
+            uint64_t       below = 0;
+            for (size_t i = 0; i <= index(value); ++i) {
+                below += m_counts[i];
+            }
+            const double fraction =
+                static_cast<double>(below) / static_cast<double>(m_total);
+            os.setf(std::ios::fixed);
+            os.precision(3);
+            os.width(12);
+            os << static_cast<double>(value) / scale;
+            os.precision(12);
+            os.width(15);
+            os << fraction;
+            os.width(11);
+            os << below;
+            if (fraction < 1.0) {
+                os.precision(2);
+                os.width(15);
+                os << 1.0 / (1.0 - fraction);
+            }
+            os << "\n";
+            if (below >= m_total) {
+                break;
+            }
+            // 每走一半剩余区间打ticks_per_half个点, 尾部越来越密
+            const double remaining = 100.0 - q;
+            const double half = remaining / 2.0;
+            q += std::max(half / ticks_per_half, 1e-9);
+        }
+        os << "#[Mean    = " << mean() / scale
+           << ", Max = " << static_cast<double>(m_max) / scale
+           << ", Total count = " << m_total << "]\n";
+    }
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t              m_total = 0;
+    uint64_t              m_min = std::numeric_limits<uint64_t>::max();
+    uint64_t              m_max = 0;
+    double                m_sum = 0.0;
+
+    static size_t index(uint64_t value) {
+        if (value < kSubCount) {
+            return static_cast<size_t>(value);
+        }
+        const int shift = 63 - __builtin_clzll(value) - kSubBits;
+        const uint64_t sub = (value >> shift) - kSubCount;
+        return static_cast<size_t>(shift + 1) * kSubCount +
+               static_cast<size_t>(sub);
+    }
+
+    static uint64_t highestEquivalent(size_t idx) {
+        if (idx < kSubCount) {
+            return idx;
+        }
+        const size_t   shift = idx / kSubCount - 1;
+        const uint64_t sub = idx % kSubCount;
+        return ((sub + kSubCount) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+};
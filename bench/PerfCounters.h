@@ -0,0 +1,264 @@
+#pragma once
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// perf_event_open硬件计数器: 周期, 指令, 分支预测失败, L1d/LLC/dTLB
+// 读缺失, 只计用户态. 每个事件单独打开, 某个事件不支持(虚拟机,
+// perf_event_paranoid太高)时只有它读成n/a. 计数器不够用时内核会
+// 分时复用, 读数按time_enabled/time_running放大.
+
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1dMisses,
+    LlcMisses,
+    DtlbMisses,
+};
+constexpr size_t kPerfEventCount = 6;
+
+struct PerfSample {
+    std::array<uint64_t, kPerfEventCount> values{};
+    std::array<bool, kPerfEventCount>     valid{};
+
+    uint64_t operator[](PerfEvent event) const {
+        return values[static_cast<size_t>(event)];
+    }
+    bool has(PerfEvent event) const {
+        return valid[static_cast<size_t>(event)];
+    }
+
+    PerfSample& operator+=(const PerfSample& other) {
+        for (size_t i = 0; i < kPerfEventCount; ++i) {
+            values[i] += other.values[i];
+            valid[i] = valid[i] || other.valid[i];
+        }
+        return *this;
+    }
+};
+
+namespace perf_detail {
+
+inline perf_event_attr eventAttr(PerfEvent event) {
+    //硬件cache事件的config: cache | (op << 8) | (result << 16)
+    auto cacheMiss = [](uint64_t cache) {
+        return cache | (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) |
+               (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+    };
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (event) {
+    case PerfEvent::Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PerfEvent::Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PerfEvent::BranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    case PerfEvent::L1dMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+        break;
+    case PerfEvent::LlcMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+        break;
+    case PerfEvent::DtlbMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+    }
+    return attr;
+}
+
+}  // namespace perf_detail
+
+// 一个线程(或者inherit时连同之后创建的所有子线程)上的一组计数器
+class PerfCounters {
+private:
+    std::array<int, kPerfEventCount> m_fds;
+
+public:
+    // tid为0表示调用线程. inherit为true时之后创建的线程也计入,
+    // 用来统计整个进程
+    explicit PerfCounters(pid_t tid = 0, bool inherit = false) {
+        for (size_t i = 0; i < kPerfEventCount; ++i) {
+            perf_event_attr attr =
+                perf_detail::eventAttr(static_cast<PerfEvent>(i));
+            attr.inherit = inherit ? 1 : 0;
+            m_fds[i] = static_cast<int>(
+                syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+        }
+    }
+    ~PerfCounters() {
+        for (const int fd : m_fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    PerfCounters(PerfCounters&& other) noexcept : m_fds(other.m_fds) {
+        other.m_fds.fill(-1);
+    }
+    PerfCounters& operator=(PerfCounters&&) = delete;
+
+    //至少有一个事件能计数
+    bool available() const {
+        for (const int fd : m_fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+        for (const int fd : m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    PerfSample stop() {
+        PerfSample sample;
+        for (size_t i = 0; i < kPerfEventCount; ++i) {
+            if (m_fds[i] < 0) {
+                continue;
+            }
+            ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t data[3];  // value, time_enabled, time_running
+            if (read(m_fds[i], data, sizeof(data)) != sizeof(data)) {
+                continue;
+            }
+            sample.valid[i] = true;
+            if (data[2] && data[2] < data[1]) {
+                sample.values[i] = static_cast<uint64_t>(
+                    static_cast<double>(data[0]) *
+                    static_cast<double>(data[1]) /
+                    static_cast<double>(data[2]));
+            } else {
+                sample.values[i] = data[0];
+            }
+        }
+        return sample;
+    }
+};
+
+// 进程里现有的每个线程(/proc/self/task)各一组计数器. 只列一次,
+// 之后新起的线程不计: 线程池要在这之前建好, 而且要固定线程数,
+// 自适应的池空闲时会退掉工作线程, 之后再新起.
+// include_self为false时跳过调用线程, 和它上面inherit的计数器搭配
+class ThreadCounters {
+private:
+    std::vector<std::pair<pid_t, PerfCounters>> m_threads;
+
+public:
+    explicit ThreadCounters(bool include_self = true) {
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) {
+            return;
+        }
+        const auto self = static_cast<pid_t>(syscall(SYS_gettid));
+        while (const dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            const auto tid = static_cast<pid_t>(std::atoi(entry->d_name));
+            if (!include_self && tid == self) {
+                continue;
+            }
+            PerfCounters counters(tid);
+            if (counters.available()) {
+                m_threads.emplace_back(tid, std::move(counters));
+            }
+        }
+        closedir(dir);
+    }
+
+    bool available() const {
+        return !m_threads.empty();
+    }
+
+    void start() {
+        for (auto& [tid, counters] : m_threads) {
+            counters.start();
+        }
+    }
+
+    //每个线程的读数, 按线程id
+    std::vector<std::pair<pid_t, PerfSample>> stop() {
+        std::vector<std::pair<pid_t, PerfSample>> samples;
+        for (auto& [tid, counters] : m_threads) {
+            samples.emplace_back(tid, counters.stop());
+        }
+        return samples;
+    }
+};
+
+// 一行派生指标: IPC, 每字节周期, 每千条指令分支预测失败,
+// 每面(faces为0时每KB)的L1d/LLC/dTLB缺失. 拿不到的项输出n/a
+inline void printPerf(std::ostream& out, const PerfSample& sample,
+                      uint64_t bytes, uint64_t faces) {
+    auto ratio = [&](bool ok, uint64_t num, double den) {
+        if (ok && den > 0) {
+            out << static_cast<double>(num) / den;
+        } else {
+            out << "n/a";
+        }
+    };
+    const bool   per_face = faces != 0;
+    const double unit = per_face ? static_cast<double>(faces)
+                                 : static_cast<double>(bytes) / 1024.0;
+    const double cycles = static_cast<double>(sample[PerfEvent::Cycles]);
+    const double kilo_instructions =
+        static_cast<double>(sample[PerfEvent::Instructions]) / 1000.0;
+
+    out << "IPC ";
+    ratio(sample.has(PerfEvent::Cycles) &&
+              sample.has(PerfEvent::Instructions),
+          sample[PerfEvent::Instructions], cycles);
+    out << "  cycles/B ";
+    ratio(sample.has(PerfEvent::Cycles), sample[PerfEvent::Cycles],
+          static_cast<double>(bytes));
+    out << "  br-miss/KI ";
+    ratio(sample.has(PerfEvent::BranchMisses) &&
+              sample.has(PerfEvent::Instructions),
+          sample[PerfEvent::BranchMisses], kilo_instructions);
+    const char* per = per_face ? "/face " : "/KB ";
+    out << "  L1d" << per;
+    ratio(sample.has(PerfEvent::L1dMisses), sample[PerfEvent::L1dMisses],
+          unit);
+    out << "  LLC" << per;
+    ratio(sample.has(PerfEvent::LlcMisses), sample[PerfEvent::LlcMisses],
+          unit);
+    out << "  dTLB" << per;
+    ratio(sample.has(PerfEvent::DtlbMisses), sample[PerfEvent::DtlbMisses],
+          unit);
+    out << "\n";
+}
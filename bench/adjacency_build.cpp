@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MeshAdjacency.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 边邻接的建法对比: 每个shape一个std::map<(v0, v1), 半边列表>(原来的
+// 写法)和buildEdgeAdjacency(基数排序). 两者的结果逐条比对,
+// 不一致时返回1.
+//
+// obj_adjacencybench file.obj [repeat]
+
+using Clock = std::chrono::steady_clock;
+
+//重复repeat次取最快的一次, 返回毫秒
+double measureMs(int repeat, const std::function<void()>& body) {
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        const auto begin = Clock::now();
+        body();
+        const double ms = std::chrono::duration<double, std::milli>(
+                              Clock::now() - begin)
+                              .count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+//同样的规则用std::map实现, 只填twin
+void mapAdjacency(const tinyobj::mesh_t& mesh, size_t num_vertices,
+                  std::vector<uint32_t>& twin) {
+    using Edge = std::pair<tinyobj::index_int_t, tinyobj::index_int_t>;
+    std::map<Edge, std::vector<uint32_t>> edges;
+    twin.assign(mesh.indices.size(), EdgeAdjacency::kNonManifold);
+    for (tinyobj::face_cursor_t c(mesh); !c.done(); c.next()) {
+        const size_t begin = c.index_offset();
+        const size_t end = begin + c.num_vertices();
+        for (size_t h = begin; h < end; ++h) {
+            const auto v0 = mesh.indices[h].vertex_index;
+            const auto v1 =
+                mesh.indices[h + 1 == end ? begin : h + 1].vertex_index;
+            if (v0 == v1 || v0 < 0 || v1 < 0 ||
+                size_t(v0) >= num_vertices || size_t(v1) >= num_vertices) {
+                continue;
+            }
+            edges[{std::min(v0, v1), std::max(v0, v1)}].push_back(
+                static_cast<uint32_t>(h));
+        }
+    }
+    for (const auto& [edge, half_edges] : edges) {
+        if (half_edges.size() == 1) {
+            twin[half_edges[0]] = EdgeAdjacency::kBoundary;
+        } else if (half_edges.size() == 2 &&
+                   mesh.indices[half_edges[0]].vertex_index !=
+                       mesh.indices[half_edges[1]].vertex_index) {
+            twin[half_edges[0]] = half_edges[1];
+            twin[half_edges[1]] = half_edges[0];
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_adjacencybench file.obj [repeat]\n";
+        return 1;
+    }
+    const int repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 5;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(argv[1])) {
+        std::cerr << "failed to load " << argv[1] << "\n";
+        return 1;
+    }
+    ThreadPool   pool;
+    const auto&  shapes = reader.GetShapes();
+    const size_t num_vertices = reader.GetAttrib().vertices.size() / 3;
+    size_t       half_edges = 0;
+    for (const auto& shape : shapes) {
+        half_edges += shape.mesh.indices.size();
+    }
+    std::cout << argv[1] << ": " << shapes.size() << " shapes, "
+              << half_edges << " half-edges, "
+              << pool.get_max_thread_count() << " threads, best of "
+              << repeat << "\n";
+
+    std::vector<std::vector<uint32_t>> expected(shapes.size());
+    const double map_ms = measureMs(repeat, [&] {
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            mapAdjacency(shapes[i].mesh, num_vertices, expected[i]);
+        }
+    });
+    std::vector<EdgeAdjacency> adjacency;
+    const double               sort_ms = measureMs(
+        repeat, [&] { adjacency = buildEdgeAdjacency(reader, pool); });
+
+    size_t edges = 0;
+    size_t boundary = 0;
+    size_t non_manifold = 0;
+    size_t mismatched = 0;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        edges += adjacency[i].num_edges;
+        boundary += adjacency[i].boundary_edges;
+        non_manifold += adjacency[i].non_manifold_edges;
+        mismatched += adjacency[i].twin != expected[i];
+    }
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(3);
+    std::cout << "std::map     " << map_ms << " ms\n"
+              << "radix sort   " << sort_ms << " ms\n"
+              << edges << " edges, " << boundary << " boundary, "
+              << non_manifold << " non-manifold\n";
+    if (mismatched) {
+        std::cerr << mismatched << " shapes differ from std::map\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "MeshBvh.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// BVH建树: 单线程的池和默认线程池各建一次, 两次的结果必须逐字节相同;
+// 检查每个面恰好在一个叶子里, 包围盒层层包含; 再测写出和读回的耗时.
+// 有不一致时返回1.
+//
+// obj_bvhbench file.obj [repeat]
+
+using Clock = std::chrono::steady_clock;
+
+//重复repeat次取最快的一次, 返回毫秒
+double measureMs(int repeat, const std::function<void()>& body) {
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        const auto begin = Clock::now();
+        body();
+        const double ms = std::chrono::duration<double, std::milli>(
+                              Clock::now() - begin)
+                              .count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+bool sameBvh(const Bvh& a, const Bvh& b) {
+    return a.prims == b.prims && a.nodes.size() == b.nodes.size() &&
+           (a.nodes.empty() ||
+            std::memcmp(a.nodes.data(), b.nodes.data(),
+                        a.nodes.size() * sizeof(BvhNode)) == 0);
+}
+
+bool sameScene(const SceneBvh& a, const SceneBvh& b) {
+    if (a.shapes.size() != b.shapes.size() || !sameBvh(a.top, b.top)) {
+        return false;
+    }
+    for (size_t i = 0; i < a.shapes.size(); ++i) {
+        if (!sameBvh(a.shapes[i], b.shapes[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool contains(const BvhNode& outer, const tinyobj::real_t* p) {
+    for (int a = 0; a < 3; ++a) {
+        if (p[a] < outer.min[a] || p[a] > outer.max[a]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//每个合法的面恰好出现一次, 叶子的包围盒包住面的顶点, 内部节点包住孩子.
+//非有限的坐标不检查
+bool checkBvh(const Bvh& bvh, const tinyobj::mesh_t& mesh,
+              const tinyobj::attrib_t& attrib) {
+    struct Face {
+        size_t   offset{0};
+        unsigned count{0};
+        bool     valid{false};
+        int      seen{0};
+    };
+    const size_t      num_vertices = tinyobj::NumVertices(attrib);
+    std::vector<Face> faces(tinyobj::NumFaces(mesh));
+    for (tinyobj::face_cursor_t c(mesh); !c.done(); c.next()) {
+        if (c.index_offset() + c.num_vertices() > mesh.indices.size()) {
+            break;
+        }
+        Face& face = faces[c.face()];
+        face.offset = c.index_offset();
+        face.count = c.num_vertices();
+        face.valid = face.count > 0;
+        for (size_t k = 0; k < face.count; ++k) {
+            const auto v = mesh.indices[face.offset + k].vertex_index;
+            face.valid = face.valid && v >= 0 && size_t(v) < num_vertices;
+        }
+    }
+    auto finite = [](const tinyobj::real_t* p) {
+        return std::isfinite(p[0]) && std::isfinite(p[1]) &&
+               std::isfinite(p[2]);
+    };
+    for (const BvhNode& node : bvh.nodes) {
+        if (!node.leaf()) {
+            for (const uint32_t c : {node.first, node.first + 1}) {
+                const BvhNode& child = bvh.nodes[c];
+                if ((finite(child.min) && !contains(node, child.min)) ||
+                    (finite(child.max) && !contains(node, child.max))) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            Face& face = faces[bvh.prims[i]];
+            ++face.seen;
+            for (size_t k = 0; k < face.count; ++k) {
+                tinyobj::real_t p[3];
+                tinyobj::GetVertex(
+                    attrib, mesh.indices[face.offset + k].vertex_index, p);
+                if (finite(p) && !contains(node, p)) {
+                    return false;
+                }
+            }
+        }
+    }
+    for (const Face& face : faces) {
+        if (face.seen != (face.valid ? 1 : 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_bvhbench file.obj [repeat]\n";
+        return 1;
+    }
+    const int repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 5;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(argv[1])) {
+        std::cerr << "failed to load " << argv[1] << "\n";
+        return 1;
+    }
+    ThreadPool  single(1);
+    ThreadPool  pool;
+    const auto& shapes = reader.GetShapes();
+    size_t      faces = 0;
+    for (const auto& shape : shapes) {
+        faces += tinyobj::NumFaces(shape.mesh);
+    }
+    std::cout << argv[1] << ": " << shapes.size() << " shapes, " << faces
+              << " faces, " << pool.get_max_thread_count()
+              << " threads, best of " << repeat << "\n";
+
+    SceneBvh     serial;
+    SceneBvh     parallel;
+    const double serial_ms = measureMs(
+        repeat, [&] { serial = buildSceneBvh(reader, single); });
+    const double parallel_ms = measureMs(
+        repeat, [&] { parallel = buildSceneBvh(reader, pool); });
+
+    size_t     nodes = parallel.top.nodes.size();
+    bool       ok = sameScene(serial, parallel);
+    const Bvh* largest = nullptr;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        const Bvh& bvh = parallel.shapes[i];
+        nodes += bvh.nodes.size();
+        ok = ok && checkBvh(bvh, shapes[i].mesh, reader.GetAttrib());
+        if (!largest || bvh.prims.size() > largest->prims.size()) {
+            largest = &bvh;
+        }
+    }
+
+    std::string  saved;
+    SceneBvh     loaded;
+    bool         save_ok = true;
+    bool         load_ok = true;
+    const double save_ms = measureMs(repeat, [&] {
+        std::ostringstream out;
+        save_ok = saveSceneBvh(out, parallel, shapes, reader.GetAttrib());
+        saved = out.str();
+    });
+    const double load_ms = measureMs(repeat, [&] {
+        std::istringstream in(saved);
+        load_ok = loadSceneBvh(in, loaded, shapes, reader.GetAttrib());
+    });
+    ok = ok && save_ok && load_ok && sameScene(parallel, loaded);
+
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(3);
+    std::cout << "build, 1 thread   " << serial_ms << " ms\n"
+              << "build, pool       " << parallel_ms << " ms\n"
+              << "save              " << save_ms << " ms, "
+              << saved.size() << " bytes\n"
+              << "load              " << load_ms << " ms\n"
+              << nodes << " nodes, SAH cost of the largest shape "
+              << (largest ? sahCost(*largest) : 0.0) << "\n";
+    if (!ok) {
+        std::cerr << "BVH check failed\n";
+        return 1;
+    }
+    return 0;
+}
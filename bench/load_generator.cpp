@@ -0,0 +1,382 @@
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "ObjLoaders.h"
+#include "PerfCounters.h"
+#include "Reclaimer.h"
+
+// 压测工具: N个客户端并发调用解析接口, 记录延迟分布/吞吐/CPU占用,
+// 用来比较模式1/2/3(以及之后的新策略)在竞争下的表现.
+//
+// obj_loadgen --mode 3 --clients 8 --rate 20 --arrival poisson
+//             --duration 30 --file a.obj:3 --file b.obj:1
+
+using Clock = std::chrono::steady_clock;
+
+enum class Arrival {
+    Closed,   //上一个请求完成后立刻(或think_ms之后)发下一个
+    Uniform,  //按固定间隔发, 总速率为rate
+    Poisson,  //指数分布间隔, 总速率为rate
+};
+
+struct FileSpec {
+    std::string path;
+    double      weight{1.0};
+    off_t       size{0};
+};
+
+struct Options {
+    std::string           mode{"1"};
+    size_t                clients{1};
+    double                rate{0.0};  //所有客户端合计的请求/秒
+    Arrival               arrival{Arrival::Closed};
+    double                think_ms{0.0};
+    double                duration{10.0};
+    size_t                requests{0};  //非0时按请求数结束
+    size_t                batch{1};     //每个请求解析的文件数
+    uint64_t              seed{1};
+    std::vector<FileSpec> mix;
+    std::string           hgrm;  //输出百分位分布文件
+    bool                  deferred_free{false};  //结果交给后台线程析构
+    bool                  perf{false};  //读硬件计数器
+};
+
+struct ClientStats {
+    LatencyHistogram response;  //从计划发出时刻算, 含排队
+    LatencyHistogram service;   //从实际发出时刻算
+    uint64_t         requests{0};
+    uint64_t         bytes{0};
+    uint64_t         failures{0};
+    PerfSample       perf;  //客户端线程自己的计数, 不含线程池
+};
+
+void usage() {
+    std::cout
+        << "usage: obj_loadgen [options] --file path[:weight] ...\n"
+           "  --mode 1|2|3|4|5|6   loader strategy (see main.cpp)\n"
+           "  --clients N          concurrent clients (default 1)\n"
+           "  --arrival closed|uniform|poisson\n"
+           "  --rate R             total requests/s for uniform/poisson\n"
+           "  --think-ms T         closed loop think time\n"
+           "  --duration S         run time in seconds (default 10)\n"
+           "  --requests N         stop after N requests instead\n"
+           "  --batch K            files per request (default 1)\n"
+           "  --seed S             file mix / arrival seed\n"
+           "  --hgrm PATH          write response time percentiles (ms)\n"
+           "  --free inline|deferred\n"
+           "                       destroy results on the request thread\n"
+           "                       or on a background thread\n"
+           "  --perf on|off        hardware counters (all threads and\n"
+           "                       each client thread)\n";
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--mode") {
+            options.mode = value;
+        } else if (arg == "--clients") {
+            options.clients = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--rate") {
+            options.rate = std::stod(value);
+        } else if (arg == "--arrival") {
+            if (value == "closed") {
+                options.arrival = Arrival::Closed;
+            } else if (value == "uniform") {
+                options.arrival = Arrival::Uniform;
+            } else if (value == "poisson") {
+                options.arrival = Arrival::Poisson;
+            } else {
+                return false;
+            }
+        } else if (arg == "--think-ms") {
+            options.think_ms = std::stod(value);
+        } else if (arg == "--duration") {
+            options.duration = std::stod(value);
+        } else if (arg == "--requests") {
+            options.requests = std::stoul(value);
+        } else if (arg == "--batch") {
+            options.batch = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (arg == "--hgrm") {
+            options.hgrm = value;
+        } else if (arg == "--free") {
+            if (value == "inline") {
+                options.deferred_free = false;
+            } else if (value == "deferred") {
+                options.deferred_free = true;
+            } else {
+                return false;
+            }
+        } else if (arg == "--perf") {
+            if (value == "on") {
+                options.perf = true;
+            } else if (value == "off") {
+                options.perf = false;
+            } else {
+                return false;
+            }
+        } else if (arg == "--file") {
+            //最后一个':'后面全是数字才算权重, 路径本身可以带':'
+            FileSpec     spec;
+            const size_t colon = value.rfind(':');
+            const auto   weight = colon == std::string::npos
+                                      ? std::string()
+                                      : value.substr(colon + 1);
+            const bool   numeric =
+                weight.find_first_of("0123456789") != std::string::npos &&
+                weight.find_first_not_of("0123456789.") ==
+                    std::string::npos &&
+                std::count(weight.begin(), weight.end(), '.') <= 1;
+            spec.path = numeric ? value.substr(0, colon) : value;
+            if (numeric) {
+                spec.weight = std::stod(weight);
+            }
+            options.mix.push_back(spec);
+        } else {
+            return false;
+        }
+    }
+    if (options.arrival != Arrival::Closed && options.rate <= 0.0) {
+        std::cerr << "--rate is required for open arrival processes\n";
+        return false;
+    }
+    return !options.mix.empty();
+}
+
+//请求结束时释放结果: 默认就地析构(算在请求延迟里), deferred时交给后台
+template <class T>
+void release(const Options& options, std::vector<T>&& results) {
+    if (options.deferred_free) {
+        Reclaimer::global().retire(std::move(results));
+    }
+}
+
+//执行一次请求, 返回读取的字节数
+uint64_t runRequest(const Options&             options,
+                    const std::vector<size_t>& picks) {
+    std::vector<ReadOnlyFile> files;
+    files.reserve(picks.size());
+    uint64_t bytes = 0;
+    for (size_t pick : picks) {
+        files.emplace_back(options.mix[pick].path);
+        bytes += static_cast<uint64_t>(files.back().size());
+    }
+    if (options.mode == "1") {
+        release(options, trivialApproach(files));
+    } else if (options.mode == "2") {
+        release(options, iouringObjLoader(files));
+    } else if (options.mode == "3") {
+        release(options, parseOBJFiles(files));
+    } else if (options.mode == "4") {
+        release(options, pointCloudLoader(files, PointCloudOptions{}));
+    } else if (options.mode == "5") {
+        release(options, progressiveLoader(files));
+    } else if (options.mode == "6") {
+        release(options, autoLoader(files));
+    } else {
+        throw std::runtime_error("unknown mode " + options.mode);
+    }
+    return bytes;
+}
+
+void client(const Options& options, size_t id, Clock::time_point start,
+            std::atomic<uint64_t>& issued, ClientStats& stats) {
+    std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15 + id);
+    std::vector<double> weights;
+    for (const auto& spec : options.mix) {
+        weights.push_back(spec.weight);
+    }
+    std::discrete_distribution<size_t> pick_file(weights.begin(),
+                                                 weights.end());
+    //每个客户端分到rate / clients
+    const double per_client_rate =
+        options.rate / static_cast<double>(options.clients);
+    std::exponential_distribution<double> poisson_gap(
+        per_client_rate > 0 ? per_client_rate : 1.0);
+
+    const auto deadline =
+        start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(options.duration));
+    //错开各客户端的第一个请求
+    Clock::time_point intended = start;
+    if (options.arrival == Arrival::Uniform) {
+        intended += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(id) /
+                                          options.rate));
+    } else if (options.arrival == Arrival::Poisson) {
+        intended += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(poisson_gap(rng)));
+    }
+
+    std::optional<PerfCounters> counters;
+    if (options.perf) {
+        counters.emplace();
+        counters->start();
+    }
+    std::vector<size_t> picks(options.batch);
+    while (true) {
+        if (options.requests) {
+            if (issued.fetch_add(1) >= options.requests) {
+                break;
+            }
+        } else if (intended >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_until(intended);
+        for (auto& pick : picks) {
+            pick = pick_file(rng);
+        }
+        const auto begin = Clock::now();
+        try {
+            stats.bytes += runRequest(options, picks);
+        } catch (const std::exception&) {
+            ++stats.failures;
+        }
+        const auto end = Clock::now();
+        ++stats.requests;
+        stats.service.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                .count()));
+        //开环时从计划时刻算起, 避免协调遗漏(coordinated omission)
+        stats.response.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                end - std::min(intended, begin))
+                .count()));
+
+        switch (options.arrival) {
+        case Arrival::Closed:
+            intended = end + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double, std::milli>(
+                                     options.think_ms));
+            break;
+        case Arrival::Uniform:
+            intended += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / per_client_rate));
+            break;
+        case Arrival::Poisson:
+            intended += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(poisson_gap(rng)));
+            break;
+        }
+    }
+    if (counters) {
+        stats.perf = counters->stop();
+    }
+}
+
+double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const auto seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec;
+    const auto micros = usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    return static_cast<double>(seconds) + static_cast<double>(micros) / 1e6;
+}
+
+void printLatency(const char* name, const LatencyHistogram& hist) {
+    auto ms = [](uint64_t ns) { return static_cast<double>(ns) / 1e6; };
+    std::cout << name << " (ms): min " << ms(hist.min()) << "  mean "
+              << hist.mean() / 1e6 << "  p50 " << ms(hist.percentile(50))
+              << "  p90 " << ms(hist.percentile(90)) << "  p99 "
+              << ms(hist.percentile(99)) << "  p99.9 "
+              << ms(hist.percentile(99.9)) << "  max " << ms(hist.max())
+              << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    for (auto& spec : options.mix) {
+        spec.size = ReadOnlyFile(spec.path).size();
+    }
+
+    // inherit: 之后创建的客户端和线程池都算进来. 子线程的计数要等它
+    //退出才并进来, 客户端和每个请求的线程池都在stop之前退出; 一直
+    //活着的回收线程先建好, 单独挂一组计数器
+    std::optional<PerfCounters>   process;
+    std::optional<ThreadCounters> resident;
+    if (options.perf) {
+        Reclaimer::global();
+        resident.emplace(false);
+        process.emplace(0, true);
+        resident->start();
+        process->start();
+    }
+    std::vector<ClientStats> stats(options.clients);
+    std::vector<std::thread> clients;
+    std::atomic<uint64_t>    issued{0};
+    const double             cpu_begin = cpuSeconds();
+    const auto               start = Clock::now();
+    for (size_t i = 0; i < options.clients; ++i) {
+        clients.emplace_back(client, std::cref(options), i, start,
+                             std::ref(issued), std::ref(stats[i]));
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    //后台析构的CPU也算进来
+    Reclaimer::global().drain();
+    const double wall =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    const double cpu = cpuSeconds() - cpu_begin;
+    PerfSample process_perf;
+    if (process) {
+        process_perf = process->stop();
+        for (const auto& [tid, sample] : resident->stop()) {
+            process_perf += sample;
+        }
+    }
+
+    ClientStats total;
+    for (const auto& s : stats) {
+        total.response.merge(s.response);
+        total.service.merge(s.service);
+        total.requests += s.requests;
+        total.bytes += s.bytes;
+        total.failures += s.failures;
+    }
+
+    const unsigned cores =
+        std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "mode " << options.mode << ", " << options.clients
+              << " clients, " << total.requests << " requests ("
+              << total.failures << " failed) in " << wall << " s\n";
+    std::cout << "throughput: " << total.requests / wall << " req/s, "
+              << static_cast<double>(total.bytes) / wall / (1 << 20)
+              << " MiB/s\n";
+    std::cout << "cpu: " << cpu << " s, " << cpu / wall << " cores busy ("
+              << 100.0 * cpu / wall / cores << "% of " << cores << ")\n";
+    printLatency("response", total.response);
+    printLatency("service ", total.service);
+    if (options.perf) {
+        std::cout << "perf, all threads: ";
+        printPerf(std::cout, process_perf, total.bytes, 0);
+        for (size_t i = 0; i < stats.size(); ++i) {
+            std::cout << "perf, client " << i << ": ";
+            printPerf(std::cout, stats[i].perf, stats[i].bytes, 0);
+        }
+    }
+
+    if (!options.hgrm.empty()) {
+        std::ofstream out(options.hgrm);
+        total.response.outputPercentiles(out, 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "MeshLod.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// LOD链: 单线程的池和默认线程池各做一次, 结果必须相同; 每一级的下标都
+//来自原来的mesh, 没有退化的三角形, 三角形数逐级不增. 有不一致时返回1.
+//
+// obj_lodbench file.obj [repeat]
+
+using Clock = std::chrono::steady_clock;
+
+//重复repeat次取最快的一次, 返回毫秒
+double measureMs(int repeat, const std::function<void()>& body) {
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        const auto begin = Clock::now();
+        body();
+        const double ms = std::chrono::duration<double, std::milli>(
+                              Clock::now() - begin)
+                              .count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+auto key(const tinyobj::index_t& i) {
+    return std::make_tuple(i.vertex_index, i.normal_index,
+                           i.texcoord_index);
+}
+
+bool sameLevels(const std::vector<LodLevel>& a,
+                const std::vector<LodLevel>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (a[k].error != b[k].error ||
+            a[k].material_ids != b[k].material_ids ||
+            a[k].indices.size() != b[k].indices.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a[k].indices.size(); ++i) {
+            if (key(a[k].indices[i]) != key(b[k].indices[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkLevels(const std::vector<LodLevel>& levels,
+                 const tinyobj::mesh_t&       mesh) {
+    std::vector<decltype(key(tinyobj::index_t()))> corners;
+    for (const tinyobj::index_t& i : mesh.indices) {
+        corners.push_back(key(i));
+    }
+    std::sort(corners.begin(), corners.end());
+    size_t previous = std::numeric_limits<size_t>::max();
+    for (const LodLevel& level : levels) {
+        if (level.indices.size() != level.material_ids.size() * 3 ||
+            level.indices.size() > previous) {
+            return false;
+        }
+        previous = level.indices.size();
+        for (size_t t = 0; t < level.indices.size(); t += 3) {
+            const auto* v = &level.indices[t];
+            if (v[0].vertex_index == v[1].vertex_index ||
+                v[0].vertex_index == v[2].vertex_index ||
+                v[1].vertex_index == v[2].vertex_index) {
+                return false;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (!std::binary_search(corners.begin(), corners.end(),
+                                        key(v[k]))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_lodbench file.obj [repeat]\n";
+        return 1;
+    }
+    const int repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 3;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(argv[1])) {
+        std::cerr << "failed to load " << argv[1] << "\n";
+        return 1;
+    }
+    ThreadPool  single(1);
+    ThreadPool  pool;
+    const auto& shapes = reader.GetShapes();
+    size_t      faces = 0;
+    for (const auto& shape : shapes) {
+        faces += tinyobj::NumFaces(shape.mesh);
+    }
+    std::cout << argv[1] << ": " << shapes.size() << " shapes, " << faces
+              << " faces, " << pool.get_max_thread_count()
+              << " threads, best of " << repeat << "\n";
+
+    LodOptions                         options;
+    std::vector<std::vector<LodLevel>> serial;
+    std::vector<std::vector<LodLevel>> parallel;
+    const double                       serial_ms = measureMs(repeat, [&] {
+        serial = buildLodChains(reader, single, options);
+    });
+    const double parallel_ms = measureMs(repeat, [&] {
+        parallel = buildLodChains(reader, pool, options);
+    });
+
+    bool ok = serial.size() == parallel.size();
+    for (size_t i = 0; ok && i < shapes.size(); ++i) {
+        ok = sameLevels(serial[i], parallel[i]) &&
+             checkLevels(parallel[i], shapes[i].mesh);
+    }
+
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(3);
+    std::cout << "build, 1 thread   " << serial_ms << " ms\n"
+              << "build, pool       " << parallel_ms << " ms\n";
+    for (size_t k = 0; ok && k < options.ratios.size(); ++k) {
+        size_t triangles = 0;
+        double error = 0.0;
+        for (const auto& levels : parallel) {
+            if (k < levels.size()) {
+                triangles += levels[k].material_ids.size();
+                error = std::max(error, levels[k].error);
+            }
+        }
+        std::cout << "ratio " << options.ratios[k] << ": " << triangles
+                  << " triangles, max error " << error << "\n";
+    }
+    if (!ok) {
+        std::cerr << "LOD check failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "LazyAttributes.h"
+#include "ObjPipeline.h"
+#include "PerfCounters.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 解析吞吐测试: 分别测istream逐行解析, stage 1(结构索引),
+// stage 1 + 2顺序执行(以及解析时做坐标变换, 输出SoA, 延迟解码数字),
+// 线程池流水线, 输出GB/s和每周期字节数. 能用perf_event_open时再输出一行硬件计数器的
+// 派生指标(IPC, 每字节周期, 每面缓存缺失), 多线程的项按线程分开列出.
+// 计时之前先核对材质(checkMaterials), 对不上时返回1.
+//
+// obj_parsebench cactus.obj [repeat]
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+    double   seconds{0.0};
+    uint64_t cycles{0};  // TSC参考周期, 不是x86时为0
+    //每个线程的硬件计数器读数, 计数器不可用时为空
+    std::vector<std::pair<pid_t, PerfSample>> threads;
+};
+
+inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+//重复repeat次取最快的一次
+Sample measure(int repeat, ThreadCounters& counters,
+               const std::function<void()>& body) {
+    Sample best;
+    for (int i = 0; i < repeat; ++i) {
+        counters.start();
+        const auto     begin = Clock::now();
+        const uint64_t c0 = readCycles();
+        body();
+        const uint64_t c1 = readCycles();
+        const double   seconds =
+            std::chrono::duration<double>(Clock::now() - begin).count();
+        auto threads = counters.stop();
+        if (i == 0 || seconds < best.seconds) {
+            best = {seconds, c1 - c0, std::move(threads)};
+        }
+    }
+    return best;
+}
+
+// usemtl用到的材质, 只要在mtllib引用的某个.mtl里有定义, 就必须被加载;
+// 按文件和按缓冲区(mtl_search_path)解析得到的每面材质必须相同.
+// 回归输入: bench/data/mtllib_repeat.obj
+bool checkMaterials(const std::string& path, const std::string& text) {
+    const size_t          slash = path.find_last_of("/\\");
+    const std::string     dir =
+        slash == std::string::npos ? "." : path.substr(0, slash);
+    std::set<std::string> defined;
+    std::set<std::string> used;
+    std::istringstream    lines(text);
+    std::string           line;
+    while (std::getline(lines, line)) {
+        std::istringstream words(line);
+        std::string        key;
+        std::string        word;
+        words >> key;
+        if (key == "usemtl" && words >> word) {
+            used.insert(word);
+        }
+        while (key == "mtllib" && words >> word) {
+            std::ifstream mtl(dir + "/" + word);
+            if (!mtl) {
+                continue;  //打不开的.mtl解析时也加载不了
+            }
+            std::map<std::string, int>       names;
+            std::vector<tinyobj::material_t> materials;
+            std::string                      warn;
+            std::string                      err;
+            tinyobj::LoadMtl(&names, &materials, &mtl, &warn, &err);
+            for (const auto& material : materials) {
+                defined.insert(material.name);
+            }
+        }
+    }
+
+    tinyobj::ObjReader from_file;
+    from_file.ParseFromFile(path);
+    tinyobj::ObjReaderConfig config;
+    config.mtl_search_path = dir;
+    tinyobj::ObjReader from_buffer;
+    from_buffer.ParseFromBuffer(text.data(), text.size(), "", config);
+
+    std::set<std::string> loaded;
+    for (const auto& material : from_file.GetMaterials()) {
+        loaded.insert(material.name);
+    }
+    bool ok = true;
+    for (const auto& name : used) {
+        if (defined.count(name) && !loaded.count(name)) {
+            std::cerr << "usemtl " << name << ": defined but not loaded\n";
+            ok = false;
+        }
+    }
+    const auto& a = from_file.GetShapes();
+    const auto& b = from_buffer.GetShapes();
+    bool        same = a.size() == b.size();
+    for (size_t i = 0; same && i < a.size(); ++i) {
+        same = a[i].mesh.material_ids == b[i].mesh.material_ids;
+    }
+    if (!same) {
+        std::cerr << "material ids differ between file and buffer parse\n";
+    }
+    return ok && same;
+}
+
+//合计一行, 有多个线程在干活时每个线程再各一行
+void reportPerf(const Sample& sample, size_t bytes, size_t faces) {
+    PerfSample total;
+    size_t     busy = 0;
+    for (const auto& [tid, perf] : sample.threads) {
+        total += perf;
+        busy += perf[PerfEvent::Instructions] ? 1 : 0;
+    }
+    std::cout << "    ";
+    printPerf(std::cout, total, bytes, faces);
+    if (busy < 2) {
+        return;
+    }
+    for (const auto& [tid, perf] : sample.threads) {
+        if (perf[PerfEvent::Instructions]) {
+            std::cout << "      tid " << tid << ": ";
+            printPerf(std::cout, perf, bytes, faces);
+        }
+    }
+}
+
+void report(const char* name, size_t bytes, size_t faces,
+            const Sample& sample) {
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(3);
+    std::cout.width(22);
+    std::cout << std::left << name << std::right;
+    std::cout.width(10);
+    std::cout << sample.seconds * 1e3 << " ms";
+    std::cout.width(10);
+    std::cout << static_cast<double>(bytes) / sample.seconds / 1e9
+              << " GB/s";
+    if (sample.cycles) {
+        std::cout.width(10);
+        std::cout << static_cast<double>(bytes) /
+                         static_cast<double>(sample.cycles)
+                  << " B/cycle";
+    }
+    std::cout << "\n";
+    if (!sample.threads.empty()) {
+        reportPerf(sample, bytes, faces);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_parsebench file.obj [repeat]\n";
+        return 1;
+    }
+    const int repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 5;
+
+    std::ifstream     in(argv[1], std::ios::binary);
+    std::vector<char> buf((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+    const std::string text(buf.data(), buf.size());
+    const size_t      bytes = buf.size();
+    size_t            faces = 0;
+    {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "");
+        for (const auto& shape : reader.GetShapes()) {
+            faces += tinyobj::NumFaces(shape.mesh);
+        }
+    }
+    std::cout << argv[1] << ": " << bytes << " bytes, " << faces
+              << " faces, best of " << repeat << ", isa "
+              << tinyobj::GetParseKernels().isa << "\n";
+    if (!checkMaterials(argv[1], text)) {
+        std::cerr << "material check failed\n";
+        return 1;
+    }
+
+    //线程池先建好, 计数器才能覆盖到它的工作线程. 固定线程数:
+    //自适应的池空闲200ms就退掉工作线程, 再起的新线程不在计数器里
+    ThreadPool     pool(ThreadPool::available_concurrency());
+    ThreadCounters counters;
+    if (!counters.available()) {
+        std::cout << "perf_event_open unavailable, wall time only\n";
+    }
+    auto bench = [&](const char* name, const std::function<void()>& body) {
+        report(name, bytes, faces, measure(repeat, counters, body));
+    };
+
+    bench("istream LoadObj", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromString(text, "");
+    });
+
+    tinyobj::structural_index_t index;
+    size_t                      structurals = 0;
+    bench("stage 1 (index)", [&] {
+        structurals = 0;
+        size_t begin = 0;
+        while (begin < bytes) {
+            const size_t end = tinyobj::FindChunkEnd(
+                buf.data(), bytes, begin, kPipelineChunkSize);
+            tinyobj::BuildStructuralIndex(buf.data() + begin,
+                                          end - begin, &index);
+            structurals += index.size;
+            begin = end;
+        }
+    });
+
+    bench("stage 1 + 2", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "");
+    });
+
+    // cm转m, Y-up转Z-up, 解析时顺带做掉
+    tinyobj::ObjReaderConfig xform;
+    xform.use_transform = true;
+    // clang-format off
+    const tinyobj::real_t yup_to_zup[16] = {
+        0.01f, 0,      0,     0,  // 按列存放
+        0,     0,      0.01f, 0,
+        0,     -0.01f, 0,     0,
+        0,     0,      0,     1};
+    // clang-format on
+    std::copy(yup_to_zup, yup_to_zup + 16, xform.transform);
+    bench("stage 1 + 2 + xform", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "", xform);
+    });
+
+    // 顶点按SoA输出, 给SIMD的后处理用
+    tinyobj::ObjReaderConfig soa;
+    soa.soa_attributes = true;
+    bench("stage 1 + 2 + SoA", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "", soa);
+    });
+
+    // 只记下v/vn/vt行的位置, 第二项再把数字全部解码
+    tinyobj::ObjReaderConfig lazy;
+    lazy.lazy_attributes = true;
+    bench("stage 1 + 2 + lazy", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "", lazy);
+    });
+    bench("lazy + decodeAll", [&] {
+        tinyobj::ObjReader reader;
+        reader.ParseFromBuffer(buf.data(), bytes, "", lazy);
+        decodeAll(reader.GetAttrib(), pool);
+    });
+
+    bench("pipelined", [&] {
+        tinyobj::ObjReader reader;
+        parseObjPipelined(reader, buf.data(), bytes, "", pool);
+    });
+
+    std::cout << structurals << " structural characters ("
+              << 100.0 * static_cast<double>(structurals) /
+                     static_cast<double>(std::max<size_t>(bytes, 1))
+              << "%), " << pool.get_max_thread_count() << " threads\n";
+    return 0;
+}
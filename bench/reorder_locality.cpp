@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SpatialReorder.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+// 空间重排对下游pass局部性的影响: 按面累加顶点法线(典型的按下标
+// gather/scatter), 分别测文件原顺序, Morton和Hilbert重排之后,
+// 以及重排本身的耗时. 顺带输出相邻两次访问的顶点在内存里挨着的比例.
+//
+// obj_reorderbench cactus.obj [repeat]
+
+using Clock = std::chrono::steady_clock;
+
+//重复repeat次取最快的一次, 返回毫秒
+double measureMs(int repeat, const std::function<void()>& body) {
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        const auto begin = Clock::now();
+        body();
+        const double ms = std::chrono::duration<double, std::milli>(
+                              Clock::now() - begin)
+                              .count();
+        if (i == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+//按面扇形三角化, 面法线累加到顶点上
+void accumulateNormals(const tinyobj::attrib_t&             attrib,
+                       const std::vector<tinyobj::shape_t>& shapes,
+                       std::vector<tinyobj::real_t>&        normals) {
+    const auto& v = attrib.vertices;
+    normals.assign(v.size(), 0);
+    for (const auto& shape : shapes) {
+        const auto& mesh = shape.mesh;
+        size_t      offset = 0;
+        for (const unsigned char count : mesh.num_face_vertices) {
+            const auto i0 = mesh.indices[offset].vertex_index;
+            const tinyobj::real_t* p0 = &v[i0 * 3];
+            for (size_t k = 1; k + 1 < count; ++k) {
+                const auto i1 = mesh.indices[offset + k].vertex_index;
+                const auto i2 = mesh.indices[offset + k + 1].vertex_index;
+                const tinyobj::real_t* p1 = &v[i1 * 3];
+                const tinyobj::real_t* p2 = &v[i2 * 3];
+                tinyobj::real_t        e1[3], e2[3];
+                for (int c = 0; c < 3; ++c) {
+                    e1[c] = p1[c] - p0[c];
+                    e2[c] = p2[c] - p0[c];
+                }
+                const tinyobj::real_t n[3] = {
+                    e1[1] * e2[2] - e1[2] * e2[1],
+                    e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]};
+                for (const int i : {i0, i1, i2}) {
+                    for (int c = 0; c < 3; ++c) {
+                        normals[i * 3 + c] += n[c];
+                    }
+                }
+            }
+            offset += count;
+        }
+    }
+}
+
+//面顶点序列里相邻两次访问落在kNear个顶点(几条cache line)以内的比例
+double nearAccessRatio(const std::vector<tinyobj::shape_t>& shapes) {
+    constexpr int        kNear = 64;
+    size_t               near = 0;
+    size_t               count = 0;
+    tinyobj::index_int_t prev = -1;
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            if (prev >= 0) {
+                near += std::abs(index.vertex_index - prev) <= kNear;
+                ++count;
+            }
+            prev = index.vertex_index;
+        }
+    }
+    return count ? static_cast<double>(near) / static_cast<double>(count)
+                 : 0.0;
+}
+
+//输入里越界的下标会让accumulateNormals越界, 这种文件不测
+bool indicesValid(const tinyobj::ObjReader& reader) {
+    const auto n = static_cast<tinyobj::index_int_t>(
+        reader.GetAttrib().vertices.size() / 3);
+    for (const auto& shape : reader.GetShapes()) {
+        for (const auto& index : shape.mesh.indices) {
+            if (index.vertex_index < 0 || index.vertex_index >= n) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_reorderbench file.obj [repeat]\n";
+        return 1;
+    }
+    const int repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 5;
+
+    tinyobj::ObjReader original;
+    if (!original.ParseFromFile(argv[1]) || !indicesValid(original)) {
+        std::cerr << "failed to load " << argv[1] << "\n";
+        return 1;
+    }
+    ThreadPool pool;
+    std::cout << argv[1] << ": "
+              << original.GetAttrib().vertices.size() / 3 << " vertices, "
+              << pool.get_max_thread_count() << " threads, best of "
+              << repeat << "\n";
+
+    std::vector<tinyobj::real_t> normals;
+    auto run = [&](const char* name, bool reorder, SpaceCurve curve) {
+        tinyobj::attrib_t             attrib = original.GetAttrib();
+        std::vector<tinyobj::shape_t> shapes = original.GetShapes();
+        double                        reorder_ms = 0.0;
+        if (reorder) {
+            ReorderOptions options;
+            options.curve = curve;
+            reorder_ms = measureMs(repeat, [&] {
+                attrib = original.GetAttrib();
+                shapes = original.GetShapes();
+                spatialReorder(attrib, shapes, pool, options);
+            });
+        }
+        const double pass_ms = measureMs(
+            repeat, [&] { accumulateNormals(attrib, shapes, normals); });
+        std::cout.setf(std::ios::fixed);
+        std::cout.precision(3);
+        std::cout.width(10);
+        std::cout << std::left << name << std::right;
+        std::cout << "normals " << pass_ms << " ms";
+        if (reorder) {
+            std::cout << "  reorder (incl. copy) " << reorder_ms << " ms";
+        }
+        std::cout << "  near accesses " << 100.0 * nearAccessRatio(shapes)
+                  << "%\n";
+    };
+
+    run("file", false, SpaceCurve::Morton);
+    run("morton", true, SpaceCurve::Morton);
+    run("hilbert", true, SpaceCurve::Hilbert);
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+#include "ObjLoaders.h"
+
+// 校准autoLoader的阈值: 用样本obj拼出一组大小递增的文件,
+// 分别在热(已在页缓存)和冷(fadvise DONTNEED之后)两种状态下
+// 用每种LoadStrategy加载, 取最快一次, 按交叉点给出AutoLoadOptions.
+// 临时文件写在dir下, 结束时删除.
+//
+// obj_strategybench sample.obj [repeat] [dir]
+
+using Clock = std::chrono::steady_clock;
+
+constexpr off_t kSizes[] = {16 << 10, 64 << 10, 256 << 10, 1 << 20,
+                            4 << 20,  16 << 20, 64 << 20};
+constexpr size_t kNumSizes = std::size(kSizes);
+constexpr off_t  kNever = std::numeric_limits<off_t>::max();
+
+// 热: Sync, Mmap, Parallel; 冷: IOUring, Direct, Parallel
+struct Timings {
+    double hot[3]{};
+    double cold[3]{};
+};
+
+//样本重复拼接到size附近, 在行尾截断
+std::string makeText(const std::string& sample, off_t size) {
+    std::string text;
+    while (text.size() < static_cast<size_t>(size)) {
+        text += sample;
+        if (text.back() != '\n') {
+            text += '\n';
+        }
+    }
+    const size_t end = text.rfind('\n', static_cast<size_t>(size) - 1);
+    text.resize(end == std::string::npos ? text.find('\n') + 1 : end + 1);
+    return text;
+}
+
+void writeFile(const std::string& path, const std::string& text) {
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    //脏页不能被DONTNEED丢掉, 先落盘
+    const int fd = open(path.c_str(), O_RDONLY);
+    fsync(fd);
+    close(fd);
+}
+
+void dropCache(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+//整个读一遍, 把文件放回页缓存: 冷的测量刚把它丢掉
+void warmCache(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    std::vector<char> buf(1 << 20);
+    while (read(fd, buf.data(), buf.size()) > 0) {
+    }
+    close(fd);
+}
+
+double loadOnce(const std::string& path, LoadStrategy strategy, bool hot,
+                ThreadPool& pool) {
+    if (!hot) {
+        dropCache(path);
+    }
+    const auto                begin = Clock::now();
+    std::vector<ReadOnlyFile> files;
+    files.emplace_back(path);
+    FileProbe probe = probeFile(files[0].fd());
+    probe.resident = hot ? 1.0 : 0.0;  // Parallel按这个选读法
+    auto results = loadWithStrategies(files, {probe}, {strategy}, pool);
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    if (results[0].statue_code < 0 || !results[0].result.Valid()) {
+        std::cerr << path << ": " << strategyName(strategy) << " failed\n";
+    }
+    return seconds;
+}
+
+double best(int repeat, const std::string& path, LoadStrategy strategy,
+            bool hot, ThreadPool& pool) {
+    double result = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        const double seconds = loadOnce(path, strategy, hot, pool);
+        result = i == 0 ? seconds : std::min(result, seconds);
+    }
+    return result;
+}
+
+//从第一个满足wins的大小起, 之后每个大小都满足, 没有时返回kNever
+template <class F>
+off_t crossover(F&& wins) {
+    off_t result = kNever;
+    for (size_t k = kNumSizes; k-- > 0;) {
+        if (!wins(k)) {
+            break;
+        }
+        result = kSizes[k];
+    }
+    return result;
+}
+
+void printBytes(off_t bytes) {
+    if (bytes == kNever) {
+        std::cout << "never";
+    } else if (bytes >= (1 << 20)) {
+        std::cout << (bytes >> 20) << "M";
+    } else {
+        std::cout << (bytes >> 10) << "K";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: obj_strategybench sample.obj [repeat] [dir]\n";
+        return 1;
+    }
+    const int         repeat = argc > 2 ? std::max(1, std::stoi(argv[2])) : 3;
+    const std::string dir = argc > 3 ? argv[3] : "/tmp";
+
+    std::ifstream     in(argv[1], std::ios::binary);
+    const std::string sample((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+    if (sample.empty()) {
+        std::cerr << argv[1] << ": empty or unreadable\n";
+        return 1;
+    }
+
+    ThreadPool           pool;
+    std::vector<Timings> timings(kNumSizes);
+    const LoadStrategy   hot[3] = {LoadStrategy::Sync, LoadStrategy::Mmap,
+                                   LoadStrategy::Parallel};
+    const LoadStrategy   cold[3] = {LoadStrategy::IOUring,
+                                    LoadStrategy::Direct,
+                                    LoadStrategy::Parallel};
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(3);
+    std::cout << "best of " << repeat << " (ms), "
+              << pool.get_max_thread_count() << " threads\n"
+              << "size      hot: sync      mmap  parallel"
+                 "  cold: io_uring    direct  parallel\n";
+    for (size_t k = 0; k < kNumSizes; ++k) {
+        const std::string path =
+            dir + "/objl_calibrate_" + std::to_string(kSizes[k]) + ".obj";
+        writeFile(path, makeText(sample, kSizes[k]));
+        for (int s = 0; s < 3; ++s) {
+            warmCache(path);
+            timings[k].hot[s] = best(repeat, path, hot[s], true, pool);
+            timings[k].cold[s] = best(repeat, path, cold[s], false, pool);
+        }
+        unlink(path.c_str());
+
+        std::cout.width(4);
+        printBytes(kSizes[k]);
+        std::cout << "     ";
+        for (const double t : timings[k].hot) {
+            std::cout.width(10);
+            std::cout << t * 1e3;
+        }
+        std::cout << "        ";
+        for (const double t : timings[k].cold) {
+            std::cout.width(10);
+            std::cout << t * 1e3;
+        }
+        std::cout << "\n";
+    }
+
+    auto&       t = timings;
+    const off_t mmap_min =
+        crossover([&](size_t k) { return t[k].hot[1] < t[k].hot[0]; });
+    //mmap开始一直更快的前一档
+    off_t sync_max = kSizes[kNumSizes - 1];
+    for (size_t k = 1; k < kNumSizes; ++k) {
+        if (kSizes[k] == mmap_min) {
+            sync_max = kSizes[k - 1];
+        }
+    }
+    if (mmap_min == kSizes[0]) {
+        sync_max = 0;
+    }
+    const off_t direct_min =
+        crossover([&](size_t k) { return t[k].cold[1] < t[k].cold[0]; });
+    const off_t parallel_min = crossover([&](size_t k) {
+        return t[k].hot[2] < std::min(t[k].hot[0], t[k].hot[1]) &&
+               t[k].cold[2] < std::min(t[k].cold[0], t[k].cold[1]);
+    });
+    std::cout << "suggested: sync_max_bytes ";
+    printBytes(sync_max);
+    std::cout << ", direct_min_bytes ";
+    printBytes(direct_min);
+    std::cout << ", parallel_min_bytes ";
+    printBytes(parallel_min);
+    std::cout << "\n";
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+
+// 线程池调度开销的微基准(Google Benchmark): 空任务吞吐,
+// 协程经schedule()换线程的延迟, 1~64线程的fork/join,
+// 线程空闲时从push_task到任务开始执行的唤醒延迟.
+// 每次改调度器前后各跑一次, 基线记在reuslt.md里.
+//
+// obj_threadpool_bench --benchmark_repetitions=5
+
+using Clock = std::chrono::steady_clock;
+
+//不需要返回值的协程, 跑完自己销毁
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+//连续hops次挂起再由线程池里的某个线程恢复
+Detached hopChain(ThreadPool& pool, int64_t hops) {
+    for (int64_t i = 0; i < hops; ++i) {
+        co_await pool.schedule();
+    }
+}
+
+// 每轮提交一批空任务再等全部完成, 测push_task(std::bind,
+// std::function, notify_one)加上出队执行的单任务开销
+void BM_EmptyTaskThroughput(benchmark::State& state) {
+    constexpr int64_t kBatch = 4096;
+    ThreadPool        pool(static_cast<concurrency_t>(state.range(0)));
+    for (auto _ : state) {
+        for (int64_t i = 0; i < kBatch; ++i) {
+            pool.push_task([] {});
+        }
+        pool.wait_for_tasks();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_EmptyTaskThroughput)
+    ->RangeMultiplier(2)
+    ->Range(1, 64)
+    ->UseRealTime();
+
+// 一个协程来回换线程, 每跳一次是一次push_task加一次resume.
+// 任务链上始终有一个任务在排队或执行, 所以wait_for_tasks等的就是整条链
+void BM_CoroutineHop(benchmark::State& state) {
+    constexpr int64_t kHops = 1024;
+    ThreadPool        pool(static_cast<concurrency_t>(state.range(0)));
+    for (auto _ : state) {
+        hopChain(pool, kHops);
+        pool.wait_for_tasks();
+    }
+    state.SetItemsProcessed(state.iterations() * kHops);
+}
+BENCHMARK(BM_CoroutineHop)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+// parallelize_loop切成线程数那么多块, 每块只做很少的事,
+// 测的是分发和汇合本身
+void BM_FanOutFanIn(benchmark::State& state) {
+    const auto threads = static_cast<concurrency_t>(state.range(0));
+    ThreadPool pool(threads);
+    std::vector<std::atomic<int64_t>> sums(threads);
+    for (auto _ : state) {
+        pool.parallelize_loop(
+            0, threads,
+            [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    sums[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            },
+            threads);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FanOutFanIn)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+// 先睡一会儿让所有线程回到条件变量上等待, 再测从push_task到
+// 任务开始执行的时间(手动计时, 不含睡眠)
+void BM_WakeupFromIdle(benchmark::State& state) {
+    ThreadPool pool(static_cast<concurrency_t>(state.range(0)));
+    for (auto _ : state) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        Clock::time_point started;
+        const auto        pushed = Clock::now();
+        pool.push_task([&started] { started = Clock::now(); });
+        pool.wait_for_tasks();  //之后读started是安全的
+        state.SetIterationTime(
+            std::chrono::duration<double>(started - pushed).count());
+    }
+}
+BENCHMARK(BM_WakeupFromIdle)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(64)
+    ->UseManualTime()
+    ->Iterations(2000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,334 @@
+#include "objloader.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "ObjLoaders.h"
+#include "ObjPipeline.h"
+#include "ThreadPool.h"
+#include "tiny_obj_loader.h"
+
+static_assert(std::is_same_v<objl_real, tinyobj::real_t>,
+              "OBJL_USE_DOUBLE must match TINYOBJLOADER_USE_DOUBLE");
+static_assert(std::is_same_v<objl_int, tinyobj::index_int_t>,
+              "OBJL_USE_INDEX64 must match TINYOBJLOADER_USE_INDEX64");
+static_assert(sizeof(objl_index) == sizeof(tinyobj::index_t) &&
+                  offsetof(objl_index, normal_index) ==
+                      offsetof(tinyobj::index_t, normal_index) &&
+                  offsetof(objl_index, texcoord_index) ==
+                      offsetof(tinyobj::index_t, texcoord_index),
+              "objl_index must alias tinyobj::index_t");
+
+struct objl_result {
+    int                status{OBJL_OK};
+    std::string        error;
+    tinyobj::ObjReader reader;
+};
+
+namespace objl_detail {
+
+//一次提交给io_uring的文件数上限
+constexpr size_t kMaxBatch = 1024;
+
+struct Settings {
+    tinyobj::ObjReaderConfig config;
+    std::string              mtl_text;
+};
+
+//库里所有调用共用的线程池
+inline ThreadPool& pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// 只读调用方声明的struct_size那么多字节, 后面的字段保持默认值
+inline Settings readOptions(const objl_options* options) {
+    objl_options opts;
+    objl_options_init(&opts);
+    if (options && options->struct_size >= sizeof(size_t)) {
+        std::memcpy(&opts, options,
+                    std::min(options->struct_size, sizeof(opts)));
+    }
+    Settings settings;
+    settings.config.triangulate = opts.triangulate != 0;
+    settings.config.vertex_color = opts.vertex_color != 0;
+    if (opts.mtl_text) {
+        settings.mtl_text = opts.mtl_text;
+    }
+    return settings;
+}
+
+//只写调用方声明的struct_size那么多字节
+template <class T>
+int writeStruct(const T& value, T* out) {
+    if (!out || out->struct_size < sizeof(size_t)) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    const size_t size = std::min(out->struct_size, sizeof(T));
+    std::memcpy(reinterpret_cast<char*>(out) + sizeof(size_t),
+                reinterpret_cast<const char*>(&value) + sizeof(size_t),
+                size - sizeof(size_t));
+    return OBJL_OK;
+}
+
+//异常不能穿过C边界
+template <class F>
+int guarded(F&& body) {
+    try {
+        return body();
+    } catch (const std::bad_alloc&) {
+        return OBJL_E_NO_MEMORY;
+    } catch (...) {
+        return OBJL_E_IO;
+    }
+}
+
+inline void finishParse(objl_result& result, bool ok) {
+    if (!ok) {
+        result.status = OBJL_E_PARSE;
+        result.error = result.reader.Error();
+    }
+}
+
+//pread读满整个文件, 失败返回-errno
+inline ssize_t readAll(const ReadOnlyFile& file, std::vector<char>& buf) {
+    size_t done = 0;
+    while (done < buf.size()) {
+        const ssize_t n =
+            pread(file.fd(), buf.data() + done, buf.size() - done, done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    buf.resize(done);
+    return static_cast<ssize_t>(done);
+}
+
+}  // namespace objl_detail
+
+extern "C" {
+
+OBJL_API uint32_t objl_version(void) {
+    return (uint32_t(OBJL_VERSION_MAJOR) << 16) | OBJL_VERSION_MINOR;
+}
+
+OBJL_API void objl_options_init(objl_options* options) {
+    if (!options) {
+        return;
+    }
+    std::memset(options, 0, sizeof(*options));
+    options->struct_size = sizeof(*options);
+    options->triangulate = 1;
+    options->vertex_color = 1;
+}
+
+OBJL_API int objl_load_file(const char* path, const objl_options* options,
+                            objl_result** out) {
+    using namespace objl_detail;
+    if (!path || !out) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    *out = nullptr;
+    return guarded([&] {
+        auto           result = std::make_unique<objl_result>();
+        const Settings settings = readOptions(options);
+        try {
+            ReadOnlyFile      file(path);
+            std::vector<char> buf(static_cast<size_t>(file.size()));
+            const ssize_t     n = readAll(file, buf);
+            if (n < 0) {
+                result->status = OBJL_E_IO;
+                result->error = std::strerror(static_cast<int>(-n));
+            } else {
+                finishParse(*result,
+                            parseObjPipelined(result->reader, buf.data(),
+                                              buf.size(), settings.mtl_text,
+                                              pool(), settings.config));
+            }
+        } catch (const std::runtime_error& e) {  // ReadOnlyFile
+            result->status = OBJL_E_IO;
+            result->error = e.what();
+        }
+        *out = result.release();
+        return (*out)->status;
+    });
+}
+
+OBJL_API int objl_load_buffer(const char* data, size_t size,
+                              const objl_options* options,
+                              objl_result**       out) {
+    using namespace objl_detail;
+    if ((!data && size) || !out) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    *out = nullptr;
+    return guarded([&] {
+        auto           result = std::make_unique<objl_result>();
+        const Settings settings = readOptions(options);
+        finishParse(*result, parseObjPipelined(result->reader, data, size,
+                                               settings.mtl_text, pool(),
+                                               settings.config));
+        *out = result.release();
+        return (*out)->status;
+    });
+}
+
+OBJL_API int objl_load_files(const char* const* paths, size_t count,
+                             const objl_options* options,
+                             objl_result**       out) {
+    using namespace objl_detail;
+    if ((!paths && count) || !out) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = nullptr;
+    }
+    std::vector<std::unique_ptr<objl_result>> results;
+    const int status = guarded([&] {
+        const Settings settings = readOptions(options);
+        results.resize(count);
+        for (size_t first = 0; first < count; first += kMaxBatch) {
+            const size_t last = std::min(count, first + kMaxBatch);
+            //打不开的文件直接记下错误, 其余的一起交给io_uring
+            std::vector<ReadOnlyFile> files;
+            std::vector<size_t>       slots;
+            for (size_t i = first; i < last; ++i) {
+                results[i] = std::make_unique<objl_result>();
+                try {
+                    if (!paths[i]) {
+                        throw std::runtime_error("null path");
+                    }
+                    files.emplace_back(paths[i]);
+                    slots.push_back(i);
+                } catch (const std::runtime_error& e) {
+                    results[i]->status = OBJL_E_IO;
+                    results[i]->error = e.what();
+                }
+            }
+            if (files.empty()) {
+                continue;
+            }
+            auto parsed = parseOBJFiles(files, pool(), settings.config,
+                                        settings.mtl_text);
+            for (size_t k = 0; k < parsed.size(); ++k) {
+                objl_result& result = *results[slots[k]];
+                if (parsed[k].statue_code < 0) {
+                    result.status = OBJL_E_IO;
+                    result.error = std::strerror(-parsed[k].statue_code);
+                    continue;
+                }
+                result.reader = std::move(parsed[k].result);
+                finishParse(result, result.reader.Valid());
+            }
+        }
+        return OBJL_OK;
+    });
+    if (status != OBJL_OK) {
+        return status;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = results[i].release();
+    }
+    return OBJL_OK;
+}
+
+OBJL_API void objl_result_free(objl_result* result) {
+    delete result;
+}
+
+OBJL_API int objl_result_status(const objl_result* result) {
+    return result ? result->status : OBJL_E_INVALID_ARGUMENT;
+}
+
+OBJL_API const char* objl_result_error(const objl_result* result) {
+    return result ? result->error.c_str() : "";
+}
+
+OBJL_API const char* objl_result_warning(const objl_result* result) {
+    return result ? result->reader.Warning().c_str() : "";
+}
+
+OBJL_API int objl_result_attrib(const objl_result* result,
+                                objl_attrib*       out) {
+    if (!result) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    const tinyobj::attrib_t& attrib = result->reader.GetAttrib();
+    objl_attrib              view{};
+    view.vertices = attrib.vertices.data();
+    view.num_vertices = attrib.vertices.size() / 3;
+    view.normals = attrib.normals.data();
+    view.num_normals = attrib.normals.size() / 3;
+    view.texcoords = attrib.texcoords.data();
+    view.num_texcoords = attrib.texcoords.size() / 2;
+    view.colors = attrib.colors.size() == attrib.vertices.size()
+                      ? attrib.colors.data()
+                      : nullptr;
+    return objl_detail::writeStruct(view, out);
+}
+
+OBJL_API size_t objl_result_shape_count(const objl_result* result) {
+    return result ? result->reader.GetShapes().size() : 0;
+}
+
+OBJL_API int objl_result_shape(const objl_result* result, size_t index,
+                               objl_shape* out) {
+    if (!result || index >= result->reader.GetShapes().size()) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    const tinyobj::shape_t& shape = result->reader.GetShapes()[index];
+    const tinyobj::mesh_t&  mesh = shape.mesh;
+    objl_shape              view{};
+    view.name = shape.name.c_str();
+    view.indices = reinterpret_cast<const objl_index*>(mesh.indices.data());
+    view.num_indices = mesh.indices.size();
+    view.num_face_vertices = mesh.num_face_vertices.data();
+    view.num_faces = mesh.num_face_vertices.size();
+    view.material_ids = mesh.material_ids.data();
+    view.smoothing_group_ids = mesh.smoothing_group_ids.data();
+    return objl_detail::writeStruct(view, out);
+}
+
+OBJL_API size_t objl_result_material_count(const objl_result* result) {
+    return result ? result->reader.GetMaterials().size() : 0;
+}
+
+OBJL_API int objl_result_material(const objl_result* result, size_t index,
+                                  objl_material* out) {
+    if (!result || index >= result->reader.GetMaterials().size()) {
+        return OBJL_E_INVALID_ARGUMENT;
+    }
+    const tinyobj::material_t& m = result->reader.GetMaterials()[index];
+    objl_material              view{};
+    view.name = m.name.c_str();
+    view.ambient = m.ambient;
+    view.diffuse = m.diffuse;
+    view.specular = m.specular;
+    view.emission = m.emission;
+    view.shininess = m.shininess;
+    view.dissolve = m.dissolve;
+    view.illum = m.illum;
+    view.ambient_texname = m.ambient_texname.c_str();
+    view.diffuse_texname = m.diffuse_texname.c_str();
+    view.specular_texname = m.specular_texname.c_str();
+    view.bump_texname = m.bump_texname.c_str();
+    view.alpha_texname = m.alpha_texname.c_str();
+    view.normal_texname = m.normal_texname.c_str();
+    return objl_detail::writeStruct(view, out);
+}
+
+}  // extern "C"
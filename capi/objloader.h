@@ -0,0 +1,156 @@
+#ifndef OBJLOADER_C_H
+#define OBJLOADER_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 给Python(ctypes/cffi), Rust, C#等用的C接口, 对应libobjloader_c.so.
+// 解析结果只通过指针+长度的视图暴露, 指向库内部的数组, 不拷贝;
+// 视图在objl_result_free之前一直有效.
+//
+// ABI约定:
+// - 主版本号变了才会删改已有的函数和结构体字段, 也就是so的SOVERSION
+// - 结构体只在末尾加字段. 调用方在struct_size里填自己看到的
+//   sizeof, 库只读写这么多字节, 新旧版本可以混用
+// - 运行时用objl_version()检查主版本号和头文件是否一致
+
+#define OBJL_VERSION_MAJOR 1
+#define OBJL_VERSION_MINOR 0
+
+#if defined(OBJL_BUILDING_LIBRARY)
+#define OBJL_API __attribute__((visibility("default")))
+#else
+#define OBJL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//库编译时用的TINYOBJLOADER_USE_DOUBLE/TINYOBJLOADER_USE_INDEX64
+//要和这里一致
+#ifdef OBJL_USE_DOUBLE
+typedef double objl_real;
+#else
+typedef float objl_real;
+#endif
+#ifdef OBJL_USE_INDEX64
+typedef long long objl_int;
+#else
+typedef int objl_int;
+#endif
+
+//返回码, 函数都返回int以免枚举大小随编译器变
+enum {
+    OBJL_OK = 0,
+    OBJL_E_INVALID_ARGUMENT = -1,
+    OBJL_E_IO = -2,     //打开或读取失败, 详情见objl_result_error
+    OBJL_E_PARSE = -3,  //解析出错, 详情见objl_result_error
+    OBJL_E_NO_MEMORY = -4,
+};
+
+typedef struct objl_result objl_result;  //一个文件的解析结果
+
+typedef struct objl_options {
+    size_t struct_size;  // sizeof(objl_options)
+    int    triangulate;  //非0时多边形三角化, 默认1
+    int    vertex_color;  //非0时没有顶点颜色的文件也填默认颜色, 默认1
+    //mtllib行引用的材质从这段文本里读, 为NULL时不加载材质
+    const char* mtl_text;
+} objl_options;
+
+//和tinyobj::index_t布局相同, -1表示没有
+typedef struct objl_index {
+    objl_int vertex_index;
+    objl_int normal_index;
+    objl_int texcoord_index;
+} objl_index;
+
+typedef struct objl_attrib {
+    size_t           struct_size;  // sizeof(objl_attrib)
+    const objl_real* vertices;     // xyz, num_vertices * 3
+    size_t           num_vertices;
+    const objl_real* normals;  // xyz, num_normals * 3
+    size_t           num_normals;
+    const objl_real* texcoords;  // uv, num_texcoords * 2
+    size_t           num_texcoords;
+    const objl_real* colors;  // rgb, num_vertices * 3, 没有时为NULL
+} objl_attrib;
+
+typedef struct objl_shape {
+    size_t            struct_size;  // sizeof(objl_shape)
+    const char*       name;
+    const objl_index* indices;
+    size_t            num_indices;
+    //下面三个都是每面一项, 共num_faces项
+    const unsigned char* num_face_vertices;
+    size_t               num_faces;
+    const int*           material_ids;  //-1表示没有材质
+    const unsigned int*  smoothing_group_ids;
+} objl_shape;
+
+typedef struct objl_material {
+    size_t           struct_size;  // sizeof(objl_material)
+    const char*      name;
+    const objl_real* ambient;  //每项3个分量
+    const objl_real* diffuse;
+    const objl_real* specular;
+    const objl_real* emission;
+    objl_real        shininess;
+    objl_real        dissolve;
+    int              illum;
+    const char*      ambient_texname;
+    const char*      diffuse_texname;
+    const char*      specular_texname;
+    const char*      bump_texname;
+    const char*      alpha_texname;
+    const char*      normal_texname;
+} objl_material;
+
+// (major << 16) | minor
+OBJL_API uint32_t objl_version(void);
+
+//填默认值, 调用前不需要先填struct_size
+OBJL_API void objl_options_init(objl_options* options);
+
+// 加载一个文件: 整个读进内存, 在库内部的线程池上流水线解析.
+// options可以为NULL. 失败时*out可能仍然非NULL(带着错误信息),
+// 同样要objl_result_free
+OBJL_API int objl_load_file(const char* path, const objl_options* options,
+                            objl_result** out);
+
+//解析内存中的obj文本, 不拷贝data
+OBJL_API int objl_load_buffer(const char* data, size_t size,
+                              const objl_options* options,
+                              objl_result**       out);
+
+// 批量加载: io_uring一次提交所有读请求, 读完的文件在线程池上并行解析.
+// out[i]对应paths[i], 每个都要objl_result_free.
+// 单个文件失败不影响其他文件, 用objl_result_status查看;
+// 返回值只反映参数和内存错误
+OBJL_API int objl_load_files(const char* const* paths, size_t count,
+                             const objl_options* options,
+                             objl_result**       out);
+
+OBJL_API void objl_result_free(objl_result* result);
+
+OBJL_API int         objl_result_status(const objl_result* result);
+OBJL_API const char* objl_result_error(const objl_result* result);
+OBJL_API const char* objl_result_warning(const objl_result* result);
+
+OBJL_API int objl_result_attrib(const objl_result* result,
+                                objl_attrib*       out);
+
+OBJL_API size_t objl_result_shape_count(const objl_result* result);
+OBJL_API int    objl_result_shape(const objl_result* result, size_t index,
+                                  objl_shape* out);
+
+OBJL_API size_t objl_result_material_count(const objl_result* result);
+OBJL_API int    objl_result_material(const objl_result* result,
+                                     size_t index, objl_material* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OBJLOADER_C_H
@@ -147,6 +147,18 @@ typedef double real_t;
 typedef float real_t;
 #endif
 
+// Vertex indices and per-mesh element offsets. int/unsigned int by
+// default; define TINYOBJLOADER_USE_INDEX64 for files with more than 2^31
+// vertices or face corners. That doubles the size of index_t, so only
+// enable it for builds that need it.
+#ifdef TINYOBJLOADER_USE_INDEX64
+typedef long long index_int_t;
+typedef unsigned long long index_uint_t;
+#else
+typedef int index_int_t;
+typedef unsigned int index_uint_t;
+#endif
+
 typedef enum {
   TEXTURE_TYPE_NONE, // default
   TEXTURE_TYPE_SPHERE,
@@ -337,7 +349,7 @@ struct joint_and_weight_t {
 };
 
 struct skin_weight_t {
-  int vertex_id; // Corresponding vertex index in `attrib_t::vertices`.
+  index_int_t vertex_id; // Corresponding vertex index in `attrib_t::vertices`.
                  // Compared to `index_t`, this index must be positive and
                  // start with 0(does not allow relative indexing)
   std::vector<joint_and_weight_t> weightValues;
@@ -346,9 +358,28 @@ struct skin_weight_t {
 // Index struct to support different indices for vtx/normal/texcoord.
 // -1 means not used.
 struct index_t {
-  int vertex_index;
-  int normal_index;
-  int texcoord_index;
+  index_int_t vertex_index;
+  index_int_t normal_index;
+  index_int_t texcoord_index;
+};
+
+// Faces [first_face, first_face + face_count) and their indices
+// [first_index, first_index + count) of a mesh all use `material_id`.
+struct material_range_t {
+  int material_id;
+  index_uint_t first_index;
+  index_uint_t count; // number of indices
+  index_uint_t first_face;
+  index_uint_t face_count;
+};
+
+// A run of consecutive faces of a mesh that share one per-face value.
+// Faces [first_face, first_face + face_count) all have `value`.
+template <typename T>
+struct face_run_t {
+  index_uint_t first_face;
+  index_uint_t face_count;
+  T value;
 };
 
 struct mesh_t {
@@ -362,6 +393,117 @@ struct mesh_t {
                                                  // ID(0 = off. positive value
                                                  // = group id)
   std::vector<tag_t> tags;                       // SubD tag
+
+  // One entry per material, in ascending material id, once the faces have
+  // been grouped by material. Empty otherwise.
+  std::vector<material_range_t> material_ranges;
+
+  // Compact face layout(see CompactFaceAttributes()). When
+  // `face_vertex_runs` is not empty, num_face_vertices, material_ids and
+  // smoothing_group_ids are empty and the same values are stored as runs.
+  // An all-triangle mesh then has a single vertex count run. Use
+  // face_cursor_t to walk the faces in either layout.
+  std::vector<face_run_t<unsigned char> > face_vertex_runs;
+  std::vector<face_run_t<int> > material_runs;
+  std::vector<face_run_t<unsigned int> > smoothing_group_runs;
+};
+
+///
+/// Number of faces of `mesh` in either face layout.
+///
+size_t NumFaces(const mesh_t &mesh);
+
+///
+/// Replaces the per-face arrays of `mesh` by runs. Triangulated output
+/// only changes material and smoothing group at `usemtl` and `s` lines, so
+/// a few runs replace 9 bytes per face. A mesh whose runs would not be
+/// smaller than the arrays keeps the per-face layout. Returns false(and
+/// leaves `mesh` alone) when the per-face arrays disagree on the number of
+/// faces.
+///
+bool CompactFaceAttributes(mesh_t *mesh);
+
+///
+/// Restores the per-face arrays of a compacted `mesh`, for code that
+/// indexes them directly.
+///
+void ExpandFaceAttributes(mesh_t *mesh);
+
+///
+/// Walks the faces of a mesh in either face layout, O(1) per step:
+///
+///   for (face_cursor_t f(mesh); !f.done(); f.next()) {
+///     const index_t *face = &mesh.indices[f.index_offset()];
+///     draw(face, f.num_vertices(), f.material_id());
+///   }
+///
+class face_cursor_t {
+public:
+  explicit face_cursor_t(const mesh_t &mesh)
+      : mesh_(mesh), compact_(!mesh.face_vertex_runs.empty()),
+        num_faces_(NumFaces(mesh)), face_(0), index_offset_(0) {
+    run_[0] = run_[1] = run_[2] = 0;
+  }
+
+  bool done() const { return face_ >= num_faces_; }
+
+  void next() {
+    index_offset_ += num_vertices();
+    face_++;
+    if (compact_) {
+      Advance(mesh_.face_vertex_runs, &run_[0]);
+      Advance(mesh_.material_runs, &run_[1]);
+      Advance(mesh_.smoothing_group_runs, &run_[2]);
+    }
+  }
+
+  size_t face() const { return face_; }
+
+  /// Offset of the first index of the face in `mesh.indices`.
+  size_t index_offset() const { return index_offset_; }
+
+  unsigned int num_vertices() const {
+    return compact_ ? mesh_.face_vertex_runs[run_[0]].value
+                    : mesh_.num_face_vertices[face_];
+  }
+
+  /// -1 when the mesh has no material ids.
+  int material_id() const {
+    if (compact_) {
+      return mesh_.material_runs.empty()
+                 ? -1
+                 : mesh_.material_runs[run_[1]].value;
+    }
+    return face_ < mesh_.material_ids.size() ? mesh_.material_ids[face_]
+                                             : -1;
+  }
+
+  /// 0(off) when the mesh has no smoothing group ids.
+  unsigned int smoothing_group_id() const {
+    if (compact_) {
+      return mesh_.smoothing_group_runs.empty()
+                 ? 0
+                 : mesh_.smoothing_group_runs[run_[2]].value;
+    }
+    return face_ < mesh_.smoothing_group_ids.size()
+               ? mesh_.smoothing_group_ids[face_]
+               : 0;
+  }
+
+private:
+  template <typename T>
+  void Advance(const std::vector<face_run_t<T> > &runs, size_t *run) const {
+    if (*run + 1 < runs.size() && runs[*run + 1].first_face <= face_) {
+      (*run)++;
+    }
+  }
+
+  const mesh_t &mesh_;
+  bool compact_;
+  size_t num_faces_;
+  size_t face_;
+  size_t index_offset_;
+  size_t run_[3];
 };
 
 // struct path_t {
@@ -380,9 +522,92 @@ struct points_t {
 
 struct shape_t {
   std::string name;
+  int name_id; // Handle of `name` in ObjReader::GetNamePool(). -1 if unset.
   mesh_t mesh;
   lines_t lines;
   points_t points;
+
+  shape_t() : name_id(-1) {}
+};
+
+///
+/// Array of real_t aligned to `kAlignment` bytes(AVX) and zero padded to a
+/// multiple of `kPadding` elements, so SIMD loops can load whole vectors
+/// up to `padded_size()` without a scalar tail.
+///
+class aligned_array_t {
+public:
+  enum { kAlignment = 32 };
+  enum { kPadding = kAlignment / sizeof(real_t) };
+
+  aligned_array_t() : block_(NULL), data_(NULL), size_(0), capacity_(0) {}
+  aligned_array_t(const aligned_array_t &other);
+  aligned_array_t &operator=(const aligned_array_t &other);
+#if __cplusplus >= 201103L
+  /// Takes over the block of `other`, which is left empty.
+  aligned_array_t(aligned_array_t &&other) noexcept;
+  aligned_array_t &operator=(aligned_array_t &&other) noexcept;
+#endif
+  ~aligned_array_t();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  /// `size()` rounded up to a multiple of `kPadding`.
+  size_t padded_size() const {
+    return (size_ + kPadding - 1) / kPadding * kPadding;
+  }
+
+  /// NULL when nothing was ever allocated.
+  const real_t *data() const { return data_; }
+  real_t *data() { return data_; }
+
+  const real_t &operator[](size_t i) const { return data_[i]; }
+  real_t &operator[](size_t i) { return data_[i]; }
+
+  /// New elements and the padding are zero.
+  void resize(size_t n);
+  void clear() { resize(0); }
+  void swap(aligned_array_t &other);
+
+private:
+  void *block_; // As returned by malloc; `data_` is aligned inside.
+  real_t *data_;
+  size_t size_;
+  size_t capacity_; // Multiple of `kPadding`.
+};
+
+///
+/// Attribute lines of a lazy parse(ObjReaderConfig::lazy_attributes)
+/// that are decoded on request. The attrib_t arrays are sized by the
+/// parse, but their elements stay zero until DecodeVertices() etc. decode
+/// the blocks of `kBlockSize` lines holding them.
+///
+struct lazy_attrib_t {
+  enum { kBlockSize = 4096 };
+
+  const char *text; // The parsed .obj text. Must outlive the decoding.
+  size_t text_len;
+
+  // Offset in `text` of each `v`, `vn` and `vt` line.
+  std::vector<size_t> vertex_lines;
+  std::vector<size_t> normal_lines;
+  std::vector<size_t> texcoord_lines;
+
+  // One flag per block, nonzero once decoded.
+  std::vector<unsigned char> vertex_blocks;
+  std::vector<unsigned char> normal_blocks;
+  std::vector<unsigned char> texcoord_blocks;
+
+  // ObjReaderConfig::transform, applied as blocks are decoded.
+  bool use_transform;
+  bool rescale_normals;
+  real_t point_xform[12];
+  real_t normal_xform[12];
+
+  lazy_attrib_t()
+      : text(NULL), text_len(0), use_transform(false),
+        rescale_normals(false) {}
 };
 
 // Vertex attributes
@@ -409,6 +634,18 @@ struct attrib_t {
   // (e.g. using std::map, std::unordered_map)
   std::vector<skin_weight_t> skin_weights;
 
+  // Structure-of-arrays layout(see SplitAttributes()). When `vertex_x` is
+  // not empty, `vertices` is empty and the positions are stored one
+  // component per array; likewise `normal_*` replace `normals` and
+  // `texcoord_*` replace `texcoords`. Use GetVertex() etc. to read either
+  // layout.
+  aligned_array_t vertex_x, vertex_y, vertex_z;
+  aligned_array_t normal_x, normal_y, normal_z;
+  aligned_array_t texcoord_u, texcoord_v;
+
+  // Undecoded lines of a lazy parse. Empty otherwise.
+  lazy_attrib_t lazy;
+
   attrib_t() {}
 
   //
@@ -419,6 +656,100 @@ struct attrib_t {
   const std::vector<real_t> &GetVertexWeights() const { return vertex_weights; }
 };
 
+///
+/// Number of positions, normals and texcoords of `attrib` in either
+/// attribute layout.
+///
+inline size_t NumVertices(const attrib_t &attrib) {
+  return attrib.vertex_x.empty() ? attrib.vertices.size() / 3
+                                 : attrib.vertex_x.size();
+}
+
+inline size_t NumNormals(const attrib_t &attrib) {
+  return attrib.normal_x.empty() ? attrib.normals.size() / 3
+                                 : attrib.normal_x.size();
+}
+
+inline size_t NumTexcoords(const attrib_t &attrib) {
+  return attrib.texcoord_u.empty() ? attrib.texcoords.size() / 2
+                                   : attrib.texcoord_u.size();
+}
+
+///
+/// Position `i` of `attrib` in either attribute layout.
+///
+inline void GetVertex(const attrib_t &attrib, size_t i, real_t xyz[3]) {
+  if (attrib.vertex_x.empty()) {
+    xyz[0] = attrib.vertices[3 * i + 0];
+    xyz[1] = attrib.vertices[3 * i + 1];
+    xyz[2] = attrib.vertices[3 * i + 2];
+  } else {
+    xyz[0] = attrib.vertex_x[i];
+    xyz[1] = attrib.vertex_y[i];
+    xyz[2] = attrib.vertex_z[i];
+  }
+}
+
+inline void GetNormal(const attrib_t &attrib, size_t i, real_t xyz[3]) {
+  if (attrib.normal_x.empty()) {
+    xyz[0] = attrib.normals[3 * i + 0];
+    xyz[1] = attrib.normals[3 * i + 1];
+    xyz[2] = attrib.normals[3 * i + 2];
+  } else {
+    xyz[0] = attrib.normal_x[i];
+    xyz[1] = attrib.normal_y[i];
+    xyz[2] = attrib.normal_z[i];
+  }
+}
+
+inline void GetTexcoord(const attrib_t &attrib, size_t i, real_t uv[2]) {
+  if (attrib.texcoord_u.empty()) {
+    uv[0] = attrib.texcoords[2 * i + 0];
+    uv[1] = attrib.texcoords[2 * i + 1];
+  } else {
+    uv[0] = attrib.texcoord_u[i];
+    uv[1] = attrib.texcoord_v[i];
+  }
+}
+
+///
+/// Moves the positions, normals and texcoords of `attrib` into the
+/// structure-of-arrays layout(`vertex_x` etc.), so SIMD kernels(bounds,
+/// transforms, culling) can run over them without transposing.
+/// Colors, vertex weights and skin weights keep their layout.
+///
+void SplitAttributes(attrib_t *attrib);
+
+///
+/// Restores the interleaved `vertices`, `normals` and `texcoords` of a
+/// split `attrib`, for code that indexes them directly.
+///
+void InterleaveAttributes(attrib_t *attrib);
+
+///
+/// Decodes the positions(and vertex colors) [first, last) of a lazily
+/// parsed `attrib`, rounded out to whole blocks. Decoded blocks are
+/// skipped, so repeated calls are cheap. Calls for disjoint blocks may run
+/// on different threads at once. Does nothing for an eager parse.
+///
+void DecodeVertices(attrib_t *attrib, size_t first, size_t last);
+
+///
+/// Same as DecodeVertices() for normals.
+///
+void DecodeNormals(attrib_t *attrib, size_t first, size_t last);
+
+///
+/// Same as DecodeVertices() for texcoords.
+///
+void DecodeTexcoords(attrib_t *attrib, size_t first, size_t last);
+
+///
+/// Decodes whatever is left of a lazily parsed `attrib` and drops the
+/// lazy state, after which the text is no longer needed.
+///
+void DecodeAttributes(attrib_t *attrib);
+
 struct callback_t {
   // W is optional and set to 1 if there is no `w` item in `v` line
   void (*vertex_cb)(void *user_data, real_t x, real_t y, real_t z, real_t w);
@@ -460,6 +791,13 @@ public:
                           std::vector<material_t> *materials,
                           std::map<std::string, int> *matMap, std::string *warn,
                           std::string *err) = 0;
+
+  ///
+  /// Directory of the .mtl file read by the last successful call, which is
+  /// what its texture names are relative to. Empty when not read from a
+  /// file.
+  ///
+  virtual std::string LastDirectory() const { return std::string(); }
 };
 
 ///
@@ -476,8 +814,13 @@ public:
                           std::map<std::string, int> *matMap, std::string *warn,
                           std::string *err) TINYOBJ_OVERRIDE;
 
+  virtual std::string LastDirectory() const TINYOBJ_OVERRIDE {
+    return m_lastDir;
+  }
+
 private:
   std::string m_mtlBaseDir;
+  std::string m_lastDir;
 };
 
 ///
@@ -497,6 +840,34 @@ private:
   std::istream &m_inStream;
 };
 
+///
+/// A shape published during parsing(progressive delivery).
+/// Pointers are only valid during the callback.
+///
+struct shape_chunk_t {
+  const shape_t *shape;
+  size_t shape_index; // Index of `shape` in the final shapes array.
+
+  // Attributes appended since the previous chunk. The first element
+  // corresponds to `attrib_t` element `*_offset`(in xyz/uv units).
+  const real_t *vertices; // xyz * num_vertices
+  size_t vertex_offset;
+  size_t num_vertices;
+  const real_t *colors; // rgb * num_vertices. NULL if not all vertices have
+                        // colors so far.
+  const real_t *normals; // xyz * num_normals
+  size_t normal_offset;
+  size_t num_normals;
+  const real_t *texcoords; // uv * num_texcoords
+  size_t texcoord_offset;
+  size_t num_texcoords;
+
+  // [min, max] attribute indices referenced by `shape`. -1 if none.
+  index_int_t vertex_range[2];
+  index_int_t normal_range[2];
+  index_int_t texcoord_range[2];
+};
+
 // v2 API
 struct ObjReaderConfig {
   bool triangulate; // triangulate polygon?
@@ -515,12 +886,158 @@ struct ObjReaderConfig {
   ///
   /// Search path to .mtl file.
   /// Default = "" = search from the same directory of .obj file.
-  /// Valid only when loading .obj from a file.
+  /// Valid when loading .obj from a file, or from memory with an empty
+  /// `mtl_text`(ParseFromBuffer, ObjTextParser).
   ///
   std::string mtl_search_path;
 
+  ///
+  /// Progressive delivery.
+  /// When set, called from the parsing thread each time a shape is flushed
+  /// (at `g`, `o` and the end of input), before the whole file is parsed.
+  /// All attributes the shape references have been published by then.
+  ///
+  void (*shape_cb)(void *user_data, const shape_chunk_t &chunk);
+  void *shape_cb_user_data;
+
+  ///
+  /// Affine transform applied to each `v` as it is parsed(unit conversion,
+  /// up-axis change, recentering), so no second pass over the attributes
+  /// is needed. Column-major 4x4 like OpenGL: the translation is
+  /// transform[12..14] and the bottom row is ignored. `vn` goes through
+  /// the normal matrix(inverse transpose of the upper 3x3) and keeps its
+  /// length. Only used when `use_transform` is true.
+  ///
+  bool use_transform;
+  real_t transform[16];
+
+  ///
+  /// Store num_face_vertices, material_ids and smoothing_group_ids of each
+  /// shape as runs(mesh_t::face_vertex_runs etc.) instead of one entry per
+  /// face. See CompactFaceAttributes().
+  ///
+  bool compact_face_attributes;
+
+  ///
+  /// Write positions, normals and texcoords in the structure-of-arrays
+  /// layout(attrib_t::vertex_x etc., 32-byte aligned and zero padded)
+  /// instead of `vertices`, `normals` and `texcoords`. See
+  /// SplitAttributes(). Progressive chunks(`shape_cb`) stay interleaved.
+  ///
+  bool soa_attributes;
+
+  ///
+  /// Record the offsets of `v`, `vn` and `vt` lines instead of converting
+  /// their numbers(see lazy_attrib_t), for jobs that need the topology or
+  /// only part of the attributes. Used by ParseFromBuffer() and
+  /// ObjTextParser, whose text must then stay alive until it is decoded
+  /// and be fed as consecutive chunks of one buffer; other input is parsed
+  /// eagerly. Polygons to triangulate get their positions decoded during
+  /// the parse. Vertex colors are kept only with `vertex_color`, and
+  /// progressive chunks(`shape_cb`) carry no attribute values.
+  /// `soa_attributes` is ignored; call SplitAttributes() once decoded.
+  /// Decoding is explicit: GetVertex() and the attrib_t arrays return
+  /// zeros until DecodeVertices()/DecodeAttributes()(or decodeShape()/
+  /// decodeAll() in LazyAttributes.h) have decoded the block, so that the
+  /// accessors stay const and safe to call from several threads.
+  ///
+  bool lazy_attributes;
+
+  ///
+  /// Called from the parsing thread after each `mtllib` file is loaded,
+  /// with the materials it added and the directory the .mtl file was found
+  /// in(texture names are relative to it; "" for `mtl_text` input). Lets
+  /// texture loading start while the rest of the .obj is still parsed.
+  ///
+  void (*materials_cb)(void *user_data, const material_t *materials,
+                       size_t num_materials, const char *mtl_dir);
+  void *materials_cb_user_data;
+
   ObjReaderConfig()
-      : triangulate(true), triangulation_method("simple"), vertex_color(true) {}
+      : triangulate(true), triangulation_method("simple"), vertex_color(true),
+        shape_cb(NULL), shape_cb_user_data(NULL), use_transform(false),
+        compact_face_attributes(false), soa_attributes(false),
+        lazy_attributes(false), materials_cb(NULL),
+        materials_cb_user_data(NULL) {
+    for (int i = 0; i < 16; i++) {
+      transform[i] = (i % 5 == 0) ? static_cast<real_t>(1)
+                                  : static_cast<real_t>(0);
+    }
+  }
+};
+
+///
+/// Interned group, object and material names of a parse.
+/// Names are looked up as (pointer, length) views into the parsed text, so
+/// a name that was seen before costs no allocation. Handle 0 is always the
+/// empty name.
+///
+class name_pool_t {
+public:
+  name_pool_t();
+
+  ///
+  /// Returns the handle of `str[0, len)`, adding it when it is new.
+  ///
+  int Intern(const char *str, size_t len);
+
+  ///
+  /// Returns the handle of `str[0, len)` or -1 when it was never interned.
+  ///
+  int Find(const char *str, size_t len) const;
+
+  const std::string &Get(int id) const {
+    return names_[static_cast<size_t>(id)];
+  }
+
+  size_t Size() const { return names_.size(); }
+
+  ///
+  /// Removes all names but the empty one.
+  ///
+  void Clear();
+
+private:
+  size_t FindSlot(const char *str, size_t len, unsigned int hash) const;
+  void Rehash(size_t num_slots);
+
+  std::vector<std::string> names_;
+  std::vector<unsigned int> hashes_;
+  std::vector<int> slots_; // Open addressing table of handles, -1 if empty.
+};
+
+struct parse_scratch_t; // Defined with the implementation.
+
+///
+/// Scratch containers of a parse(attribute arrays, face groups, the shape
+/// being built, the line buffer and the structural index) kept between
+/// parses. A thread that parses many small files back to back with one
+/// context pays only for their content: the containers keep their
+/// capacity and the result is copied out exactly sized. Not thread safe;
+/// hold one per thread.
+///
+class ParseContext {
+public:
+  ///
+  /// @param[in] max_retained_bytes Capacity kept after a parse. A larger
+  /// parse moves its result out as without a context and leaves the
+  /// context empty.
+  ///
+  explicit ParseContext(size_t max_retained_bytes = 64 << 20);
+  ~ParseContext();
+
+  ///
+  /// Frees the retained capacity.
+  ///
+  void Release();
+
+private:
+  friend class ObjTextParser;
+
+  ParseContext(const ParseContext &);
+  ParseContext &operator=(const ParseContext &);
+
+  parse_scratch_t *scratch_;
 };
 
 ///
@@ -551,6 +1068,23 @@ public:
   bool ParseFromString(const std::string &obj_text, const std::string &mtl_text,
                        const ObjReaderConfig &config = ObjReaderConfig());
 
+  ///
+  /// Parse .obj from an in-memory buffer(e.g. mmap'ed or read by io_uring)
+  /// without copying it into a std::string/std::istream.
+  /// Need to supply .mtl text string by `mtl_text`, or leave it empty and
+  /// set `config.mtl_search_path` to read `mtllib` files from there.
+  ///
+  /// @param[in] obj_text wavefront .obj text
+  /// @param[in] obj_len length of `obj_text` in bytes
+  /// @param[in] mtl_text wavefront .mtl text
+  /// @param[in] config Reader configuration
+  /// @param[in] context Scratch containers to reuse(optional)
+  ///
+  bool ParseFromBuffer(const char *obj_text, size_t obj_len,
+                       const std::string &mtl_text,
+                       const ObjReaderConfig &config = ObjReaderConfig(),
+                       ParseContext *context = NULL);
+
   ///
   /// .obj was loaded or parsed correctly.
   ///
@@ -560,8 +1094,20 @@ public:
 
   const std::vector<shape_t> &GetShapes() const { return shapes_; }
 
+  ///
+  /// Mutable access for post-load passes(e.g. reordering, transforms).
+  ///
+  attrib_t &GetAttrib() { return attrib_; }
+
+  std::vector<shape_t> &GetShapes() { return shapes_; }
+
   const std::vector<material_t> &GetMaterials() const { return materials_; }
 
+  ///
+  /// Names referred to by `shape_t::name_id`.
+  ///
+  const name_pool_t &GetNamePool() const { return names_; }
+
   ///
   /// Warning message(may be filled after `Load` or `Parse`)
   ///
@@ -573,16 +1119,119 @@ public:
   const std::string &Error() const { return error_; }
 
 private:
+  friend class ObjTextParser;
+
   bool valid_;
 
   attrib_t attrib_;
   std::vector<shape_t> shapes_;
   std::vector<material_t> materials_;
+  name_pool_t names_;
 
   std::string warning_;
   std::string error_;
 };
 
+///
+/// SIMD kernels of the in-memory parser, selected once from cpuid.
+/// Set `TINYOBJLOADER_ISA` to `scalar`, `sse2`, `avx2` or `avx512` in the
+/// environment to force a lower level(e.g. for testing).
+///
+struct parse_kernels_t {
+  const char *isa; // Name of the selected level.
+
+  /// Writes the offsets of '\n', '\r', ' ', '\t' and '/' in `buf[0, len)`
+  /// to `out`(room for `len` entries) and returns their count.
+  size_t (*find_structurals)(const char *buf, size_t len, unsigned int *out);
+
+  /// Reads up to 16 leading decimal digits of `[s, s_end)` into `value`.
+  /// Returns the number of digits read.
+  size_t (*parse_digits)(const char *s, const char *s_end,
+                         unsigned long long *value);
+
+  /// Replaces the `n` points of `xyz[0, 3 * n)` with `m` times the point.
+  /// `m` is a row-major 3x4 affine matrix.
+  void (*transform_points)(const real_t *m, real_t *xyz, size_t n);
+};
+
+const parse_kernels_t &GetParseKernels();
+
+///
+/// Structural index of .obj text(stage 1 of the in-memory parser).
+/// Byte offsets of every '\n', '\r', ' ', '\t' and '/' in ascending order.
+///
+struct structural_index_t {
+  std::vector<unsigned int> positions; // Only the first `size` are valid.
+  size_t size;
+
+  structural_index_t() : size(0) {}
+};
+
+///
+/// Stage 1: finds the structural characters of `buf[0, len)` 64 bytes at a
+/// time with SIMD compares. `len` must fit in 32 bits.
+///
+void BuildStructuralIndex(const char *buf, size_t len,
+                          structural_index_t *index);
+
+///
+/// Returns the end of a line-aligned chunk of `buf[0, len)` that starts at
+/// `begin` and is about `chunk_size` bytes long: one past the first '\n'
+/// at or after `begin + chunk_size - 1`, or `len`.
+///
+size_t FindChunkEnd(const char *buf, size_t len, size_t begin,
+                    size_t chunk_size);
+
+///
+/// Incremental parser for in-memory .obj text(stage 2).
+/// Feed the text in order as line-aligned chunks(see `FindChunkEnd`), then
+/// call `Finish` to publish the result to `reader`. The structural index
+/// of the next chunk can be built on another thread while the current
+/// one is parsed.
+///
+class ObjTextParser {
+public:
+  ///
+  /// @param[in] reader Receives the result. Must outlive this parser.
+  /// @param[in] mtl_text wavefront .mtl text. When empty and
+  /// `config.mtl_search_path` is set, `mtllib` files are read from there;
+  /// otherwise `mtllib` lines only select this text.
+  /// @param[in] config Reader configuration
+  /// @param[in] context Scratch containers to reuse(optional). Must
+  /// outlive this parser and not be used by another one meanwhile.
+  ///
+  ObjTextParser(ObjReader *reader, const std::string &mtl_text,
+                const ObjReaderConfig &config = ObjReaderConfig(),
+                ParseContext *context = NULL);
+  ~ObjTextParser();
+
+  ///
+  /// Parses a chunk with a structural index built from `buf[0, len)`.
+  /// Returns false on a parse error; later chunks are ignored then.
+  ///
+  bool ParseChunk(const char *buf, size_t len,
+                  const structural_index_t &index);
+
+  ///
+  /// Same as above but builds the structural index itself.
+  ///
+  bool ParseChunk(const char *buf, size_t len);
+
+  ///
+  /// Flushes the last shape and moves the result into the reader.
+  /// Returns `reader->Valid()`.
+  ///
+  bool Finish();
+
+private:
+  ObjTextParser(const ObjTextParser &);
+  ObjTextParser &operator=(const ObjTextParser &);
+
+  struct Impl;
+  Impl *impl_;
+  ObjReader *reader_;
+};
+
 /// ==>>========= Legacy v1 API =============================================
 
 /// Loads .obj from a file.
@@ -624,6 +1273,13 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              MaterialReader *readMatFn = NULL, bool triangulate = true,
              bool default_vcols_fallback = true);
 
+/// Loads object from a std::istream with v2 API reader configuration.
+/// `config.mtl_search_path` is not used; `readMatFn` resolves .mtl files.
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *warn,
+             std::string *err, std::istream *inStream,
+             MaterialReader *readMatFn, const ObjReaderConfig &config);
+
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> *material_map,
              std::vector<material_t> *materials, std::istream *inStream,
@@ -655,10 +1311,26 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <cstring>
 #include <fstream>
 #include <limits>
+#include <new>
 #include <set>
 #include <sstream>
 #include <utility>
 
+// Per-ISA parse kernels are compiled with target attributes and selected
+// at runtime(see GetParseKernels), so no -march flag is needed.
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define TINYOBJLOADER_X86_DISPATCH
+#define TINYOBJLOADER_TARGET(isa) __attribute__((target(isa)))
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define TINYOBJLOADER_X86_DISPATCH
+#define TINYOBJLOADER_TARGET(isa)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
 
 #ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
@@ -685,34 +1357,372 @@ namespace tinyobj {
 
 MaterialReader::~MaterialReader() {}
 
-struct vertex_index_t {
-  int v_idx, vt_idx, vn_idx;
-  vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
-  explicit vertex_index_t(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
-  vertex_index_t(int vidx, int vtidx, int vnidx)
-      : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
-};
+// FNV-1a
+static inline unsigned int hashName(const char *str, size_t len) {
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= static_cast<unsigned char>(str[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
 
-// Internal data structure for face representation
-// index + smoothing group.
-struct face_t {
-  unsigned int
-      smoothing_group_id; // smoothing group id. 0 = smoothing groupd is off.
-  int pad_;
-  std::vector<vertex_index_t> vertex_indices; // face vertex indices.
+name_pool_t::name_pool_t() { Clear(); }
 
-  face_t() : smoothing_group_id(0), pad_(0) {}
-};
+void name_pool_t::Clear() {
+  names_.clear();
+  hashes_.clear();
+  slots_.assign(16, -1);
+  Intern("", 0);
+}
 
-// Internal data structure for line representation
-struct __line_t {
-  // l v1/vt1 v2/vt2 ...
-  // In the specification, line primitrive does not have normal index, but
-  // TinyObjLoader allow it
-  std::vector<vertex_index_t> vertex_indices;
-};
+size_t name_pool_t::FindSlot(const char *str, size_t len,
+                             unsigned int hash) const {
+  const size_t mask = slots_.size() - 1;
+  size_t i = hash & mask;
+  while (slots_[i] >= 0) {
+    const size_t id = static_cast<size_t>(slots_[i]);
+    if (hashes_[id] == hash && names_[id].size() == len &&
+        (len == 0 || memcmp(names_[id].data(), str, len) == 0)) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+  return i;
+}
 
-// Internal data structure for points representation
+void name_pool_t::Rehash(size_t num_slots) {
+  slots_.assign(num_slots, -1);
+  const size_t mask = num_slots - 1;
+  for (size_t id = 0; id < names_.size(); id++) {
+    size_t i = hashes_[id] & mask;
+    while (slots_[i] >= 0) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = static_cast<int>(id);
+  }
+}
+
+int name_pool_t::Intern(const char *str, size_t len) {
+  const unsigned int hash = hashName(str, len);
+  size_t slot = FindSlot(str, len, hash);
+  if (slots_[slot] >= 0) {
+    return slots_[slot];
+  }
+  // Keep the table at most half full.
+  if ((names_.size() + 1) * 2 > slots_.size()) {
+    Rehash(slots_.size() * 2);
+    slot = FindSlot(str, len, hash);
+  }
+  const int id = static_cast<int>(names_.size());
+  names_.push_back(std::string(str, len));
+  hashes_.push_back(hash);
+  slots_[slot] = id;
+  return id;
+}
+
+int name_pool_t::Find(const char *str, size_t len) const {
+  return slots_[FindSlot(str, len, hashName(str, len))];
+}
+
+size_t NumFaces(const mesh_t &mesh) {
+  if (mesh.face_vertex_runs.empty()) {
+    return mesh.num_face_vertices.size();
+  }
+  const face_run_t<unsigned char> &last = mesh.face_vertex_runs.back();
+  return size_t(last.first_face) + last.face_count;
+}
+
+template <typename T>
+static size_t countFaceRuns(const std::vector<T> &values) {
+  size_t n = values.empty() ? 0 : 1;
+  for (size_t i = 1; i < values.size(); i++) {
+    n += values[i] != values[i - 1];
+  }
+  return n;
+}
+
+template <typename T>
+static void makeFaceRuns(const std::vector<T> &values,
+                         std::vector<face_run_t<T> > *runs) {
+  runs->clear();
+  for (size_t i = 0; i < values.size(); i++) {
+    if (runs->empty() || runs->back().value != values[i]) {
+      face_run_t<T> run;
+      run.first_face = static_cast<index_uint_t>(i);
+      run.face_count = 0;
+      run.value = values[i];
+      runs->push_back(run);
+    }
+    runs->back().face_count++;
+  }
+  // Runs are usually few; give back the doubling slack.
+  std::vector<face_run_t<T> >(*runs).swap(*runs);
+}
+
+template <typename T>
+static void expandFaceRuns(const std::vector<face_run_t<T> > &runs,
+                           std::vector<T> *values) {
+  values->clear();
+  for (size_t i = 0; i < runs.size(); i++) {
+    values->insert(values->end(), runs[i].face_count, runs[i].value);
+  }
+}
+
+bool CompactFaceAttributes(mesh_t *mesh) {
+  if (!mesh->face_vertex_runs.empty()) {
+    return true; // already compact
+  }
+  const size_t num_faces = mesh->num_face_vertices.size();
+  if (num_faces == 0 ||
+      num_faces > size_t(std::numeric_limits<index_uint_t>::max())) {
+    return num_faces == 0;
+  }
+  if ((!mesh->material_ids.empty() &&
+       mesh->material_ids.size() != num_faces) ||
+      (!mesh->smoothing_group_ids.empty() &&
+       mesh->smoothing_group_ids.size() != num_faces)) {
+    return false;
+  }
+  // Small or fragmented meshes would grow; they keep one entry per face.
+  const size_t runs_bytes =
+      countFaceRuns(mesh->num_face_vertices) *
+          sizeof(face_run_t<unsigned char>) +
+      countFaceRuns(mesh->material_ids) * sizeof(face_run_t<int>) +
+      countFaceRuns(mesh->smoothing_group_ids) *
+          sizeof(face_run_t<unsigned int>);
+  const size_t array_bytes = num_faces * sizeof(unsigned char) +
+                             mesh->material_ids.size() * sizeof(int) +
+                             mesh->smoothing_group_ids.size() *
+                                 sizeof(unsigned int);
+  if (runs_bytes >= array_bytes) {
+    return true;
+  }
+  makeFaceRuns(mesh->num_face_vertices, &mesh->face_vertex_runs);
+  makeFaceRuns(mesh->material_ids, &mesh->material_runs);
+  makeFaceRuns(mesh->smoothing_group_ids, &mesh->smoothing_group_runs);
+  // Release the per-face storage rather than just clearing it.
+  std::vector<unsigned char>().swap(mesh->num_face_vertices);
+  std::vector<int>().swap(mesh->material_ids);
+  std::vector<unsigned int>().swap(mesh->smoothing_group_ids);
+  return true;
+}
+
+void ExpandFaceAttributes(mesh_t *mesh) {
+  if (mesh->face_vertex_runs.empty()) {
+    return;
+  }
+  expandFaceRuns(mesh->face_vertex_runs, &mesh->num_face_vertices);
+  expandFaceRuns(mesh->material_runs, &mesh->material_ids);
+  expandFaceRuns(mesh->smoothing_group_runs, &mesh->smoothing_group_ids);
+  mesh->face_vertex_runs.clear();
+  mesh->material_runs.clear();
+  mesh->smoothing_group_runs.clear();
+}
+
+aligned_array_t::aligned_array_t(const aligned_array_t &other)
+    : block_(NULL), data_(NULL), size_(0), capacity_(0) {
+  *this = other;
+}
+
+aligned_array_t &aligned_array_t::operator=(const aligned_array_t &other) {
+  if (this != &other) {
+    resize(other.size_);
+    if (size_) {
+      memcpy(data_, other.data_, size_ * sizeof(real_t));
+    }
+  }
+  return *this;
+}
+
+#if __cplusplus >= 201103L
+aligned_array_t::aligned_array_t(aligned_array_t &&other) noexcept
+    : block_(NULL), data_(NULL), size_(0), capacity_(0) {
+  swap(other);
+}
+
+aligned_array_t &aligned_array_t::operator=(aligned_array_t &&other) noexcept {
+  if (this != &other) {
+    // Frees the old block now rather than handing it to `other`.
+    aligned_array_t moved;
+    moved.swap(other);
+    swap(moved);
+  }
+  return *this;
+}
+#endif
+
+aligned_array_t::~aligned_array_t() { free(block_); }
+
+void aligned_array_t::resize(size_t n) {
+  const size_t padded = (n + kPadding - 1) / kPadding * kPadding;
+  if (padded > capacity_) {
+    void *block = malloc(padded * sizeof(real_t) + kAlignment - 1);
+    if (!block) {
+      throw std::bad_alloc();
+    }
+    const size_t misalign =
+        reinterpret_cast<size_t>(block) % size_t(kAlignment);
+    real_t *data = reinterpret_cast<real_t *>(
+        static_cast<char *>(block) +
+        (misalign ? size_t(kAlignment) - misalign : 0));
+    if (size_) {
+      memcpy(data, data_, size_ * sizeof(real_t));
+    }
+    free(block_);
+    block_ = block;
+    data_ = data;
+    capacity_ = padded;
+  }
+  // Zero the new elements when growing and the stale ones when shrinking.
+  const size_t first = n < size_ ? n : size_;
+  if (padded > first) {
+    memset(data_ + first, 0, (padded - first) * sizeof(real_t));
+  }
+  size_ = n;
+}
+
+void aligned_array_t::swap(aligned_array_t &other) {
+  std::swap(block_, other.block_);
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+  std::swap(capacity_, other.capacity_);
+}
+
+// Transposes `tuples`(N reals each) into one array per component.
+// Leaves `components` alone when there are no tuples.
+template <size_t N>
+static void splitTuples(const std::vector<real_t> &tuples,
+                        aligned_array_t *const *components) {
+  const size_t n = tuples.size() / N;
+  if (n == 0) {
+    return;
+  }
+  real_t *dst[N];
+  for (size_t k = 0; k < N; k++) {
+    components[k]->resize(n);
+    dst[k] = components[k]->data();
+  }
+  const real_t *src = &tuples[0];
+  for (size_t i = 0; i < n; i++, src += N) {
+    for (size_t k = 0; k < N; k++) {
+      dst[k][i] = src[k];
+    }
+  }
+}
+
+// Leaves `tuples` alone when the components are empty.
+template <size_t N>
+static void interleaveTuples(aligned_array_t *const *components,
+                             std::vector<real_t> *tuples) {
+  const size_t n = components[0]->size();
+  if (n == 0) {
+    return;
+  }
+  tuples->resize(n * N);
+  real_t *dst = &(*tuples)[0];
+  for (size_t i = 0; i < n; i++, dst += N) {
+    for (size_t k = 0; k < N; k++) {
+      dst[k] = (*components[k])[i];
+    }
+  }
+}
+
+// Releases the structure-of-arrays storage.
+static void clearSplitAttributes(attrib_t *attrib) {
+  aligned_array_t().swap(attrib->vertex_x);
+  aligned_array_t().swap(attrib->vertex_y);
+  aligned_array_t().swap(attrib->vertex_z);
+  aligned_array_t().swap(attrib->normal_x);
+  aligned_array_t().swap(attrib->normal_y);
+  aligned_array_t().swap(attrib->normal_z);
+  aligned_array_t().swap(attrib->texcoord_u);
+  aligned_array_t().swap(attrib->texcoord_v);
+}
+
+// Drops the lines of a lazy parse.
+static void clearLazyAttributes(attrib_t *attrib) {
+  lazy_attrib_t &lazy = attrib->lazy;
+  lazy.text = NULL;
+  lazy.text_len = 0;
+  std::vector<size_t>().swap(lazy.vertex_lines);
+  std::vector<size_t>().swap(lazy.normal_lines);
+  std::vector<size_t>().swap(lazy.texcoord_lines);
+  std::vector<unsigned char>().swap(lazy.vertex_blocks);
+  std::vector<unsigned char>().swap(lazy.normal_blocks);
+  std::vector<unsigned char>().swap(lazy.texcoord_blocks);
+  lazy.use_transform = false;
+  lazy.rescale_normals = false;
+}
+
+// Fills the structure-of-arrays storage of `attrib` from interleaved
+// positions, normals and texcoords; empty ones are skipped.
+static void splitAttributes(const std::vector<real_t> &v,
+                            const std::vector<real_t> &vn,
+                            const std::vector<real_t> &vt,
+                            attrib_t *attrib) {
+  aligned_array_t *const positions[3] = {
+      &attrib->vertex_x, &attrib->vertex_y, &attrib->vertex_z};
+  aligned_array_t *const normals[3] = {
+      &attrib->normal_x, &attrib->normal_y, &attrib->normal_z};
+  aligned_array_t *const texcoords[2] = {&attrib->texcoord_u,
+                                         &attrib->texcoord_v};
+  splitTuples<3>(v, positions);
+  splitTuples<3>(vn, normals);
+  splitTuples<2>(vt, texcoords);
+}
+
+void SplitAttributes(attrib_t *attrib) {
+  // Arrays that are already split are empty on the interleaved side.
+  std::vector<real_t> v, vn, vt;
+  v.swap(attrib->vertices);
+  vn.swap(attrib->normals);
+  vt.swap(attrib->texcoords);
+  splitAttributes(v, vn, vt, attrib);
+}
+
+void InterleaveAttributes(attrib_t *attrib) {
+  aligned_array_t *const positions[3] = {
+      &attrib->vertex_x, &attrib->vertex_y, &attrib->vertex_z};
+  aligned_array_t *const normals[3] = {
+      &attrib->normal_x, &attrib->normal_y, &attrib->normal_z};
+  aligned_array_t *const texcoords[2] = {&attrib->texcoord_u,
+                                         &attrib->texcoord_v};
+  interleaveTuples<3>(positions, &attrib->vertices);
+  interleaveTuples<3>(normals, &attrib->normals);
+  interleaveTuples<2>(texcoords, &attrib->texcoords);
+  clearSplitAttributes(attrib);
+}
+
+struct vertex_index_t {
+  index_int_t v_idx, vt_idx, vn_idx;
+  vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
+  explicit vertex_index_t(index_int_t idx)
+      : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
+  vertex_index_t(int vidx, int vtidx, int vnidx)
+      : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+};
+
+// Internal data structure for face representation
+// index + smoothing group.
+struct face_t {
+  unsigned int
+      smoothing_group_id; // smoothing group id. 0 = smoothing groupd is off.
+  int pad_;
+  std::vector<vertex_index_t> vertex_indices; // face vertex indices.
+
+  face_t() : smoothing_group_id(0), pad_(0) {}
+};
+
+// Internal data structure for line representation
+struct __line_t {
+  // l v1/vt1 v2/vt2 ...
+  // In the specification, line primitrive does not have normal index, but
+  // TinyObjLoader allow it
+  std::vector<vertex_index_t> vertex_indices;
+};
+
+// Internal data structure for points representation
 struct __points_t {
   // p v1 v2 ...
   // In the specification, point primitrive does not have normal index and
@@ -753,6 +1763,52 @@ struct PrimGroup {
   // TODO(syoyo): bspline, surface, ...
 };
 
+// Containers of a parse that a ParseContext keeps between parses.
+// ObjParser and ObjTextParser swap them in when they start and give them
+// back emptied, with their capacity, when they are destroyed.
+struct parse_scratch_t {
+  std::vector<real_t> v;
+  std::vector<real_t> vn;
+  std::vector<real_t> vt;
+  std::vector<real_t> vc;
+  std::vector<skin_weight_t> vw;
+  std::vector<tag_t> tags;
+  PrimGroup prim_group;
+  shape_t shape;
+  std::vector<int> material_by_name;
+  std::string linebuf;
+  structural_index_t index;
+
+  size_t max_bytes; // ParseContext::ParseContext(max_retained_bytes)
+
+  explicit parse_scratch_t(size_t max_retained_bytes)
+      : max_bytes(max_retained_bytes) {}
+};
+
+// Empties `shape` but keeps the capacity of its arrays for the next one.
+static void clearShape(shape_t *shape) {
+  shape->name.clear();
+  shape->name_id = -1;
+  mesh_t &mesh = shape->mesh;
+  mesh.indices.clear();
+  mesh.num_face_vertices.clear();
+  mesh.material_ids.clear();
+  mesh.smoothing_group_ids.clear();
+  mesh.tags.clear();
+  mesh.material_ranges.clear();
+  mesh.face_vertex_runs.clear();
+  mesh.material_runs.clear();
+  mesh.smoothing_group_runs.clear();
+  shape->lines.indices.clear();
+  shape->lines.num_line_vertices.clear();
+  shape->points.indices.clear();
+}
+
+template <typename T>
+static size_t capacityBytes(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
 // See
 // http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
 static std::istream &safeGetline(std::istream &is, std::string &t) {
@@ -808,8 +1864,8 @@ struct warning_context {
 };
 
 // Make index zero-base, and also support relative index.
-static inline bool fixIndex(int idx, int n, int *ret, bool allow_zero,
-                            const warning_context &context) {
+static inline bool fixIndex(index_int_t idx, index_int_t n, index_int_t *ret,
+                            bool allow_zero, const warning_context &context) {
   if (!ret) {
     return false;
   }
@@ -858,6 +1914,15 @@ static inline int parseInt(const char **token) {
   return i;
 }
 
+// atoi() wide enough for index_int_t.
+static inline index_int_t atoidx(const char *s) {
+#ifdef TINYOBJLOADER_USE_INDEX64
+  return strtoll(s, NULL, 10);
+#else
+  return atoi(s);
+#endif
+}
+
 // Tries to parse a floating point number located at s.
 //
 // s_end should be a location in the string where reading should absolutely
@@ -1161,7 +2226,8 @@ static tag_sizes parseTagTriple(const char **token) {
 }
 
 // Parse triples with index offsets: i, i/j/k, i//k, i/j
-static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
+static bool parseTriple(const char **token, index_int_t vsize,
+                        index_int_t vnsize, index_int_t vtsize,
                         vertex_index_t *ret, const warning_context &context) {
   if (!ret) {
     return false;
@@ -1169,7 +2235,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   vertex_index_t vi(-1);
 
-  if (!fixIndex(atoi((*token)), vsize, &vi.v_idx, false, context)) {
+  if (!fixIndex(atoidx((*token)), vsize, &vi.v_idx, false, context)) {
     return false;
   }
 
@@ -1183,7 +2249,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+    if (!fixIndex(atoidx((*token)), vnsize, &vi.vn_idx, true, context)) {
       return false;
     }
     (*token) += strcspn((*token), "/ \t\r");
@@ -1192,7 +2258,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   }
 
   // i/j/k or i/j
-  if (!fixIndex(atoi((*token)), vtsize, &vi.vt_idx, true, context)) {
+  if (!fixIndex(atoidx((*token)), vtsize, &vi.vt_idx, true, context)) {
     return false;
   }
 
@@ -1204,7 +2270,7 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   // i/j/k
   (*token)++; // skip '/'
-  if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+  if (!fixIndex(atoidx((*token)), vnsize, &vi.vn_idx, true, context)) {
     return false;
   }
   (*token) += strcspn((*token), "/ \t\r");
@@ -1216,9 +2282,9 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
 // Parse raw triples: i, i/j/k, i//k, i/j
 static vertex_index_t parseRawTriple(const char **token) {
-  vertex_index_t vi(static_cast<int>(0)); // 0 is an invalid index in OBJ
+  vertex_index_t vi(static_cast<index_int_t>(0)); // 0 is invalid in OBJ
 
-  vi.v_idx = atoi((*token));
+  vi.v_idx = atoidx((*token));
   (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     return vi;
@@ -1228,13 +2294,13 @@ static vertex_index_t parseRawTriple(const char **token) {
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    vi.vn_idx = atoi((*token));
+    vi.vn_idx = atoidx((*token));
     (*token) += strcspn((*token), "/ \t\r");
     return vi;
   }
 
   // i/j/k or i/j
-  vi.vt_idx = atoi((*token));
+  vi.vt_idx = atoidx((*token));
   (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     return vi;
@@ -1242,7 +2308,7 @@ static vertex_index_t parseRawTriple(const char **token) {
 
   // i/j/k
   (*token)++; // skip '/'
-  vi.vn_idx = atoi((*token));
+  vi.vn_idx = atoidx((*token));
   (*token) += strcspn((*token), "/ \t\r");
   return vi;
 }
@@ -1457,14 +2523,16 @@ inline TinyObjPoint WorldToLocal(const TinyObjPoint &a, const TinyObjPoint &u,
 // TODO(syoyo): refactor function.
 static bool exportGroupsToShape(shape_t *shape, const PrimGroup &prim_group,
                                 const std::vector<tag_t> &tags,
-                                const int material_id, const std::string &name,
-                                bool triangulate, const std::vector<real_t> &v,
+                                const int material_id, const name_pool_t &names,
+                                int name_id, bool triangulate,
+                                const std::vector<real_t> &v,
                                 std::string *warn) {
   if (prim_group.IsEmpty()) {
     return false;
   }
 
-  shape->name = name;
+  shape->name = names.Get(name_id);
+  shape->name_id = name_id;
 
   // polygon
   if (!prim_group.faceGroup.empty()) {
@@ -2042,6 +3110,12 @@ static std::string JoinPath(const std::string &dir,
   }
 }
 
+// "dir/a.mtl" -> "dir", "a.mtl" -> "".
+static std::string DirName(const std::string &path) {
+  const size_t pos = path.find_last_of("/\\");
+  return pos == std::string::npos ? std::string() : path.substr(0, pos);
+}
+
 void LoadMtl(std::map<std::string, int> *material_map,
              std::vector<material_t> *materials, std::istream *inStream,
              std::string *warning, std::string *err) {
@@ -2470,6 +3544,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
       std::ifstream matIStream(filepath.c_str());
       if (matIStream) {
         LoadMtl(matMap, materials, &matIStream, warn, err);
+        m_lastDir = DirName(filepath);
 
         return true;
       }
@@ -2488,6 +3563,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
     std::ifstream matIStream(filepath.c_str());
     if (matIStream) {
       LoadMtl(matMap, materials, &matIStream, warn, err);
+      m_lastDir = DirName(filepath);
 
       return true;
     }
@@ -2523,6 +3599,82 @@ bool MaterialStreamReader::operator()(const std::string &matId,
   return true;
 }
 
+// Attribute counts already handed out through `ObjReaderConfig::shape_cb`.
+struct progressive_state {
+  size_t num_vertices;
+  size_t num_normals;
+  size_t num_texcoords;
+
+  progressive_state() : num_vertices(0), num_normals(0), num_texcoords(0) {}
+};
+
+static void updateRange(index_int_t *range, index_int_t idx) {
+  if (idx < 0) {
+    return;
+  }
+  if (range[0] < 0 || idx < range[0]) {
+    range[0] = idx;
+  }
+  if (idx > range[1]) {
+    range[1] = idx;
+  }
+}
+
+static void updateRanges(shape_chunk_t *chunk,
+                         const std::vector<index_t> &indices) {
+  for (size_t i = 0; i < indices.size(); i++) {
+    updateRange(chunk->vertex_range, indices[i].vertex_index);
+    updateRange(chunk->normal_range, indices[i].normal_index);
+    updateRange(chunk->texcoord_range, indices[i].texcoord_index);
+  }
+}
+
+static void publishShape(const ObjReaderConfig &config, const shape_t &shape,
+                         size_t shape_index, const std::vector<real_t> &v,
+                         const std::vector<real_t> &vn,
+                         const std::vector<real_t> &vt,
+                         const std::vector<real_t> &vc, bool lazy,
+                         progressive_state *state) {
+  if (!config.shape_cb) {
+    return;
+  }
+
+  shape_chunk_t chunk;
+  chunk.shape = &shape;
+  chunk.shape_index = shape_index;
+
+  chunk.vertex_offset = state->num_vertices;
+  chunk.num_vertices = v.size() / 3 - state->num_vertices;
+  chunk.vertices = chunk.num_vertices ? &v[chunk.vertex_offset * 3] : NULL;
+  chunk.colors = (vc.size() == v.size() && chunk.num_vertices)
+                     ? &vc[chunk.vertex_offset * 3]
+                     : NULL;
+  chunk.normal_offset = state->num_normals;
+  chunk.num_normals = vn.size() / 3 - state->num_normals;
+  chunk.normals = chunk.num_normals ? &vn[chunk.normal_offset * 3] : NULL;
+  chunk.texcoord_offset = state->num_texcoords;
+  chunk.num_texcoords = vt.size() / 2 - state->num_texcoords;
+  chunk.texcoords =
+      chunk.num_texcoords ? &vt[chunk.texcoord_offset * 2] : NULL;
+  if (lazy) {
+    // Only zeros so far.
+    chunk.vertices = chunk.colors = chunk.normals = chunk.texcoords = NULL;
+  }
+
+  chunk.vertex_range[0] = chunk.vertex_range[1] = -1;
+  chunk.normal_range[0] = chunk.normal_range[1] = -1;
+  chunk.texcoord_range[0] = chunk.texcoord_range[1] = -1;
+  updateRanges(&chunk, shape.mesh.indices);
+  updateRanges(&chunk, shape.lines.indices);
+  updateRanges(&chunk, shape.points.indices);
+
+  config.shape_cb(config.shape_cb_user_data, chunk);
+
+  state->num_vertices = v.size() / 3;
+  state->num_normals = vn.size() / 3;
+  state->num_texcoords = vt.size() / 2;
+}
+
 bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              std::vector<material_t> *materials, std::string *warn,
              std::string *err, const char *filename, const char *mtl_basedir,
@@ -2565,106 +3717,978 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              std::string *err, std::istream *inStream,
              MaterialReader *readMatFn /*= NULL*/, bool triangulate,
              bool default_vcols_fallback) {
-  std::stringstream errss;
-
-  std::vector<real_t> v;
-  std::vector<real_t> vn;
-  std::vector<real_t> vt;
-  std::vector<real_t> vc;
-  std::vector<skin_weight_t> vw;
-  std::vector<tag_t> tags;
-  PrimGroup prim_group;
-  std::string name;
+  ObjReaderConfig config;
+  config.triangulate = triangulate;
+  config.vertex_color = default_vcols_fallback;
 
-  // material
-  std::set<std::string> material_filenames;
-  std::map<std::string, int> material_map;
-  int material = -1;
+  return LoadObj(attrib, shapes, materials, warn, err, inStream, readMatFn,
+                 config);
+}
 
-  // smoothing group id
-  unsigned int current_smoothing_id = 0; // Initial value. 0 means no smoothing.
+static inline unsigned int countTrailingZeros64(unsigned long long x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long idx;
+  _BitScanForward64(&idx, x);
+  return static_cast<unsigned int>(idx);
+#elif defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned int>(__builtin_ctzll(x));
+#else
+  unsigned int n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
 
-  int greatest_v_idx = -1;
-  int greatest_vn_idx = -1;
-  int greatest_vt_idx = -1;
+// Appends the offsets of the set bits of `mask` to `out`.
+static inline size_t flattenStructurals(unsigned long long mask, size_t base,
+                                        unsigned int *out, size_t count) {
+  while (mask) {
+    out[count++] = static_cast<unsigned int>(base + countTrailingZeros64(mask));
+    mask &= mask - 1;
+  }
+  return count;
+}
 
-  shape_t shape;
+// Without SIMD every position is written and the count advances only for
+// structural characters, which avoids a branch per byte.
+static size_t findStructuralsScalar(const char *buf, size_t len,
+                                    unsigned int *out) {
+  static const struct structural_table_t {
+    unsigned char is_structural[256];
+    structural_table_t() {
+      memset(is_structural, 0, sizeof(is_structural));
+      is_structural[static_cast<unsigned char>('\n')] = 1;
+      is_structural[static_cast<unsigned char>('\r')] = 1;
+      is_structural[static_cast<unsigned char>(' ')] = 1;
+      is_structural[static_cast<unsigned char>('\t')] = 1;
+      is_structural[static_cast<unsigned char>('/')] = 1;
+    }
+  } table;
 
-  bool found_all_colors = true;
+  if (len == 0) {
+    return 0;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i + 1 < len; i++) {
+    out[count] = static_cast<unsigned int>(i);
+    count += table.is_structural[static_cast<unsigned char>(buf[i])];
+  }
+  // The last entry must not be written unless it is structural.
+  if (table.is_structural[static_cast<unsigned char>(buf[len - 1])]) {
+    out[count++] = static_cast<unsigned int>(len - 1);
+  }
+  return count;
+}
 
-  size_t line_num = 0;
-  std::string linebuf;
-  while (inStream->peek() != -1) {
-    safeGetline(*inStream, linebuf);
+static inline bool isEightDigits(unsigned long long v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
 
-    line_num++;
+// Converts 8 digit characters(little endian load) with 3 multiplications.
+static inline unsigned int parseEightDigits(unsigned long long v) {
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+       (((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >>
+      32;
+  return static_cast<unsigned int>(v);
+}
 
-    // Trim newline '\r\n' or '\n'
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
-    }
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
-    }
+static size_t parseDigitsScalar(const char *s, const char *s_end,
+                                unsigned long long *value) {
+  const size_t limit =
+      static_cast<size_t>(s_end - s) < 16 ? static_cast<size_t>(s_end - s) : 16;
+  unsigned long long v = 0;
+  size_t n = 0;
+  unsigned long long word;
+  while (n + 8 <= limit &&
+         (memcpy(&word, s + n, 8), isEightDigits(word))) {
+    v = v * 100000000ULL + parseEightDigits(word);
+    n += 8;
+  }
+  while (n < limit && IS_DIGIT(s[n])) {
+    v = v * 10 + static_cast<unsigned long long>(s[n] - '0');
+    n++;
+  }
+  (*value) = v;
+  return n;
+}
 
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
-    }
+static void transformPointsScalar(const real_t *m, real_t *xyz, size_t n) {
+  for (size_t i = 0; i < n; i++, xyz += 3) {
+    const real_t x = xyz[0];
+    const real_t y = xyz[1];
+    const real_t z = xyz[2];
+    xyz[0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+    xyz[1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+    xyz[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+  }
+}
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
+#ifdef TINYOBJLOADER_X86_DISPATCH
+
+TINYOBJLOADER_TARGET("sse2")
+static inline unsigned long long structuralMask64SSE2(const char *p) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i sp = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i slash = _mm_set1_epi8('/');
+  unsigned long long mask = 0;
+  for (int i = 0; i < 4; i++) {
+    const __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+    const __m128i eol =
+        _mm_or_si128(_mm_cmpeq_epi8(b, nl), _mm_cmpeq_epi8(b, cr));
+    const __m128i blank =
+        _mm_or_si128(_mm_cmpeq_epi8(b, sp), _mm_cmpeq_epi8(b, tab));
+    const __m128i m =
+        _mm_or_si128(_mm_or_si128(eol, blank), _mm_cmpeq_epi8(b, slash));
+    const unsigned int bits = static_cast<unsigned int>(_mm_movemask_epi8(m));
+    mask |= static_cast<unsigned long long>(bits) << (16 * i);
+  }
+  return mask;
+}
 
-    assert(token);
-    if (token[0] == '\0')
-      continue; // empty line
+TINYOBJLOADER_TARGET("sse2")
+static size_t findStructuralsSSE2(const char *buf, size_t len,
+                                  unsigned int *out) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) {
+    count = flattenStructurals(structuralMask64SSE2(buf + i), i, out, count);
+  }
+  if (i < len) {
+    char tail[64] = {0};
+    memcpy(tail, buf + i, len - i);
+    count = flattenStructurals(structuralMask64SSE2(tail), i, out, count);
+  }
+  return count;
+}
 
-    if (token[0] == '#')
-      continue; // comment line
+// Counts the leading digits with one compare; the value is accumulated
+// with the scalar code.
+TINYOBJLOADER_TARGET("sse2")
+static size_t parseDigitsSSE2(const char *s, const char *s_end,
+                              unsigned long long *value) {
+  if (s_end - s < 16) {
+    return parseDigitsScalar(s, s_end, value);
+  }
+  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+  const __m128i t = _mm_sub_epi8(b, _mm_set1_epi8('0'));
+  const __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(9)), t);
+  const unsigned int non_digits =
+      ~static_cast<unsigned int>(_mm_movemask_epi8(is_digit));
+  const size_t n = countTrailingZeros64(non_digits);
+  unsigned long long v = 0;
+  for (size_t i = 0; i < n; i++) {
+    v = v * 10 + static_cast<unsigned long long>(s[i] - '0');
+  }
+  (*value) = v;
+  return n;
+}
 
-    // vertex
-    if (token[0] == 'v' && IS_SPACE((token[1]))) {
-      token += 2;
-      real_t x, y, z;
-      real_t r, g, b;
+#ifndef TINYOBJLOADER_USE_DOUBLE
+// Four points at a time: the 12 floats are transposed into x, y and z
+// vectors, transformed and transposed back.
+TINYOBJLOADER_TARGET("sse2")
+static void transformPointsSSE2(const float *m, float *xyz, size_t n) {
+  __m128 r[12];
+  for (int k = 0; k < 12; k++) {
+    r[k] = _mm_set1_ps(m[k]);
+  }
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4, xyz += 12) {
+    // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    const __m128 a = _mm_loadu_ps(xyz);
+    const __m128 b = _mm_loadu_ps(xyz + 4);
+    const __m128 c = _mm_loadu_ps(xyz + 8);
+    const __m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m128 y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    const __m128 z01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 z23 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+    const __m128 x = _mm_shuffle_ps(a, x23, _MM_SHUFFLE(2, 0, 3, 0));
+    const __m128 y = _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0));
+
+    __m128 t[3];
+    for (int k = 0; k < 3; k++) {
+      const __m128 xy = _mm_add_ps(_mm_mul_ps(r[4 * k], x),
+                                   _mm_mul_ps(r[4 * k + 1], y));
+      t[k] = _mm_add_ps(_mm_add_ps(xy, _mm_mul_ps(r[4 * k + 2], z)),
+                        r[4 * k + 3]);
+    }
 
-      found_all_colors &= parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+    const __m128 s0 = _mm_shuffle_ps(t[0], t[1], _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 s1 = _mm_shuffle_ps(t[2], t[0], _MM_SHUFFLE(1, 1, 0, 0));
+    const __m128 s2 = _mm_shuffle_ps(t[1], t[2], _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 s3 = _mm_shuffle_ps(t[0], t[1], _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 s4 = _mm_shuffle_ps(t[2], t[0], _MM_SHUFFLE(3, 3, 2, 2));
+    const __m128 s5 = _mm_shuffle_ps(t[1], t[2], _MM_SHUFFLE(3, 3, 3, 3));
+    _mm_storeu_ps(xyz, _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(xyz + 4, _mm_shuffle_ps(s2, s3, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(xyz + 8, _mm_shuffle_ps(s4, s5, _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+  transformPointsScalar(m, xyz, n - i);
+}
+#endif // TINYOBJLOADER_USE_DOUBLE
+
+TINYOBJLOADER_TARGET("avx2")
+static inline unsigned long long structuralMask64AVX2(const char *p) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i sp = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i slash = _mm256_set1_epi8('/');
+  unsigned long long mask = 0;
+  for (int i = 0; i < 2; i++) {
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i));
+    const __m256i eol =
+        _mm256_or_si256(_mm256_cmpeq_epi8(b, nl), _mm256_cmpeq_epi8(b, cr));
+    const __m256i blank =
+        _mm256_or_si256(_mm256_cmpeq_epi8(b, sp), _mm256_cmpeq_epi8(b, tab));
+    const __m256i m = _mm256_or_si256(_mm256_or_si256(eol, blank),
+                                      _mm256_cmpeq_epi8(b, slash));
+    const unsigned int bits =
+        static_cast<unsigned int>(_mm256_movemask_epi8(m));
+    mask |= static_cast<unsigned long long>(bits) << (32 * i);
+  }
+  return mask;
+}
 
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
+TINYOBJLOADER_TARGET("avx2")
+static size_t findStructuralsAVX2(const char *buf, size_t len,
+                                  unsigned int *out) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) {
+    count = flattenStructurals(structuralMask64AVX2(buf + i), i, out, count);
+  }
+  if (i < len) {
+    char tail[64] = {0};
+    memcpy(tail, buf + i, len - i);
+    count = flattenStructurals(structuralMask64AVX2(tail), i, out, count);
+  }
+  return count;
+}
 
-      if (found_all_colors || default_vcols_fallback) {
-        vc.push_back(r);
-        vc.push_back(g);
-        vc.push_back(b);
+// Right-aligns the leading digits with pshufb and converts up to 16 of
+// them with multiply-adds(pairs, quads, then octets).
+TINYOBJLOADER_TARGET("avx2")
+static size_t parseDigitsAVX2(const char *s, const char *s_end,
+                              unsigned long long *value) {
+  if (s_end - s < 16) {
+    return parseDigitsScalar(s, s_end, value);
+  }
+  // shuffle[n]: digit i moves to lane 16 - n + i, other lanes become 0.
+  static const struct shuffle_table_t {
+    signed char lanes[17][16];
+    shuffle_table_t() {
+      for (int n = 0; n <= 16; n++) {
+        for (int i = 0; i < 16; i++) {
+          const int src = i - (16 - n);
+          lanes[n][i] = static_cast<signed char>(src >= 0 ? src : -128);
+        }
       }
-
-      continue;
     }
+  } shuffle;
+
+  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+  const __m128i t = _mm_sub_epi8(b, _mm_set1_epi8('0'));
+  const __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(9)), t);
+  const unsigned int non_digits =
+      ~static_cast<unsigned int>(_mm_movemask_epi8(is_digit));
+  const size_t n = countTrailingZeros64(non_digits);
+
+  const __m128i digits = _mm_shuffle_epi8(
+      t, _mm_loadu_si128(
+             reinterpret_cast<const __m128i *>(shuffle.lanes[n])));
+  const __m128i pairs = _mm_maddubs_epi16(
+      digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+                            10, 1));
+  const __m128i quads = _mm_madd_epi16(
+      pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  const __m128i packed = _mm_packus_epi32(quads, quads);
+  const __m128i octets = _mm_madd_epi16(
+      packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+  const unsigned long long hi =
+      static_cast<unsigned int>(_mm_cvtsi128_si32(octets));
+  const unsigned long long lo =
+      static_cast<unsigned int>(_mm_extract_epi32(octets, 1));
+  (*value) = hi * 100000000ULL + lo;
+  return n;
+}
 
-    // normal
-    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-      token += 3;
-      real_t x, y, z;
-      parseReal3(&x, &y, &z, &token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
-      continue;
-    }
+TINYOBJLOADER_TARGET("avx512f,avx512bw")
+static size_t findStructuralsAVX512(const char *buf, size_t len,
+                                    unsigned int *out) {
+  const __m512i nl = _mm512_set1_epi8('\n');
+  const __m512i cr = _mm512_set1_epi8('\r');
+  const __m512i sp = _mm512_set1_epi8(' ');
+  const __m512i tab = _mm512_set1_epi8('\t');
+  const __m512i slash = _mm512_set1_epi8('/');
+  size_t count = 0;
+  for (size_t i = 0; i < len; i += 64) {
+    // Masked load: bytes past the end read as 0, which is not structural.
+    const __mmask64 valid =
+        len - i >= 64 ? ~0ULL : (1ULL << (len - i)) - 1;
+    const __m512i b = _mm512_maskz_loadu_epi8(valid, buf + i);
+    const unsigned long long mask =
+        _mm512_cmpeq_epi8_mask(b, nl) | _mm512_cmpeq_epi8_mask(b, cr) |
+        _mm512_cmpeq_epi8_mask(b, sp) | _mm512_cmpeq_epi8_mask(b, tab) |
+        _mm512_cmpeq_epi8_mask(b, slash);
+    count = flattenStructurals(mask, i, out, count);
+  }
+  return count;
+}
 
-    // texcoord
+static void cpuidCount(unsigned int leaf, unsigned int subleaf,
+                       unsigned int regs[4]) {
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; i++) {
+    regs[i] = static_cast<unsigned int>(r[i]);
+  }
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches(XCR0).
+static unsigned long long readXcr0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+#endif // TINYOBJLOADER_X86_DISPATCH
+
+enum isa_level_t {
+  ISA_SCALAR = 0,
+  ISA_SSE2,
+  ISA_AVX2, // also requires SSSE3 and SSE4.1
+  ISA_AVX512
+};
+
+static const char *const kIsaNames[] = {"scalar", "sse2", "avx2", "avx512"};
+
+static isa_level_t detectIsaLevel() {
+#ifdef TINYOBJLOADER_X86_DISPATCH
+  unsigned int regs[4];
+  cpuidCount(0, 0, regs);
+  const unsigned int max_leaf = regs[0];
+
+  cpuidCount(1, 0, regs);
+  const bool sse2 = (regs[3] >> 26) & 1;
+  const bool ssse3 = (regs[2] >> 9) & 1;
+  const bool sse41 = (regs[2] >> 19) & 1;
+  const bool osxsave = (regs[2] >> 27) & 1;
+  const bool avx = (regs[2] >> 28) & 1;
+  if (!sse2) {
+    return ISA_SCALAR;
+  }
+  if (!osxsave || !avx || !ssse3 || !sse41 || max_leaf < 7) {
+    return ISA_SSE2;
+  }
+  // The OS must save the YMM(and for AVX-512 the ZMM and mask) registers.
+  const unsigned long long xcr0 = readXcr0();
+  if ((xcr0 & 0x6) != 0x6) {
+    return ISA_SSE2;
+  }
+  cpuidCount(7, 0, regs);
+  const bool avx2 = (regs[1] >> 5) & 1;
+  const bool avx512f = (regs[1] >> 16) & 1;
+  const bool avx512bw = (regs[1] >> 30) & 1;
+  if (!avx2) {
+    return ISA_SSE2;
+  }
+  if (avx512f && avx512bw && (xcr0 & 0xE6) == 0xE6) {
+    return ISA_AVX512;
+  }
+  return ISA_AVX2;
+#else
+  return ISA_SCALAR;
+#endif
+}
+
+static parse_kernels_t makeParseKernels() {
+  isa_level_t level = detectIsaLevel();
+
+  // Testing aid: force a lower level. Levels the CPU lacks are ignored.
+  const char *forced = getenv("TINYOBJLOADER_ISA");
+  if (forced) {
+    for (int i = ISA_SCALAR; i <= ISA_AVX512; i++) {
+      if (strcmp(forced, kIsaNames[i]) == 0 && i < level) {
+        level = static_cast<isa_level_t>(i);
+      }
+    }
+  }
+
+  parse_kernels_t kernels;
+  kernels.isa = kIsaNames[level];
+  kernels.find_structurals = findStructuralsScalar;
+  kernels.parse_digits = parseDigitsScalar;
+  kernels.transform_points = transformPointsScalar;
+#ifdef TINYOBJLOADER_X86_DISPATCH
+#ifndef TINYOBJLOADER_USE_DOUBLE
+  // xyz triples do not fill wider registers; SSE2 serves every level.
+  if (level >= ISA_SSE2) {
+    kernels.transform_points = transformPointsSSE2;
+  }
+#endif
+  switch (level) {
+  case ISA_AVX512:
+    kernels.find_structurals = findStructuralsAVX512;
+    // A single number fits in 16 bytes; wider registers do not help.
+    kernels.parse_digits = parseDigitsAVX2;
+    break;
+  case ISA_AVX2:
+    kernels.find_structurals = findStructuralsAVX2;
+    kernels.parse_digits = parseDigitsAVX2;
+    break;
+  case ISA_SSE2:
+    kernels.find_structurals = findStructuralsSSE2;
+    kernels.parse_digits = parseDigitsSSE2;
+    break;
+  default:
+    break;
+  }
+#endif
+  return kernels;
+}
+
+const parse_kernels_t &GetParseKernels() {
+  static const parse_kernels_t kernels = makeParseKernels();
+  return kernels;
+}
+
+void BuildStructuralIndex(const char *buf, size_t len,
+                          structural_index_t *index) {
+  assert(len <= static_cast<size_t>(std::numeric_limits<unsigned int>::max()));
+
+  // There are at most `len` structural characters. Never shrink so that a
+  // reused index does not reallocate.
+  if (index->positions.size() < len) {
+    index->positions.resize(len);
+  }
+  if (len == 0) {
+    index->size = 0;
+    return;
+  }
+  index->size = GetParseKernels().find_structurals(buf, len,
+                                                   &index->positions[0]);
+}
+
+size_t FindChunkEnd(const char *buf, size_t len, size_t begin,
+                    size_t chunk_size) {
+  size_t from = begin + (chunk_size > 0 ? chunk_size - 1 : 0);
+  if (from >= len) {
+    return len;
+  }
+  const void *nl = memchr(buf + from, '\n', len - from);
+  if (!nl) {
+    return len;
+  }
+  return static_cast<size_t>(static_cast<const char *>(nl) - buf) + 1;
+}
+
+// A field of a line split at the structural characters.
+struct line_field_t {
+  const char *begin;
+  const char *end;
+  char sep; // Character after the field('\n' for the last one).
+};
+
+// Lines with more fields go through ObjParser::ParseLine().
+static const size_t kMaxLineFields = 64;
+
+// Longest index parseIndexField() converts itself. 9 digits always fit in
+// an int; the digit kernel reads at most 16.
+#ifdef TINYOBJLOADER_USE_INDEX64
+static const size_t kMaxIndexDigits = 16;
+#else
+static const size_t kMaxIndexDigits = 9;
+#endif
+
+// Parses a whole field as a decimal index the way atoi() would. Fails for
+// anything else(or more than kMaxIndexDigits digits) so that the caller
+// can fall back.
+// Long indices go through the digit kernel, which may read up to `limit`
+// (the end of the buffer); short ones are cheaper to convert inline.
+static inline bool parseIndexField(const line_field_t &field,
+                                   const char *limit,
+                                   const parse_kernels_t &kernels,
+                                   index_int_t *out) {
+  const char *s = field.begin;
+  bool negative = false;
+  if (s < field.end && (*s == '+' || *s == '-')) {
+    negative = (*s == '-');
+    s++;
+  }
+  const size_t len = static_cast<size_t>(field.end - s);
+  if (len == 0 || len > kMaxIndexDigits) {
+    return false;
+  }
+  index_int_t value = 0;
+  if (len >= 8) {
+    unsigned long long digits;
+    if (kernels.parse_digits(s, limit, &digits) != len) {
+      return false;
+    }
+    value = static_cast<index_int_t>(digits);
+  } else {
+    for (; s < field.end; s++) {
+      if (!IS_DIGIT(*s)) {
+        return false;
+      }
+      value = value * 10 + (*s - '0');
+    }
+  }
+  (*out) = negative ? -value : value;
+  return true;
+}
+
+// Same as parseReal(token, default_value) for the i-th field.
+static inline real_t parseRealField(const line_field_t *fields,
+                                    size_t num_fields, size_t i,
+                                    double default_value = 0.0) {
+  double val = default_value;
+  if (i < num_fields) {
+    tryParseDouble(fields[i].begin, fields[i].end, &val);
+  }
+  return static_cast<real_t>(val);
+}
+
+// Same as parseReal(token, out) for the i-th field.
+static inline bool parseRealField(const line_field_t *fields,
+                                  size_t num_fields, size_t i, real_t *out) {
+  double val;
+  if (i >= num_fields ||
+      !tryParseDouble(fields[i].begin, fields[i].end, &val)) {
+    return false;
+  }
+  (*out) = static_cast<real_t>(val);
+  return true;
+}
+
+// Splits ObjReaderConfig::transform(column-major 4x4) into the row-major
+// 3x4 matrices for points and normals. The normal matrix is the inverse
+// transpose of the upper 3x3. When that is a rotation times a uniform
+// scale, the scale is divided out so that normals keep their length
+// without per-normal work; otherwise `*rescale_normals` is set.
+static void makeAttribTransforms(const real_t *transform, real_t *point_m,
+                                 real_t *normal_m, bool *rescale_normals) {
+  double a[3][3];
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      a[r][c] = static_cast<double>(transform[c * 4 + r]);
+      point_m[r * 4 + c] = transform[c * 4 + r];
+    }
+    point_m[r * 4 + 3] = transform[12 + r];
+  }
+
+  // Cofactors; inverse transpose = cofactor / det.
+  double n[3][3];
+  for (int r = 0; r < 3; r++) {
+    const int r1 = (r + 1) % 3;
+    const int r2 = (r + 2) % 3;
+    for (int c = 0; c < 3; c++) {
+      const int c1 = (c + 1) % 3;
+      const int c2 = (c + 2) % 3;
+      n[r][c] = a[r1][c1] * a[r2][c2] - a[r1][c2] * a[r2][c1];
+    }
+  }
+  const double det = a[0][0] * n[0][0] + a[0][1] * n[0][1] + a[0][2] * n[0][2];
+
+  // A = s * R  <=>  A^T A = s^2 I, and then cofactor / det = R / s.
+  double gram[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      gram[i][j] = a[0][i] * a[0][j] + a[1][i] * a[1][j] + a[2][i] * a[2][j];
+    }
+  }
+  const double s2 = (gram[0][0] + gram[1][1] + gram[2][2]) / 3.0;
+  bool conformal = det != 0.0;
+  for (int i = 0; i < 3 && conformal; i++) {
+    for (int j = 0; j < 3; j++) {
+      const double expected = (i == j) ? s2 : 0.0;
+      if (std::fabs(gram[i][j] - expected) > 1e-6 * s2) {
+        conformal = false;
+        break;
+      }
+    }
+  }
+
+  // Degenerate(det = 0): the cofactors still give the normal direction.
+  double scale = 1.0;
+  if (conformal) {
+    scale = std::sqrt(s2) / det;
+  } else if (det != 0.0) {
+    scale = 1.0 / det;
+  }
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      normal_m[r * 4 + c] = static_cast<real_t>(n[r][c] * scale);
+    }
+    normal_m[r * 4 + 3] = static_cast<real_t>(0);
+  }
+  (*rescale_normals) = !conformal;
+}
+
+// Normals through a general normal matrix `m`, each keeping its length.
+static void transformNormalsRescaled(const real_t *m, real_t *xyz,
+                                     size_t n) {
+  for (size_t i = 0; i < n; i++, xyz += 3) {
+    const double x = xyz[0];
+    const double y = xyz[1];
+    const double z = xyz[2];
+    const double tx = m[0] * x + m[1] * y + m[2] * z;
+    const double ty = m[4] * x + m[5] * y + m[6] * z;
+    const double tz = m[8] * x + m[9] * y + m[10] * z;
+    const double len2 = tx * tx + ty * ty + tz * tz;
+    const double f = len2 > 0.0 ? std::sqrt((x * x + y * y + z * z) / len2)
+                                : 0.0;
+    xyz[0] = static_cast<real_t>(tx * f);
+    xyz[1] = static_cast<real_t>(ty * f);
+    xyz[2] = static_cast<real_t>(tz * f);
+  }
+}
+
+enum lazy_line_t { LAZY_VERTEX, LAZY_NORMAL, LAZY_TEXCOORD };
+
+// Splits the line at `begin` into fields the way ParseIndexed() does and
+// decodes them like ParseFields(). Returns false for the lines
+// ParseIndexed() hands to ParseLine()(a '/' or too many fields).
+static bool decodeLazyFields(const char *begin, const char *text_end,
+                             lazy_line_t kind, real_t *values) {
+  const size_t kMaxFields = 8;
+  line_field_t fields[kMaxFields];
+  size_t num_fields = 0;
+  const char *p = begin;
+  for (;;) {
+    while (p < text_end && (*p == ' ' || *p == '\t')) {
+      p++;
+    }
+    if (p == text_end || *p == '\n' || *p == '\r') {
+      break;
+    }
+    const char *field_begin = p;
+    while (p < text_end && *p != ' ' && *p != '\t' && *p != '\n' &&
+           *p != '\r') {
+      if (*p == '/') {
+        return false;
+      }
+      p++;
+    }
+    if (num_fields < kMaxFields) {
+      line_field_t field = {field_begin, p, p < text_end ? *p : '\n'};
+      fields[num_fields] = field;
+    }
+    num_fields++;
+  }
+  if (num_fields > kMaxLineFields) {
+    return false;
+  }
+  // Only the first fields are used.
+  num_fields = (std::min)(num_fields, kMaxFields);
+  if (kind == LAZY_VERTEX) {
+    values[0] = parseRealField(fields, num_fields, 1);
+    values[1] = parseRealField(fields, num_fields, 2);
+    values[2] = parseRealField(fields, num_fields, 3);
+    if (!parseRealField(fields, num_fields, 4, &values[3]) ||
+        !parseRealField(fields, num_fields, 5, &values[4]) ||
+        !parseRealField(fields, num_fields, 6, &values[5])) {
+      values[3] = values[4] = values[5] = static_cast<real_t>(1.0);
+    }
+  } else if (kind == LAZY_NORMAL) {
+    values[0] = parseRealField(fields, num_fields, 1);
+    values[1] = parseRealField(fields, num_fields, 2);
+    values[2] = parseRealField(fields, num_fields, 3);
+  } else {
+    values[0] = parseRealField(fields, num_fields, 1);
+    values[1] = parseRealField(fields, num_fields, 2);
+  }
+  return true;
+}
+
+// Decodes the `kind` line at `lazy.text[offset]` with the parser that
+// read it: xyz and rgb(1 when absent) for `v`, xyz for `vn` and uv for
+// `vt`.
+static void decodeLazyLine(const lazy_attrib_t &lazy, size_t offset,
+                           lazy_line_t kind, real_t *values) {
+  const char *begin = lazy.text + offset;
+  const char *text_end = lazy.text + lazy.text_len;
+  if (decodeLazyFields(begin, text_end, kind, values)) {
+    return;
+  }
+  const char *end = begin;
+  while (end < text_end && *end != '\n' && *end != '\r') {
+    end++;
+  }
+  // The parse functions want a NUL terminated line.
+  char local[256];
+  std::string long_line;
+  const size_t len = static_cast<size_t>(end - begin);
+  const char *line = local;
+  if (len < sizeof(local)) {
+    memcpy(local, begin, len);
+    local[len] = '\0';
+  } else {
+    long_line.assign(begin, len);
+    line = long_line.c_str();
+  }
+
+  const char *token = line + strspn(line, " \t");
+  if (kind == LAZY_VERTEX) {
+    token += 2;
+    parseVertexWithColor(&values[0], &values[1], &values[2], &values[3],
+                         &values[4], &values[5], &token);
+  } else if (kind == LAZY_NORMAL) {
+    token += 3;
+    parseReal3(&values[0], &values[1], &values[2], &token);
+  } else {
+    token += 3;
+    parseReal2(&values[0], &values[1], &token);
+  }
+}
+
+// Decodes the blocks of `lines` covering [first, last) that are not
+// decoded yet into `values`(`stride` reals per line) and `colors`(rgb per
+// line, NULL to skip).
+static void decodeLazyRange(const lazy_attrib_t &lazy,
+                            const std::vector<size_t> &lines,
+                            std::vector<unsigned char> *blocks,
+                            lazy_line_t kind, size_t first, size_t last,
+                            real_t *values, real_t *colors) {
+  const size_t block_size = lazy_attrib_t::kBlockSize;
+  last = (std::min)(last, lines.size());
+  if (first >= last) {
+    return;
+  }
+  const size_t stride = kind == LAZY_TEXCOORD ? 2 : 3;
+  for (size_t b = first / block_size; b <= (last - 1) / block_size; b++) {
+    if ((*blocks)[b]) {
+      continue;
+    }
+    const size_t begin = b * block_size;
+    const size_t end = (std::min)(begin + block_size, lines.size());
+    for (size_t i = begin; i < end; i++) {
+      real_t decoded[6];
+      decodeLazyLine(lazy, lines[i], kind, decoded);
+      for (size_t k = 0; k < stride; k++) {
+        values[i * stride + k] = decoded[k];
+      }
+      if (colors) {
+        colors[i * 3 + 0] = decoded[3];
+        colors[i * 3 + 1] = decoded[4];
+        colors[i * 3 + 2] = decoded[5];
+      }
+    }
+    if (lazy.use_transform && kind == LAZY_VERTEX) {
+      GetParseKernels().transform_points(lazy.point_xform,
+                                         &values[begin * 3], end - begin);
+    } else if (lazy.use_transform && kind == LAZY_NORMAL) {
+      if (lazy.rescale_normals) {
+        transformNormalsRescaled(lazy.normal_xform, &values[begin * 3],
+                                 end - begin);
+      } else {
+        GetParseKernels().transform_points(
+            lazy.normal_xform, &values[begin * 3], end - begin);
+      }
+    }
+    (*blocks)[b] = 1;
+  }
+}
+
+void DecodeVertices(attrib_t *attrib, size_t first, size_t last) {
+  lazy_attrib_t &lazy = attrib->lazy;
+  if (lazy.vertex_lines.empty()) {
+    return;
+  }
+  real_t *colors = attrib->colors.size() == attrib->vertices.size()
+                       ? &attrib->colors[0]
+                       : NULL;
+  decodeLazyRange(lazy, lazy.vertex_lines, &lazy.vertex_blocks,
+                  LAZY_VERTEX, first, last, &attrib->vertices[0], colors);
+}
+
+void DecodeNormals(attrib_t *attrib, size_t first, size_t last) {
+  lazy_attrib_t &lazy = attrib->lazy;
+  if (lazy.normal_lines.empty()) {
+    return;
+  }
+  decodeLazyRange(lazy, lazy.normal_lines, &lazy.normal_blocks,
+                  LAZY_NORMAL, first, last, &attrib->normals[0], NULL);
+}
+
+void DecodeTexcoords(attrib_t *attrib, size_t first, size_t last) {
+  lazy_attrib_t &lazy = attrib->lazy;
+  if (lazy.texcoord_lines.empty()) {
+    return;
+  }
+  decodeLazyRange(lazy, lazy.texcoord_lines, &lazy.texcoord_blocks,
+                  LAZY_TEXCOORD, first, last, &attrib->texcoords[0], NULL);
+}
+
+void DecodeAttributes(attrib_t *attrib) {
+  const lazy_attrib_t &lazy = attrib->lazy;
+  DecodeVertices(attrib, 0, lazy.vertex_lines.size());
+  DecodeNormals(attrib, 0, lazy.normal_lines.size());
+  DecodeTexcoords(attrib, 0, lazy.texcoord_lines.size());
+  clearLazyAttributes(attrib);
+}
+
+// State of a single .obj parse. Lines are fed one at a time through
+// ParseLine() so the same state machine serves std::istream input and
+// in-memory text(ObjTextParser).
+struct ObjParser {
+  // Names are interned into `name_pool`(a private pool if NULL).
+  ObjParser(std::vector<shape_t> *shapes_out,
+            std::vector<material_t> *materials_out, std::string *warn_out,
+            std::string *err_out, MaterialReader *mat_reader,
+            const ObjReaderConfig &reader_config,
+            name_pool_t *name_pool = NULL, parse_scratch_t *scratch_in = NULL)
+      : shapes(shapes_out), materials(materials_out), warn(warn_out),
+        err(err_out), readMatFn(mat_reader), config(reader_config),
+        triangulate(reader_config.triangulate),
+        default_vcols_fallback(reader_config.vertex_color),
+        names(name_pool ? name_pool : &own_names), name_id(0), material(-1),
+        current_smoothing_id(0), greatest_v_idx(-1), greatest_vn_idx(-1),
+        greatest_vt_idx(-1), found_all_colors(true), line_num(0),
+        transform(reader_config.use_transform), rescale_normals(false),
+        v_transformed(0), vn_transformed(0), scratch(scratch_in),
+        lazy(false), line_text(NULL) {
+    if (transform) {
+      makeAttribTransforms(reader_config.transform, point_xform,
+                           normal_xform, &rescale_normals);
+    }
+    if (scratch) {
+      SwapScratch();
+    }
+  }
+
+  ~ObjParser() {
+    // A parse larger than the limit leaves the context empty.
+    if (scratch && ScratchBytes() <= scratch->max_bytes) {
+      v.clear();
+      vn.clear();
+      vt.clear();
+      vc.clear();
+      vw.clear();
+      tags.clear();
+      prim_group.clear();
+      clearShape(&shape);
+      material_by_name.clear();
+      SwapScratch();
+    }
+  }
+
+  void SwapScratch() {
+    v.swap(scratch->v);
+    vn.swap(scratch->vn);
+    vt.swap(scratch->vt);
+    vc.swap(scratch->vc);
+    vw.swap(scratch->vw);
+    tags.swap(scratch->tags);
+    prim_group.faceGroup.swap(scratch->prim_group.faceGroup);
+    prim_group.lineGroup.swap(scratch->prim_group.lineGroup);
+    prim_group.pointsGroup.swap(scratch->prim_group.pointsGroup);
+    std::swap(shape, scratch->shape);
+    material_by_name.swap(scratch->material_by_name);
+  }
+
+  // Capacity of the large containers.
+  size_t ScratchBytes() const {
+    return capacityBytes(v) + capacityBytes(vn) + capacityBytes(vt) +
+           capacityBytes(vc) + capacityBytes(prim_group.faceGroup) +
+           capacityBytes(shape.mesh.indices) +
+           capacityBytes(shape.mesh.num_face_vertices) +
+           capacityBytes(shape.mesh.material_ids) +
+           capacityBytes(shape.mesh.smoothing_group_ids);
+  }
+
+  // `line` is a NUL terminated line without the trailing newline.
+  // Returns false on a parse error(reported to `err`).
+  bool ParseLine(const char *line) {
+    // Skip leading space.
+    const char *token = line;
+    token += strspn(token, " \t");
+
+    assert(token);
+    if (token[0] == '\0')
+      return true; // empty line
+
+    if (token[0] == '#')
+      return true; // comment line
+
+    // vertex
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+      if (lazy) {
+        AddLazyVertex(line_text);
+        return true;
+      }
+      token += 2;
+      real_t x, y, z;
+      real_t r, g, b;
+
+      found_all_colors &= parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+
+      v.push_back(x);
+      v.push_back(y);
+      v.push_back(z);
+
+      if (found_all_colors || default_vcols_fallback) {
+        vc.push_back(r);
+        vc.push_back(g);
+        vc.push_back(b);
+      }
+
+      MaybeTransform();
+      return true;
+    }
+
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+      if (lazy) {
+        AddLazyNormal(line_text);
+        return true;
+      }
+      token += 3;
+      real_t x, y, z;
+      parseReal3(&x, &y, &z, &token);
+      vn.push_back(x);
+      vn.push_back(y);
+      vn.push_back(z);
+      MaybeTransform();
+      return true;
+    }
+
+    // texcoord
     if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+      if (lazy) {
+        AddLazyTexcoord(line_text);
+        return true;
+      }
       token += 3;
       real_t x, y;
       parseReal2(&x, &y, &token);
       vt.push_back(x);
       vt.push_back(y);
-      continue;
+      return true;
     }
 
     // skin weight. tinyobj extension
@@ -2676,8 +4700,9 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       // vw 0 0 0.25 1 0.25 2 0.5
 
       // TODO(syoyo): Add syntax check
-      int vid = 0;
-      vid = parseInt(&token);
+      token += strspn(token, " \t");
+      index_int_t vid = atoidx(token);
+      token += strcspn(token, " \t\r");
 
       skin_weight_t sw;
 
@@ -2726,9 +4751,10 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       while (!IS_NEW_LINE(token[0])) {
         vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (!parseTriple(&token, static_cast<index_int_t>(v.size() / 3),
+                         static_cast<index_int_t>(vn.size() / 3),
+                         static_cast<index_int_t>(vt.size() / 2), &vi,
+                         context)) {
           if (err) {
             (*err) += "Failed to parse `l' line (e.g. a zero value for vertex "
                       "index. Line " +
@@ -2745,7 +4771,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       prim_group.lineGroup.push_back(line);
 
-      continue;
+      return true;
     }
 
     // points
@@ -2756,9 +4782,10 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       while (!IS_NEW_LINE(token[0])) {
         vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (!parseTriple(&token, static_cast<index_int_t>(v.size() / 3),
+                         static_cast<index_int_t>(vn.size() / 3),
+                         static_cast<index_int_t>(vt.size() / 2), &vi,
+                         context)) {
           if (err) {
             (*err) += "Failed to parse `p' line (e.g. a zero value for vertex "
                       "index. Line " +
@@ -2775,7 +4802,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       prim_group.pointsGroup.push_back(pts);
 
-      continue;
+      return true;
     }
 
     // face
@@ -2790,9 +4817,10 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       while (!IS_NEW_LINE(token[0])) {
         vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (!parseTriple(&token, static_cast<index_int_t>(v.size() / 3),
+                         static_cast<index_int_t>(vn.size() / 3),
+                         static_cast<index_int_t>(vt.size() / 2), &vi,
+                         context)) {
           if (err) {
             (*err) += "Failed to parse `f' line (e.g. a zero value for vertex "
                       "index or invalid relative vertex index). Line " +
@@ -2812,26 +4840,23 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         token += n;
       }
 
-      // replace with emplace_back + std::move on C++11
-      prim_group.faceGroup.push_back(face);
+      AddFace(&face);
 
-      continue;
+      return true;
     }
 
     // use mtl
     if ((0 == strncmp(token, "usemtl", 6))) {
       token += 6;
-      std::string namebuf = parseString(&token);
+      token += strspn(token, " \t");
+      const size_t len = strcspn(token, " \t\r");
 
-      int newMaterialId = -1;
-      std::map<std::string, int>::const_iterator it =
-          material_map.find(namebuf);
-      if (it != material_map.end()) {
-        newMaterialId = it->second;
-      } else {
+      const int newMaterialId = FindMaterial(token, len);
+      if (newMaterialId < 0) {
         // { error!! material not found }
         if (warn) {
-          (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
+          (*warn) += "material [ '" + std::string(token, len) +
+                     "' ] not found in .mtl\n";
         }
       }
 
@@ -2839,13 +4864,15 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         // Create per-face material. Thus we don't add `shape` to `shapes` at
         // this time.
         // just clear `faceGroup` after `exportGroupsToShape()` call.
-        exportGroupsToShape(&shape, prim_group, tags, material, name,
-                            triangulate, v, warn);
+        TransformPending();
+        DecodePolygonVertices();
+        exportGroupsToShape(&shape, prim_group, tags, material, *names,
+                            name_id, triangulate, v, warn);
         prim_group.faceGroup.clear();
         material = newMaterialId;
       }
 
-      continue;
+      return true;
     }
 
     // load mtl
@@ -2875,8 +4902,10 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
             std::string warn_mtl;
             std::string err_mtl;
+            const size_t first_material = materials->size();
             bool ok = (*readMatFn)(filenames[s].c_str(), materials,
                                    &material_map, &warn_mtl, &err_mtl);
+            material_by_name.clear(); // material_map may have changed
             if (warn && (!warn_mtl.empty())) {
               (*warn) += warn_mtl;
             }
@@ -2888,6 +4917,12 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
             if (ok) {
               found = true;
               material_filenames.insert(filenames[s]);
+              if (config.materials_cb && materials->size() > first_material) {
+                config.materials_cb(config.materials_cb_user_data,
+                                    &(*materials)[first_material],
+                                    materials->size() - first_material,
+                                    readMatFn->LastDirectory().c_str());
+              }
               break;
             }
           }
@@ -2901,84 +4936,93 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         }
       }
 
-      continue;
+      return true;
     }
 
     // group name
     if (token[0] == 'g' && IS_SPACE((token[1]))) {
       // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
+      TransformPending();
+      DecodePolygonVertices();
+      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, *names,
+                                     name_id, triangulate, v, warn);
       (void)ret; // return value not used.
 
       if (shape.mesh.indices.size() > 0) {
-        shapes->push_back(shape);
+        EmitShape();
       }
 
-      shape = shape_t();
+      clearShape(&shape);
 
       // material = -1;
       prim_group.clear();
 
-      std::vector<std::string> names;
-
+      // The first token is 'g'. Names are looked up in place; only a
+      // group with several names is joined into `name_scratch`.
+      size_t num_names = 0;
+      const char *first = NULL;
+      size_t first_len = 0;
       while (!IS_NEW_LINE(token[0])) {
-        std::string str = parseString(&token);
-        names.push_back(str);
+        token += strspn(token, " \t");
+        const size_t len = strcspn(token, " \t\r");
+        if (num_names == 1) {
+          first = token;
+          first_len = len;
+        } else if (num_names == 2) {
+          name_scratch.assign(first, first_len);
+        }
+        if (num_names >= 2) {
+          // tinyobjloader does not support multiple groups for a primitive.
+          // Currently we concatinate multiple group names with a space to
+          // get single group name.
+          name_scratch += ' ';
+          name_scratch.append(token, len);
+        }
+        num_names++;
+        token += len;
         token += strspn(token, " \t\r"); // skip tag
       }
 
-      // names[0] must be 'g'
-
-      if (names.size() < 2) {
+      if (num_names < 2) {
         // 'g' with empty names
         if (warn) {
           std::stringstream ss;
           ss << "Empty group name. line: " << line_num << "\n";
           (*warn) += ss.str();
-          name = "";
+          name_id = 0;
         }
+      } else if (num_names == 2) {
+        name_id = names->Intern(first, first_len);
       } else {
-        std::stringstream ss;
-        ss << names[1];
-
-        // tinyobjloader does not support multiple groups for a primitive.
-        // Currently we concatinate multiple group names with a space to get
-        // single group name.
-
-        for (size_t i = 2; i < names.size(); i++) {
-          ss << " " << names[i];
-        }
-
-        name = ss.str();
+        name_id = names->Intern(name_scratch.data(), name_scratch.size());
       }
 
-      continue;
+      return true;
     }
 
     // object name
     if (token[0] == 'o' && IS_SPACE((token[1]))) {
       // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
+      TransformPending();
+      DecodePolygonVertices();
+      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, *names,
+                                     name_id, triangulate, v, warn);
       (void)ret; // return value not used.
 
       if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 ||
           shape.points.indices.size() > 0) {
-        shapes->push_back(shape);
+        EmitShape();
       }
 
       // material = -1;
       prim_group.clear();
-      shape = shape_t();
+      clearShape(&shape);
 
       // @todo { multiple object name? }
       token += 2;
-      std::stringstream ss;
-      ss << token;
-      name = ss.str();
+      name_id = names->Intern(token, strlen(token));
 
-      continue;
+      return true;
     }
 
     if (token[0] == 't' && IS_SPACE(token[1])) {
@@ -3030,7 +5074,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       tags.push_back(tag);
 
-      continue;
+      return true;
     }
 
     if (token[0] == 's' && IS_SPACE(token[1])) {
@@ -3041,11 +5085,11 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       token += strspn(token, " \t"); // skip space
 
       if (token[0] == '\0') {
-        continue;
+        return true;
       }
 
       if (token[0] == '\r' || token[1] == '\n') {
-        continue;
+        return true;
       }
 
       if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
@@ -3063,66 +5107,625 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         }
       }
 
-      continue;
+      return true;
     } // smoothing group id
 
     // Ignore unknown command.
+
+    return true;
+  }
+
+  // Stage 2 of the in-memory parser. Walks the lines of `buf[0, len)` with
+  // the structural index `pos` instead of scanning every byte. `v`, `vn`,
+  // `vt` and `f` lines in their common forms are decoded straight from the
+  // fields; any other line is copied to `linebuf` and goes through
+  // ParseLine(), so both paths give the same result.
+  bool ParseIndexed(const char *buf, size_t len, const unsigned int *pos,
+                    size_t num_pos, std::string *linebuf) {
+    line_field_t fields[kMaxLineFields];
+
+    size_t p = 0;
+    size_t line_begin = 0;
+    while (line_begin < len) {
+      size_t num_fields = 0;
+      bool has_slash = false;
+      bool after_slash = false;
+      const char *field_begin = buf + line_begin;
+      size_t line_end = len;
+      size_t next_line = len;
+      for (; p < num_pos; p++) {
+        const size_t q = pos[p];
+        const char c = buf[q];
+        // A lone '\r' ends a line just like in safeGetline().
+        if (c == '\n' ||
+            (c == '\r' && (q + 1 >= len || buf[q + 1] != '\n'))) {
+          line_end = q;
+          next_line = q + 1;
+          p++;
+          break;
+        }
+        // Empty fields only matter next to a '/'(e.g. `1//2`).
+        const char *field_end = buf + q;
+        if (field_end > field_begin || c == '/' || after_slash) {
+          if (num_fields < kMaxLineFields) {
+            line_field_t field = {field_begin, field_end, c};
+            fields[num_fields] = field;
+          }
+          num_fields++;
+        }
+        has_slash |= (c == '/');
+        after_slash = (c == '/');
+        field_begin = field_end + 1;
+      }
+      if (buf + line_end > field_begin || after_slash) {
+        if (num_fields < kMaxLineFields) {
+          line_field_t field = {field_begin, buf + line_end, '\n'};
+          fields[num_fields] = field;
+        }
+        num_fields++;
+      }
+
+      line_num++;
+
+      int ret = -1;
+      if (num_fields == 0 || fields[0].begin[0] == '#') {
+        ret = 1; // empty or comment line
+      } else if (num_fields <= kMaxLineFields &&
+                 (fields[0].sep == ' ' || fields[0].sep == '\t')) {
+        ret = ParseFields(fields, num_fields, has_slash, buf + len);
+      }
+
+      if (ret == 0) {
+        return false;
+      }
+      if (ret < 0) {
+        size_t n = line_end - line_begin;
+        // The '\r' of "\r\n" is a separator above; trim it here.
+        if (n > 0 && buf[line_begin + n - 1] == '\r') {
+          n--;
+        }
+        linebuf->assign(buf + line_begin, n);
+        line_text = buf + line_begin;
+        if (!ParseLine(linebuf->c_str())) {
+          return false;
+        }
+      }
+
+      line_begin = next_line;
+    }
+    return true;
   }
 
-  // not all vertices have colors, no default colors desired? -> clear colors
-  if (!found_all_colors && !default_vcols_fallback) {
-    vc.clear();
+  // Fast paths of ParseIndexed(). `fields[0]` is the command followed by a
+  // space and `limit` is the end of the buffer. Returns 1 when the line was
+  // parsed, 0 on a parse error and -1 when the line needs ParseLine().
+  int ParseFields(const line_field_t *fields, size_t num_fields,
+                  bool has_slash, const char *limit) {
+    const line_field_t &cmd = fields[0];
+    const size_t cmd_len = static_cast<size_t>(cmd.end - cmd.begin);
+
+    if (cmd_len == 1 && cmd.begin[0] == 'f') {
+      const int ret = ParseFaceFields(fields + 1, num_fields - 1, limit);
+      if (ret == 0 && err) {
+        (*err) += "Failed to parse `f' line (e.g. a zero value for vertex "
+                  "index or invalid relative vertex index). Line " +
+                  toString(line_num) + ").\n";
+      }
+      return ret;
+    }
+
+    if (has_slash || cmd.begin[0] != 'v') {
+      return -1;
+    }
+
+    // vertex
+    if (cmd_len == 1) {
+      if (lazy) {
+        AddLazyVertex(cmd.begin);
+        return 1;
+      }
+      const real_t x = parseRealField(fields, num_fields, 1);
+      const real_t y = parseRealField(fields, num_fields, 2);
+      const real_t z = parseRealField(fields, num_fields, 3);
+      real_t r, g, b;
+      const bool found_color = parseRealField(fields, num_fields, 4, &r) &&
+                               parseRealField(fields, num_fields, 5, &g) &&
+                               parseRealField(fields, num_fields, 6, &b);
+      if (!found_color) {
+        r = g = b = 1.0;
+      }
+      found_all_colors &= found_color;
+
+      v.push_back(x);
+      v.push_back(y);
+      v.push_back(z);
+
+      if (found_all_colors || default_vcols_fallback) {
+        vc.push_back(r);
+        vc.push_back(g);
+        vc.push_back(b);
+      }
+      MaybeTransform();
+      return 1;
+    }
+
+    // normal
+    if (cmd_len == 2 && cmd.begin[1] == 'n') {
+      if (lazy) {
+        AddLazyNormal(cmd.begin);
+        return 1;
+      }
+      vn.push_back(parseRealField(fields, num_fields, 1));
+      vn.push_back(parseRealField(fields, num_fields, 2));
+      vn.push_back(parseRealField(fields, num_fields, 3));
+      MaybeTransform();
+      return 1;
+    }
+
+    // texcoord
+    if (cmd_len == 2 && cmd.begin[1] == 't') {
+      if (lazy) {
+        AddLazyTexcoord(cmd.begin);
+        return 1;
+      }
+      vt.push_back(parseRealField(fields, num_fields, 1));
+      vt.push_back(parseRealField(fields, num_fields, 2));
+      return 1;
+    }
+
+    return -1;
   }
 
-  if (greatest_v_idx >= static_cast<int>(v.size() / 3)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex indices out of bounds (line " << line_num << ".)\n\n";
-      (*warn) += ss.str();
+  // Face vertices as fields: `i`, `i/j`, `i//k` or `i/j/k`. Returns -1
+  // without side effects when the line has another form, 0 for an invalid
+  // index and 1 when the face was added.
+  int ParseFaceFields(const line_field_t *fields, size_t num_fields,
+                      const char *limit) {
+    const parse_kernels_t &kernels = GetParseKernels();
+
+    // Validate the whole line first so that falling back to ParseLine()
+    // does not repeat warnings.
+    index_int_t values[kMaxLineFields];
+    size_t slot = 0; // 0: v, 1: vt, 2: vn
+    for (size_t i = 0; i < num_fields; i++) {
+      const bool empty = fields[i].begin == fields[i].end;
+      if (empty) {
+        if (slot != 1 || fields[i].sep != '/') {
+          return -1;
+        }
+      } else if (!parseIndexField(fields[i], limit, kernels, &values[i])) {
+        return -1;
+      }
+      if (fields[i].sep == '/') {
+        if (++slot > 2) {
+          return -1;
+        }
+      } else {
+        slot = 0;
+      }
+    }
+
+    warning_context context;
+    context.warn = warn;
+    context.line_number = line_num;
+
+    const index_int_t vsize = static_cast<index_int_t>(v.size() / 3);
+    const index_int_t vnsize = static_cast<index_int_t>(vn.size() / 3);
+    const index_int_t vtsize = static_cast<index_int_t>(vt.size() / 2);
+
+    face_t face;
+
+    face.smoothing_group_id = current_smoothing_id;
+    face.vertex_indices.reserve(3);
+
+    size_t i = 0;
+    while (i < num_fields) {
+      vertex_index_t vi(-1);
+      if (!fixIndex(values[i], vsize, &vi.v_idx, false, context)) {
+        return 0;
+      }
+      if (fields[i].sep == '/') {
+        i++;
+        if (fields[i].begin != fields[i].end &&
+            !fixIndex(values[i], vtsize, &vi.vt_idx, true, context)) {
+          return 0;
+        }
+        if (fields[i].sep == '/') {
+          i++;
+          if (!fixIndex(values[i], vnsize, &vi.vn_idx, true, context)) {
+            return 0;
+          }
+        }
+      }
+      i++;
+
+      greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
+      greatest_vn_idx =
+          greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
+      greatest_vt_idx =
+          greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
+
+      face.vertex_indices.push_back(vi);
     }
+
+    AddFace(&face);
+
+    return 1;
   }
-  if (greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex normal indices out of bounds (line " << line_num
-         << ".)\n\n";
-      (*warn) += ss.str();
+
+  // Moves `face` into the current group. C++03 has no move, so the index
+  // array is swapped in instead of copied.
+  void AddFace(face_t *face) {
+    prim_group.faceGroup.push_back(face_t());
+    face_t &added = prim_group.faceGroup.back();
+    added.smoothing_group_id = face->smoothing_group_id;
+    added.vertex_indices.swap(face->vertex_indices);
+  }
+
+  // Material id for a `usemtl` name or -1. Results are cached per name
+  // handle so that repeated lines build no std::string.
+  int FindMaterial(const char *str, size_t len) {
+    const size_t id = static_cast<size_t>(names->Intern(str, len));
+    if (id >= material_by_name.size()) {
+      material_by_name.resize(names->Size(), kUnresolvedMaterial);
     }
+    int &material_id = material_by_name[id];
+    if (material_id == kUnresolvedMaterial) {
+      std::map<std::string, int>::const_iterator it =
+          material_map.find(names->Get(static_cast<int>(id)));
+      material_id = (it != material_map.end()) ? it->second : -1;
+    }
+    return material_id;
   }
-  if (greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex texcoord indices out of bounds (line " << line_num
-         << ".)\n\n";
-      (*warn) += ss.str();
+
+  // ObjReaderConfig::transform is applied in batches of kTransformBatch
+  // values while they are still in cache, and before anything reads them
+  // (shape flush, Finish).
+  void MaybeTransform() {
+    if (transform && (v.size() - v_transformed >= kTransformBatch ||
+                      vn.size() - vn_transformed >= kTransformBatch)) {
+      TransformPending();
+    }
+  }
+
+  void TransformPending() {
+    if (!transform) {
+      return;
+    }
+    const parse_kernels_t &kernels = GetParseKernels();
+    if (v.size() > v_transformed) {
+      kernels.transform_points(point_xform, &v[v_transformed],
+                               (v.size() - v_transformed) / 3);
+      v_transformed = v.size();
+    }
+    if (vn.size() > vn_transformed) {
+      const size_t n = (vn.size() - vn_transformed) / 3;
+      if (rescale_normals) {
+        transformNormalsRescaled(normal_xform, &vn[vn_transformed], n);
+      } else {
+        kernels.transform_points(normal_xform, &vn[vn_transformed], n);
+      }
+      vn_transformed = vn.size();
+    }
+  }
+
+  // Records attribute lines instead of decoding them. Only for text that
+  // stays in memory(ObjTextParser); the decoding applies the transform.
+  void EnableLazy() {
+    lazy = true;
+    lazy_state.use_transform = transform;
+    lazy_state.rescale_normals = rescale_normals;
+    memcpy(lazy_state.point_xform, point_xform, sizeof(point_xform));
+    memcpy(lazy_state.normal_xform, normal_xform, sizeof(normal_xform));
+    transform = false;
+  }
+
+  // Extends the lazily parsed text by the next chunk. Offsets are only
+  // meaningful within one buffer, so a chunk that does not continue the
+  // previous one(e.g. a reused read buffer) fails the parse.
+  bool AddLazyText(const char *buf, size_t len) {
+    if (!lazy_state.text) {
+      lazy_state.text = buf;
+    }
+    if (buf != lazy_state.text + lazy_state.text_len) {
+      if (err) {
+        (*err) += "lazy_attributes requires the chunks of one contiguous "
+                  "buffer, but a chunk does not follow the previous one.\n";
+      }
+      return false;
+    }
+    lazy_state.text_len += len;
+    return true;
+  }
+
+  void AddLazyVertex(const char *line) {
+    lazy_state.vertex_lines.push_back(
+        static_cast<size_t>(line - lazy_state.text));
+    v.resize(v.size() + 3);
+    if (default_vcols_fallback) {
+      vc.resize(vc.size() + 3);
+    } else {
+      found_all_colors = false;
     }
   }
 
-  bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                 triangulate, v, warn);
-  // exportGroupsToShape return false when `usemtl` is called in the last
-  // line.
-  // we also add `shape` to `shapes` when `shape.mesh` has already some
-  // faces(indices)
-  if (ret || shape.mesh.indices
-                 .size()) { // FIXME(syoyo): Support other prims(e.g. lines)
+  void AddLazyNormal(const char *line) {
+    lazy_state.normal_lines.push_back(
+        static_cast<size_t>(line - lazy_state.text));
+    vn.resize(vn.size() + 3);
+  }
+
+  void AddLazyTexcoord(const char *line) {
+    lazy_state.texcoord_lines.push_back(
+        static_cast<size_t>(line - lazy_state.text));
+    vt.resize(vt.size() + 2);
+  }
+
+  // Triangulation needs the positions of the polygons, which a lazy parse
+  // has not decoded. Each is decoded once.
+  void DecodePolygonVertices() {
+    if (!lazy || !triangulate) {
+      return;
+    }
+    const size_t n = lazy_state.vertex_lines.size();
+    v_decoded.resize(n);
+    for (size_t i = 0; i < prim_group.faceGroup.size(); i++) {
+      const std::vector<vertex_index_t> &face =
+          prim_group.faceGroup[i].vertex_indices;
+      if (face.size() <= 3) {
+        continue;
+      }
+      for (size_t k = 0; k < face.size(); k++) {
+        const index_int_t vi = face[k].v_idx;
+        if (vi < 0 || size_t(vi) >= n || v_decoded[size_t(vi)]) {
+          continue;
+        }
+        real_t decoded[6];
+        decodeLazyLine(lazy_state, lazy_state.vertex_lines[size_t(vi)],
+                       LAZY_VERTEX, decoded);
+        if (lazy_state.use_transform) {
+          GetParseKernels().transform_points(lazy_state.point_xform,
+                                             decoded, 1);
+        }
+        v[size_t(vi) * 3 + 0] = decoded[0];
+        v[size_t(vi) * 3 + 1] = decoded[1];
+        v[size_t(vi) * 3 + 2] = decoded[2];
+        v_decoded[size_t(vi)] = 1;
+      }
+    }
+  }
+
+  // Appends the current shape to the output and hands it to the
+  // progressive callback.
+  void EmitShape() {
+    if (config.compact_face_attributes) {
+      CompactFaceAttributes(&shape.mesh);
+    }
     shapes->push_back(shape);
+    publishShape(config, shapes->back(), shapes->size() - 1, v, vn, vt, vc,
+                 lazy, &progressive);
   }
-  prim_group.clear(); // for safety
 
-  if (err) {
-    (*err) += errss.str();
+  // Flushes the last shape and moves the attributes into `attrib`.
+  bool Finish(attrib_t *attrib) {
+    TransformPending();
+
+    // not all vertices have colors, no default colors desired? -> clear colors
+    if (!found_all_colors && !default_vcols_fallback) {
+      vc.clear();
+    }
+
+    if (greatest_v_idx >= static_cast<index_int_t>(v.size() / 3)) {
+      if (warn) {
+        std::stringstream ss;
+        ss << "Vertex indices out of bounds (line " << line_num << ".)\n\n";
+        (*warn) += ss.str();
+      }
+    }
+    if (greatest_vn_idx >= static_cast<index_int_t>(vn.size() / 3)) {
+      if (warn) {
+        std::stringstream ss;
+        ss << "Vertex normal indices out of bounds (line " << line_num
+           << ".)\n\n";
+        (*warn) += ss.str();
+      }
+    }
+    if (greatest_vt_idx >= static_cast<index_int_t>(vt.size() / 2)) {
+      if (warn) {
+        std::stringstream ss;
+        ss << "Vertex texcoord indices out of bounds (line " << line_num
+           << ".)\n\n";
+        (*warn) += ss.str();
+      }
+    }
+
+    DecodePolygonVertices();
+    bool ret = exportGroupsToShape(&shape, prim_group, tags, material, *names,
+                                   name_id, triangulate, v, warn);
+    // exportGroupsToShape return false when `usemtl` is called in the last
+    // line.
+    // we also add `shape` to `shapes` when `shape.mesh` has already some
+    // faces(indices)
+    if (ret || shape.mesh.indices
+                   .size()) { // FIXME(syoyo): Support other prims(e.g. lines)
+      EmitShape();
+    }
+    prim_group.clear(); // for safety
+
+    clearSplitAttributes(attrib);
+    clearLazyAttributes(attrib);
+    if (lazy) {
+      lazy_attrib_t &out = attrib->lazy;
+      const size_t block_size = lazy_attrib_t::kBlockSize;
+      out.text = lazy_state.text;
+      out.text_len = lazy_state.text_len;
+      out.vertex_lines.swap(lazy_state.vertex_lines);
+      out.normal_lines.swap(lazy_state.normal_lines);
+      out.texcoord_lines.swap(lazy_state.texcoord_lines);
+      out.vertex_blocks.assign(
+          (out.vertex_lines.size() + block_size - 1) / block_size, 0);
+      out.normal_blocks.assign(
+          (out.normal_lines.size() + block_size - 1) / block_size, 0);
+      out.texcoord_blocks.assign(
+          (out.texcoord_lines.size() + block_size - 1) / block_size, 0);
+      out.use_transform = lazy_state.use_transform;
+      out.rescale_normals = lazy_state.rescale_normals;
+      memcpy(out.point_xform, lazy_state.point_xform,
+             sizeof(out.point_xform));
+      memcpy(out.normal_xform, lazy_state.normal_xform,
+             sizeof(out.normal_xform));
+    } else if (config.soa_attributes) {
+      // Transposed straight from the parse arrays; the interleaved ones
+      // are left empty.
+      attrib->vertex_weights.swap(attrib->vertices);
+      attrib->texcoord_ws.swap(attrib->texcoords);
+      std::vector<real_t>().swap(attrib->vertices);
+      std::vector<real_t>().swap(attrib->normals);
+      std::vector<real_t>().swap(attrib->texcoords);
+      splitAttributes(v, vn, vt, attrib);
+      if (scratch && ScratchBytes() <= scratch->max_bytes) {
+        std::vector<real_t>(vc.begin(), vc.end()).swap(attrib->colors);
+        std::vector<skin_weight_t>(vw.begin(), vw.end())
+            .swap(attrib->skin_weights);
+      } else {
+        attrib->colors.swap(vc);
+        attrib->skin_weights.swap(vw);
+      }
+      return true;
+    }
+
+    if (scratch && ScratchBytes() <= scratch->max_bytes) {
+      // Copy exactly sized; the capacity goes back to the context.
+      attrib->vertex_weights.swap(attrib->vertices);
+      attrib->texcoord_ws.swap(attrib->texcoords);
+      std::vector<real_t>(v.begin(), v.end()).swap(attrib->vertices);
+      std::vector<real_t>(vn.begin(), vn.end()).swap(attrib->normals);
+      std::vector<real_t>(vt.begin(), vt.end()).swap(attrib->texcoords);
+      std::vector<real_t>(vc.begin(), vc.end()).swap(attrib->colors);
+      std::vector<skin_weight_t>(vw.begin(), vw.end())
+          .swap(attrib->skin_weights);
+      return true;
+    }
+
+    attrib->vertices.swap(v);
+    attrib->vertex_weights.swap(v);
+    attrib->normals.swap(vn);
+    attrib->texcoords.swap(vt);
+    attrib->texcoord_ws.swap(vt);
+    attrib->colors.swap(vc);
+    attrib->skin_weights.swap(vw);
+
+    return true;
   }
 
-  attrib->vertices.swap(v);
-  attrib->vertex_weights.swap(v);
-  attrib->normals.swap(vn);
-  attrib->texcoords.swap(vt);
-  attrib->texcoord_ws.swap(vt);
-  attrib->colors.swap(vc);
-  attrib->skin_weights.swap(vw);
+  std::vector<shape_t> *shapes;
+  std::vector<material_t> *materials;
+  std::string *warn;
+  std::string *err;
+  MaterialReader *readMatFn;
+  const ObjReaderConfig &config;
+  bool triangulate;
+  bool default_vcols_fallback;
 
-  return true;
+  std::vector<real_t> v;
+  std::vector<real_t> vn;
+  std::vector<real_t> vt;
+  std::vector<real_t> vc;
+  std::vector<skin_weight_t> vw;
+  std::vector<tag_t> tags;
+  PrimGroup prim_group;
+
+  // names
+  name_pool_t own_names;
+  name_pool_t *names;
+  int name_id; // current group or object name
+  std::string name_scratch;
+
+  // material
+  std::set<std::string> material_filenames;
+  std::map<std::string, int> material_map;
+  std::vector<int> material_by_name; // indexed by name handle
+  int material;
+
+  // smoothing group id
+  unsigned int current_smoothing_id; // Initial value. 0 means no smoothing.
+
+  index_int_t greatest_v_idx;
+  index_int_t greatest_vn_idx;
+  index_int_t greatest_vt_idx;
+
+  shape_t shape;
+  progressive_state progressive;
+
+  bool found_all_colors;
+
+  size_t line_num;
+
+  // ObjReaderConfig::transform as row-major 3x4 matrices
+  bool transform;
+  bool rescale_normals;
+  real_t point_xform[12];
+  real_t normal_xform[12];
+  size_t v_transformed; // values of `v` already transformed
+  size_t vn_transformed;
+
+  parse_scratch_t *scratch; // ParseContext, NULL without one
+
+  // ObjReaderConfig::lazy_attributes(see EnableLazy()). `v`, `vn`, `vt`
+  // and `vc` then hold zeros in place of the values.
+  bool lazy;
+  lazy_attrib_t lazy_state;
+  const char *line_text; // Line of the text ParseIndexed() passes on.
+  std::vector<unsigned char> v_decoded; // See DecodePolygonVertices().
+
+  enum { kUnresolvedMaterial = -2, kTransformBatch = 3 * 256 };
+};
+
+// LoadObj() that interns names into `name_pool`(a private pool if NULL).
+static bool loadObjInterned(attrib_t *attrib, std::vector<shape_t> *shapes,
+                            std::vector<material_t> *materials,
+                            std::string *warn, std::string *err,
+                            std::istream *inStream, MaterialReader *readMatFn,
+                            const ObjReaderConfig &config,
+                            name_pool_t *name_pool) {
+  ObjParser parser(shapes, materials, warn, err, readMatFn, config,
+                   name_pool);
+
+  std::string linebuf;
+  while (inStream->peek() != -1) {
+    safeGetline(*inStream, linebuf);
+
+    parser.line_num++;
+
+    // Trim newline '\r\n' or '\n'
+    if (linebuf.size() > 0) {
+      if (linebuf[linebuf.size() - 1] == '\n')
+        linebuf.erase(linebuf.size() - 1);
+    }
+    if (linebuf.size() > 0) {
+      if (linebuf[linebuf.size() - 1] == '\r')
+        linebuf.erase(linebuf.size() - 1);
+    }
+
+    // Skip if empty line.
+    if (linebuf.empty()) {
+      continue;
+    }
+
+    if (!parser.ParseLine(linebuf.c_str())) {
+      return false;
+    }
+  }
+
+  return parser.Finish(attrib);
+}
+
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *warn,
+             std::string *err, std::istream *inStream,
+             MaterialReader *readMatFn, const ObjReaderConfig &config) {
+  return loadObjInterned(attrib, shapes, materials, warn, err, inStream,
+                         readMatFn, config, NULL);
 }
 
 bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
@@ -3437,9 +6040,21 @@ bool ObjReader::ParseFromFile(const std::string &filename,
     mtl_search_path = config.mtl_search_path;
   }
 
-  valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
-                   filename.c_str(), mtl_search_path.c_str(),
-                   config.triangulate, config.vertex_color);
+  std::ifstream ifs(filename.c_str());
+  if (!ifs) {
+    error_ = "Cannot open file [" + filename + "]\n";
+    valid_ = false;
+    return valid_;
+  }
+
+  MaterialFileReader matFileReader(mtl_search_path);
+
+  attrib_ = attrib_t();
+  shapes_.clear();
+  names_.Clear();
+
+  valid_ = loadObjInterned(&attrib_, &shapes_, &materials_, &warning_,
+                           &error_, &ifs, &matFileReader, config, &names_);
 
   return valid_;
 }
@@ -3455,12 +6070,135 @@ bool ObjReader::ParseFromString(const std::string &obj_text,
 
   MaterialStreamReader mtl_ss(mtl_ifs);
 
-  valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
-                   &obj_ifs, &mtl_ss, config.triangulate, config.vertex_color);
+  names_.Clear();
+
+  valid_ = loadObjInterned(&attrib_, &shapes_, &materials_, &warning_,
+                           &error_, &obj_ifs, &mtl_ss, config, &names_);
 
   return valid_;
 }
 
+bool ObjReader::ParseFromBuffer(const char *obj_text, size_t obj_len,
+                                const std::string &mtl_text,
+                                const ObjReaderConfig &config,
+                                ParseContext *context) {
+  ObjTextParser parser(this, mtl_text, config, context);
+  parser.ParseChunk(obj_text, obj_len);
+  return parser.Finish();
+}
+
+ParseContext::ParseContext(size_t max_retained_bytes)
+    : scratch_(new parse_scratch_t(max_retained_bytes)) {}
+
+ParseContext::~ParseContext() { delete scratch_; }
+
+void ParseContext::Release() {
+  parse_scratch_t *released = scratch_;
+  scratch_ = new parse_scratch_t(released->max_bytes);
+  delete released;
+}
+
+struct ObjTextParser::Impl {
+  Impl(std::vector<shape_t> *shapes, std::vector<material_t> *materials,
+       std::string *warn, std::string *err, name_pool_t *names,
+       const std::string &mtl_text, const ObjReaderConfig &reader_config,
+       parse_scratch_t *scratch_in)
+      : config(reader_config), mtl_buf(mtl_text), mtl_ifs(&mtl_buf),
+        mtl_ss(mtl_ifs), mtl_file(reader_config.mtl_search_path),
+        parser(shapes, materials, warn, err,
+               (mtl_text.empty() && !config.mtl_search_path.empty())
+                   ? static_cast<MaterialReader *>(&mtl_file)
+                   : static_cast<MaterialReader *>(&mtl_ss),
+               config, names, scratch_in),
+        scratch(scratch_in), failed(false) {
+    if (scratch) {
+      SwapScratch();
+    }
+    if (config.lazy_attributes) {
+      parser.EnableLazy();
+    }
+  }
+
+  ~Impl() {
+    if (scratch) {
+      linebuf.clear();
+      SwapScratch();
+    }
+  }
+
+  // `index` is never shrunk, so its capacity is at most one chunk.
+  void SwapScratch() {
+    linebuf.swap(scratch->linebuf);
+    index.positions.swap(scratch->index.positions);
+  }
+
+  ObjReaderConfig config; // `parser` keeps a reference.
+  std::stringbuf mtl_buf;
+  std::istream mtl_ifs;
+  MaterialStreamReader mtl_ss;
+  MaterialFileReader mtl_file; // for `mtl_search_path` without `mtl_text`
+  ObjParser parser;
+  structural_index_t index; // for ParseChunk() without an index
+  std::string linebuf;
+  parse_scratch_t *scratch;
+  bool failed;
+};
+
+ObjTextParser::ObjTextParser(ObjReader *reader, const std::string &mtl_text,
+                             const ObjReaderConfig &config,
+                             ParseContext *context)
+    : impl_(NULL), reader_(reader) {
+  // As in ParseFromFile; also covers ParseFromBuffer.
+  reader->names_.Clear();
+  impl_ = new Impl(&reader->shapes_, &reader->materials_, &reader->warning_,
+                   &reader->error_, &reader->names_, mtl_text, config,
+                   context ? context->scratch_ : NULL);
+}
+
+ObjTextParser::~ObjTextParser() { delete impl_; }
+
+bool ObjTextParser::ParseChunk(const char *buf, size_t len,
+                               const structural_index_t &index) {
+  if (impl_->failed) {
+    return false;
+  }
+  if (impl_->parser.lazy && !impl_->parser.AddLazyText(buf, len)) {
+    impl_->failed = true;
+    return false;
+  }
+  if (!impl_->parser.ParseIndexed(
+          buf, len, index.positions.empty() ? NULL : &index.positions[0],
+          index.size, &impl_->linebuf)) {
+    impl_->failed = true;
+    return false;
+  }
+  return true;
+}
+
+bool ObjTextParser::ParseChunk(const char *buf, size_t len) {
+  // Keep the index of a chunk in cache while it is parsed.
+  const size_t kChunkSize = 1 << 20;
+  size_t begin = 0;
+  while (begin < len) {
+    const size_t end = FindChunkEnd(buf, len, begin, kChunkSize);
+    BuildStructuralIndex(buf + begin, end - begin, &impl_->index);
+    if (!ParseChunk(buf + begin, end - begin, impl_->index)) {
+      return false;
+    }
+    begin = end;
+  }
+  return !impl_->failed;
+}
+
+bool ObjTextParser::Finish() {
+  if (impl_->failed) {
+    reader_->valid_ = false;
+  } else {
+    reader_->valid_ = impl_->parser.Finish(&reader_->attrib_);
+  }
+  return reader_->valid_;
+}
+
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif